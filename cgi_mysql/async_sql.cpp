@@ -0,0 +1,365 @@
+#define LOG_MODULE LOG_MOD_SQL
+
+#include "async_sql.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+
+static const int CONNECT_TIMEOUT_MS = 3000; ///< Budget for all handshakes at startup
+static const int PING_IDLE_S = 30;          ///< Ping connections that have been silent this long
+static const char PING_SQL[] = "DO 1";      ///< Keep-alive statement, no result set
+static const uint32_t CONN_EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET; ///< See watch()
+
+ASYNC_SQL::ASYNC_SQL()
+{
+    m_wakefd = -1;
+    m_epollfd = -1;
+    m_alive = 0;
+    m_close_log = 0;
+    m_port = 0;
+}
+
+ASYNC_SQL::~ASYNC_SQL()
+{
+    for (ASYNC_CONN &c : m_conns)
+    {
+        if (c.conn)
+            mysql_close(c.conn);
+    }
+    if (m_wakefd != -1)
+        close(m_wakefd);
+}
+
+ASYNC_SQL *ASYNC_SQL::get_instance()
+{
+    static ASYNC_SQL async_sql;
+    return &async_sql;
+}
+
+void ASYNC_SQL::init(string url, string user, string password, string db_name, int port, int conn_num, int close_log)
+{
+    m_close_log = close_log;
+    if (conn_num <= 0)
+        return;
+    m_url = url;
+    m_user = user;
+    m_password = password;
+    m_db_name = db_name;
+    m_port = port;
+
+    vector<MYSQL *> conns;
+    vector<net_async_status> status;
+    for (int i = 0; i < conn_num; i++)
+    {
+        MYSQL *con = mysql_init(NULL);
+        if (con == NULL)
+            break;
+        conns.push_back(con);
+        status.push_back(NET_ASYNC_NOT_READY);
+    }
+
+    // drive every handshake side by side, polling whichever sockets are still connecting
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (true)
+    {
+        vector<pollfd> fds;
+        for (size_t i = 0; i < conns.size(); i++)
+        {
+            if (status[i] != NET_ASYNC_NOT_READY)
+                continue;
+            status[i] = mysql_real_connect_nonblocking(conns[i], url.c_str(), user.c_str(), password.c_str(), db_name.c_str(), port, NULL, 0);
+            if (status[i] == NET_ASYNC_NOT_READY)
+                fds.push_back({conns[i]->net.fd, POLLIN, 0});
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (fds.empty() || elapsed_ms >= CONNECT_TIMEOUT_MS)
+            break;
+        // the handshake mostly waits for the server to speak; the short timeout covers the
+        // steps that wait to write instead (the TCP connect), polling for POLLOUT would spin
+        poll(fds.data(), fds.size(), 10);
+    }
+
+    // connections that failed stay in the set, dead: tick() keeps trying them
+    time_t t = time(NULL);
+    int alive = 0;
+    for (size_t i = 0; i < conns.size(); i++)
+    {
+        MYSQL *con = conns[i];
+        if (status[i] != NET_ASYNC_COMPLETE)
+        {
+            LOG_ERROR("async mysql: connect failed: %s", mysql_error(con));
+            mysql_close(con);
+            con = NULL;
+        }
+        else
+            alive++;
+        m_conns.push_back({con, -1, con ? CONN_IDLE : CONN_DEAD, ASYNC_JOB(), NULL, t});
+    }
+    m_alive = alive;
+    m_wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    LOG_INFO("async mysql: %d of %d connection(s) ready", alive, conn_num);
+}
+
+void ASYNC_SQL::attach(int epollfd)
+{
+    if (m_wakefd == -1)
+        return;
+    m_epollfd = epollfd;
+    m_fd_slot.assign(m_wakefd + 1, 0);
+
+    // level-triggered: one read empties the eventfd counter
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = m_wakefd;
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_wakefd, &event);
+    m_fd_slot[m_wakefd] = -1;
+
+    for (ASYNC_CONN &c : m_conns)
+    {
+        if (c.state == CONN_IDLE)
+            watch(c);
+    }
+}
+
+void ASYNC_SQL::watch(ASYNC_CONN &c)
+{
+    if (m_epollfd == -1)
+        return;
+    int fd = c.conn->net.fd;
+    if (fd == c.fd)
+        return;
+    unwatch(c); // a new socket (reconnect)
+    if (fd < 0)
+        return;
+
+    // edge-triggered for both directions: the library reads and writes until it would
+    // block, so each edge means it can make progress, whichever way it was waiting; ADD
+    // reports the current state once, so nothing that happened before is missed
+    epoll_event event;
+    event.events = CONN_EVENTS;
+    event.data.fd = fd;
+    if (fd >= (int)m_fd_slot.size())
+        m_fd_slot.resize(fd + 1, 0);
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, fd, &event);
+    m_fd_slot[fd] = (&c - m_conns.data()) + 1;
+    c.fd = fd;
+}
+
+void ASYNC_SQL::unwatch(ASYNC_CONN &c)
+{
+    if (c.fd == -1)
+        return;
+    epoll_ctl(m_epollfd, EPOLL_CTL_DEL, c.fd, 0);
+    m_fd_slot[c.fd] = 0;
+    c.fd = -1;
+}
+
+bool ASYNC_SQL::query(const string &sql, ASYNC_CALLBACK cb)
+{
+    if (m_alive == 0 || m_epollfd == -1)
+        return false;
+
+    m_lock.lock();
+    m_pending.push_back({sql, cb});
+    m_lock.unlock();
+
+    // the event loop owns the connections, hand the job over through the eventfd
+    uint64_t one = 1;
+    ssize_t ret = ::write(m_wakefd, &one, sizeof(one));
+    (void)ret;
+    return true;
+}
+
+bool ASYNC_SQL::next_job(ASYNC_CONN &c)
+{
+    m_lock.lock();
+    if (m_pending.empty())
+    {
+        m_lock.unlock();
+        return false;
+    }
+    c.job = std::move(m_pending.front());
+    m_pending.pop_front();
+    m_lock.unlock();
+    return true;
+}
+
+void ASYNC_SQL::fail_pending()
+{
+    // nothing will ever run the queued jobs, fail them now
+    ASYNC_CONN none = {NULL, -1, CONN_DEAD, ASYNC_JOB(), NULL, 0};
+    while (next_job(none))
+        none.job.cb(NULL, CR_SERVER_GONE_ERROR);
+}
+
+void ASYNC_SQL::lose(ASYNC_CONN &c)
+{
+    // out of epoll but still open, and still ours in m_fd_slot: events already returned by
+    // this epoll_wait() are ignored, and the fd cannot be reused by a client meanwhile
+    if (c.fd != -1)
+        epoll_ctl(m_epollfd, EPOLL_CTL_DEL, c.fd, 0);
+    bool counted = c.state == CONN_IDLE || c.state == CONN_QUERY || c.state == CONN_STORE;
+    c.state = CONN_DEAD;
+    // jobs already queued move on to the remaining connections
+    if (counted && --m_alive == 0)
+        fail_pending();
+}
+
+void ASYNC_SQL::reconnect(ASYNC_CONN &c)
+{
+    if (c.conn)
+    {
+        if (c.fd != -1)
+            m_fd_slot[c.fd] = 0;
+        c.fd = -1;
+        mysql_close(c.conn);
+    }
+    c.conn = mysql_init(NULL);
+    if (c.conn == NULL)
+        return; // still dead, the next tick tries again
+    c.state = CONN_CONNECT;
+    connect_step(c);
+}
+
+void ASYNC_SQL::connect_step(ASYNC_CONN &c)
+{
+    net_async_status status = mysql_real_connect_nonblocking(c.conn, m_url.c_str(), m_user.c_str(), m_password.c_str(), m_db_name.c_str(), m_port, NULL, 0);
+    if (status == NET_ASYNC_NOT_READY)
+    {
+        watch(c);
+        if (c.fd != -1)
+            return;
+    }
+    if (status != NET_ASYNC_COMPLETE)
+    {
+        LOG_WARN("async mysql: reconnect failed: %s", mysql_error(c.conn));
+        lose(c);
+        return;
+    }
+
+    LOG_INFO("%s", "async mysql: connection restored");
+    c.state = CONN_IDLE;
+    c.last_used = time(NULL);
+    watch(c);
+    ++m_alive;
+    step(c); // jobs queued meanwhile
+}
+
+void ASYNC_SQL::finish(ASYNC_CONN &c, MYSQL_RES *res, unsigned int err)
+{
+    if (err)
+        LOG_ERROR("async mysql: %s", mysql_error(c.conn));
+
+    c.job.cb(res, err);
+    if (res)
+        mysql_free_result(res); // stored result, freeing does no I/O
+    c.res = NULL;
+    c.job = ASYNC_JOB();
+    c.last_used = time(NULL);
+    c.state = CONN_IDLE;
+
+    if (err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST)
+        lose(c); // reconnected by the next tick()
+}
+
+void ASYNC_SQL::step(ASYNC_CONN &c)
+{
+    while (c.state == CONN_IDLE || c.state == CONN_QUERY || c.state == CONN_STORE)
+    {
+        net_async_status status;
+        if (c.state == CONN_IDLE)
+        {
+            if (!next_job(c))
+                return;
+            c.state = CONN_QUERY;
+        }
+
+        if (c.state == CONN_QUERY)
+        {
+            status = mysql_real_query_nonblocking(c.conn, c.job.sql.c_str(), c.job.sql.length());
+            if (status == NET_ASYNC_NOT_READY)
+                return; // resumed by the next edge on c.fd
+            if (status == NET_ASYNC_ERROR)
+            {
+                finish(c, NULL, mysql_errno(c.conn));
+                continue;
+            }
+            c.state = CONN_STORE;
+        }
+
+        if (c.state == CONN_STORE)
+        {
+            status = mysql_store_result_nonblocking(c.conn, &c.res);
+            if (status == NET_ASYNC_NOT_READY)
+                return;
+            if (status == NET_ASYNC_ERROR)
+                finish(c, NULL, mysql_errno(c.conn));
+            else
+                finish(c, c.res, 0);
+        }
+    }
+}
+
+void ASYNC_SQL::tick()
+{
+    if (m_epollfd == -1)
+        return;
+    time_t now = time(NULL);
+    for (ASYNC_CONN &c : m_conns)
+    {
+        if (c.state == CONN_DEAD)
+            reconnect(c);
+        else if (c.state == CONN_CONNECT)
+            connect_step(c);
+        else if (c.state == CONN_QUERY || c.state == CONN_STORE)
+            step(c);
+        else if (c.state == CONN_IDLE && now - c.last_used >= PING_IDLE_S)
+        {
+            // before MySQL's wait_timeout closes it; if it is already gone, finish() finds out
+            c.job = {PING_SQL, [](MYSQL_RES *, unsigned int) {}};
+            c.state = CONN_QUERY;
+            step(c);
+        }
+    }
+}
+
+void ASYNC_SQL::on_event(int fd, uint32_t events)
+{
+    if (fd == m_wakefd)
+    {
+        uint64_t count;
+        ssize_t ret = ::read(m_wakefd, &count, sizeof(count));
+        (void)ret;
+        // start new jobs on every idle connection, busy ones pick them up when they finish
+        for (ASYNC_CONN &c : m_conns)
+        {
+            if (c.state == CONN_IDLE)
+                step(c);
+        }
+
+        if (m_alive == 0)
+            fail_pending();
+        return;
+    }
+
+    ASYNC_CONN &c = m_conns[m_fd_slot[fd] - 1];
+    if (c.state == CONN_CONNECT)
+        connect_step(c);
+    else if (c.state == CONN_IDLE)
+    {
+        // a write edge (the last statement fully sent) means nothing; data or a hang-up
+        // while nothing was asked means the server closed it (wait_timeout, restart)
+        if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+            return;
+        LOG_WARN("%s", "async mysql: idle connection closed by the server");
+        lose(c);
+    }
+    else if (c.state != CONN_DEAD) // an event of the fd returned before it was lost
+        step(c);
+}
@@ -0,0 +1,212 @@
+/**
+ * NOTE:
+ * libmysqlclient (8.0.16+) offers a non-blocking variant of the calls we need:
+ * mysql_real_connect_nonblocking, mysql_real_query_nonblocking, mysql_store_result_nonblocking.
+ * Each returns NET_ASYNC_NOT_READY when it would block and must simply be called again with the
+ * same arguments once the connection socket is ready again: readable, or writable while a
+ * statement larger than the socket buffer is still being sent. Which of the two it waits for
+ * is not public, so each socket is registered once, edge-triggered, for both: every edge runs
+ * the call again, a spurious one only gets NET_ASYNC_NOT_READY back. That fits the reactor:
+ * every async connection's socket (MYSQL::net.fd) sits in the server's epoll set and the event
+ * loop calls on_event() when it fires, so a handful of connections keep many queries in flight
+ * without parking worker threads. This is the MySQL 8 client API: MariaDB Connector/C has its
+ * own (mysql_*_start/_cont), and the build stops on anything else.
+ *
+ * FLOW:
+ *   worker thread:  handler -> res.defer() -> ASYNC_SQL::query(sql, cb) -> returns at once
+ *   event loop:     eventfd wakes -> idle connection starts the query
+ *                   socket ready -> step() drives query/store_result -> cb(res, err)
+ *                   cb claims the response, fills it and calls res.resume() -> EPOLLOUT -> write()
+ *   timer tick:     idle connections silent for a while are pinged (a no-op statement) so that
+ *                   MySQL's wait_timeout never closes them; lost ones are reconnected, also
+ *                   without blocking, and take jobs again once the handshake completes
+ */
+
+#ifndef _ASYNC_SQL_H_
+#define _ASYNC_SQL_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <list>
+#include <vector>
+#include <string>
+#include <functional>
+#include <mysql/mysql.h>
+#include <mysql/errmsg.h>
+
+#if defined(MARIADB_BASE_VERSION) || defined(MARIADB_PACKAGE_VERSION_ID)
+#error "ASYNC_SQL needs libmysqlclient from MySQL 8.0.16+, not MariaDB Connector/C"
+#elif !defined(MYSQL_VERSION_ID) || MYSQL_VERSION_ID < 80016
+#error "ASYNC_SQL needs libmysqlclient 8.0.16+ (mysql_*_nonblocking)"
+#endif
+#include "../log/log.h"
+#include "../lock/locker.h"
+
+using namespace std;
+
+/**
+ * @brief Completion callback of an async query
+ * @param res Stored result set (NULL for statements without one or on error), freed after the callback returns
+ * @param err mysql_errno() of the failed call, 0 on success
+ * @note Runs on the event loop thread: it must not block
+ */
+using ASYNC_CALLBACK = function<void(MYSQL_RES *res, unsigned int err)>;
+
+/**
+ * @class ASYNC_SQL
+ * @brief Non-blocking MySQL client multiplexed on the server's epoll instance (singleton)
+ */
+class ASYNC_SQL
+{
+private:
+    /**
+     * @struct ASYNC_JOB
+     * @brief A queued query and its completion callback
+     */
+    struct ASYNC_JOB
+    {
+        string sql;        ///< Statement text
+        ASYNC_CALLBACK cb; ///< Completion callback
+    };
+
+    /**
+     * @enum CONN_STATE
+     * @brief Where a connection is in its current job
+     */
+    enum CONN_STATE
+    {
+        CONN_IDLE = 0, ///< Waiting for a job
+        CONN_QUERY,    ///< Sending the statement / waiting for the reply header
+        CONN_STORE,    ///< Reading the result set
+        CONN_CONNECT,  ///< Handshake of a reconnect in progress
+        CONN_DEAD      ///< Lost (or never connected), out of epoll until tick() reconnects it
+    };
+
+    /**
+     * @struct ASYNC_CONN
+     * @brief One non-blocking connection and its in-flight job
+     */
+    struct ASYNC_CONN
+    {
+        MYSQL *conn;       ///< Connection handle, NULL while dead
+        int fd;            ///< Connection socket registered in epoll, -1 if none
+        CONN_STATE state;  ///< Progress of the current job
+        ASYNC_JOB job;     ///< Job being executed
+        MYSQL_RES *res;    ///< Result being stored
+        time_t last_used;  ///< Last exchange with the server, drives keep-alive pings
+    };
+
+    ASYNC_SQL();
+    ~ASYNC_SQL();
+
+    vector<ASYNC_CONN> m_conns; ///< Async connections
+    vector<int> m_fd_slot;      ///< fd -> index in m_conns + 1 (0 = not ours)
+    list<ASYNC_JOB> m_pending;  ///< Submitted jobs not yet started
+    LOCKER m_lock;              ///< Guards m_pending
+    int m_wakefd;               ///< eventfd that wakes the event loop on submit
+    int m_epollfd;              ///< Epoll instance the sockets are registered with
+    std::atomic<int> m_alive;   ///< Connected connections (idle or running a job)
+    int m_close_log;            ///< Logging disable flag
+
+    string m_url;      ///< Database server host, kept to reconnect
+    string m_user;     ///< Database username
+    string m_password; ///< Database password
+    string m_db_name;  ///< Database name
+    int m_port;        ///< Database server port
+
+    /**
+     * @brief Advance a connection as far as possible without blocking
+     */
+    void step(ASYNC_CONN &c);
+    /**
+     * @brief Advance the handshake of a reconnect
+     */
+    void connect_step(ASYNC_CONN &c);
+    /**
+     * @brief Close a dead connection and start connecting it again
+     */
+    void reconnect(ASYNC_CONN &c);
+    /**
+     * @brief The connection is lost: out of epoll until the next tick() reconnects it
+     */
+    void lose(ASYNC_CONN &c);
+    /**
+     * @brief Register the connection's socket, edge-triggered for both directions (once per
+     *        socket: a reconnect brings a new one)
+     */
+    void watch(ASYNC_CONN &c);
+    /**
+     * @brief Take the connection's socket out of epoll
+     */
+    void unwatch(ASYNC_CONN &c);
+    /**
+     * @brief Run the job's callback and return the connection to idle
+     */
+    void finish(ASYNC_CONN &c, MYSQL_RES *res, unsigned int err);
+    /**
+     * @brief Pop the next pending job into @p c
+     * @return false if nothing is pending
+     */
+    bool next_job(ASYNC_CONN &c);
+    /**
+     * @brief Fail every queued job once no connection is left to run it
+     */
+    void fail_pending();
+
+public:
+    /**
+     * @brief Get singleton instance
+     */
+    static ASYNC_SQL *get_instance();
+
+    /**
+     * @brief Open the async connections (all handshakes run concurrently)
+     * @param url Database server host
+     * @param user Database username
+     * @param password Database password
+     * @param db_name Database name
+     * @param port Database server port
+     * @param conn_num Number of async connections (0 disables the async path)
+     * @param close_log Disable logging if non-zero
+     */
+    void init(string url, string user, string password, string db_name, int port, int conn_num, int close_log);
+
+    /**
+     * @brief Register the connection sockets and the wake-up eventfd with the event loop
+     * @param epollfd Server epoll instance
+     */
+    void attach(int epollfd);
+
+    /**
+     * @brief Queue a query, callable from any thread
+     * @param sql Statement text (caller escapes any user input)
+     * @param cb Completion callback, run later on the event loop thread
+     * @return false if no async connection is available (cb is not called)
+     */
+    bool query(const string &sql, ASYNC_CALLBACK cb);
+
+    /**
+     * @brief Keep-alive and recovery, called by the event loop on every timer tick: pings
+     *        idle connections silent for a while, reconnects lost ones, and steps the busy
+     *        ones once (should an edge ever be missed, a job waits a tick, not forever)
+     */
+    void tick();
+
+    /**
+     * @brief Whether @p fd belongs to the async client
+     */
+    bool owns(int fd) const
+    {
+        return fd >= 0 && fd < (int)m_fd_slot.size() && m_fd_slot[fd] != 0;
+    }
+
+    /**
+     * @brief Event loop hook for fds for which owns() is true
+     * @param fd Ready file descriptor
+     * @param events Its epoll events
+     */
+    void on_event(int fd, uint32_t events);
+};
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * NOTE:
+ * A circuit breaker sits in front of a remote dependency (here the MySQL host) and stops
+ * callers from piling up on it once it is known to be unhealthy.
+ *
+ * - CLOSED: normal operation, every call is allowed. Consecutive failures (errors or calls
+ *   slower than the latency threshold) are counted, a successful call resets the count.
+ *   Steps that lead up to a call (taking a connection from the pool) only ever report
+ *   failures: they succeed even while every query fails, so counting them as successes
+ *   would keep resetting the count and the breaker would never trip.
+ * - OPEN: the failure threshold was reached. Every call fails fast without touching the
+ *   dependency until the cool-down expires.
+ * - HALF_OPEN: the cool-down expired. Exactly one caller is let through as a probe, its
+ *   result either closes the breaker again or re-opens it for another cool-down.
+ */
+
+#ifndef _CIRCUIT_BREAKER_H_
+#define _CIRCUIT_BREAKER_H_
+
+#include <atomic>
+#include <time.h>
+
+/**
+ * @class CIRCUIT_BREAKER
+ * @brief Lock-free three-state circuit breaker
+ *
+ * The CLOSED state check in allow() is a single atomic load so it can sit on the
+ * request hot path.
+ */
+class CIRCUIT_BREAKER
+{
+public:
+    /**
+     * @enum STATE
+     * @brief Breaker states
+     */
+    enum STATE
+    {
+        CLOSED = 0, ///< Calls flow normally
+        OPEN,       ///< Calls fail fast
+        HALF_OPEN   ///< One probe call is in flight
+    };
+
+private:
+    std::atomic<int> m_state;        ///< Current STATE
+    std::atomic<int> m_failures;     ///< Consecutive failures while CLOSED
+    std::atomic<long long> m_opened; ///< Monotonic ms timestamp of the last trip
+    std::atomic<bool> m_probing;     ///< A half-open probe has been handed out
+    std::atomic<long long> m_trips;  ///< Number of times the breaker opened
+
+    int m_failure_threshold; ///< Consecutive failures that trip the breaker
+    int m_slow_ms;           ///< Calls slower than this count as failures
+    int m_open_ms;           ///< Cool-down before a half-open probe
+
+    static long long now_ms()
+    {
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t.tv_sec * 1000LL + t.tv_nsec / 1000000;
+    }
+
+    void trip()
+    {
+        m_opened = now_ms();
+        m_probing = false;
+        m_state = OPEN;
+        m_trips++;
+    }
+
+    void fail()
+    {
+        if (m_state.load() == HALF_OPEN || ++m_failures >= m_failure_threshold)
+        {
+            m_failures = 0;
+            trip();
+        }
+    }
+
+public:
+    /**
+     * @brief Construct a closed breaker
+     * @param failure_threshold Consecutive failures before opening
+     * @param slow_ms Latency (ms) above which a successful call is still a failure
+     * @param open_ms Time (ms) to stay open before probing
+     */
+    CIRCUIT_BREAKER(int failure_threshold = 5, int slow_ms = 1000, int open_ms = 5000)
+        : m_state(CLOSED), m_failures(0), m_opened(0), m_probing(false), m_trips(0),
+          m_failure_threshold(failure_threshold), m_slow_ms(slow_ms), m_open_ms(open_ms) {}
+
+    /**
+     * @brief Ask whether a call may proceed
+     * @param[out] probe Set to true if this call is the half-open probe
+     * @return true if the caller may use the dependency, false to fail fast
+     */
+    bool allow(bool &probe)
+    {
+        probe = false;
+        int state = m_state.load(std::memory_order_acquire);
+        if (state == CLOSED)
+            return true;
+
+        if (state == OPEN && now_ms() - m_opened.load() < m_open_ms)
+            return false;
+
+        // cool-down expired (or already half-open): hand out a single probe
+        bool expected = false;
+        if (!m_probing.compare_exchange_strong(expected, true))
+            return false;
+
+        m_state = HALF_OPEN;
+        probe = true;
+        return true;
+    }
+
+    /**
+     * @brief Report the outcome of an allowed call
+     * @param ok Whether the call succeeded
+     * @param latency_ms How long the call took
+     */
+    void record(bool ok, long long latency_ms)
+    {
+        if (ok && latency_ms <= m_slow_ms)
+        {
+            // only write when needed, this runs for every successful call
+            if (m_failures.load(std::memory_order_relaxed) != 0)
+                m_failures = 0;
+            if (m_state.load() != CLOSED)
+            {
+                m_state = CLOSED;
+                m_probing = false;
+            }
+            return;
+        }
+        fail();
+    }
+
+    /**
+     * @brief Report the outcome of a step before the call (e.g. acquiring a connection)
+     * @param ok Whether the step succeeded
+     * @param latency_ms How long the step took
+     * @note A failed or slow step counts as a failure, a success is not reported: only
+     *       record() closes the breaker and resets the count
+     */
+    void record_failure(bool ok, long long latency_ms)
+    {
+        if (!ok || latency_ms > m_slow_ms)
+            fail();
+    }
+
+    /**
+     * @brief Current breaker state
+     */
+    STATE state() const
+    {
+        return (STATE)m_state.load();
+    }
+
+    /**
+     * @brief Number of times the breaker has opened since start
+     */
+    long long trips() const
+    {
+        return m_trips.load();
+    }
+};
+
+#endif
@@ -1,27 +1,81 @@
 /**
  * NOTE:
- *
+ * - Idle connections live in conn_list most-recently-used first. get_conn() pops the front so
+ *   the same few connections stay hot under light load and the cold ones collect at the back,
+ *   where the maintainer can ping them (before MySQL's wait_timeout kills them) or close them
+ *   when the pool is above its minimum size.
+ * - Every connection that is taken out of the list is first reserved with the semaphore
+ *   (reserve), the maintainer follows the same rule so it never races a caller.
+ * - m_total_conn counts connects in flight as well, so concurrent growers never overshoot
+ *   max_conn.
+ * - Write-behind: every insert_later() row costs a remote round-trip when sent on its own.
+ *   The writer thread instead takes the whole queue, sends one multi-row INSERT per target
+ *   and a single COMMIT, so a burst of N rows costs a few round-trips instead of N. Callbacks
+ *   only run after the COMMIT, so a success callback means the row is durable. The INSERTs
+ *   are prepared statements for 64, 32, ... 1 rows, any batch is a few of them back to back.
+ * - Prepared statements hang off a per-connection slot found by a scan of max_conn atomic
+ *   pointers: executing one takes no lock, only registering does.
  */
 
+#define LOG_MODULE LOG_MOD_SQL
+
 #include "connection_pool.h"
 #include <stdlib.h>
 #include <string>
 #include <string.h>
 #include <stdio.h>
 #include <list>
+#include <algorithm>
 #include <pthread.h>
 #include <iostream>
+#include <time.h>
 
 using namespace std;
 
+static const int ACQUIRE_TIMEOUT_MS = 500;  ///< Default deadline for a shared connection
+static const unsigned int IO_TIMEOUT_S = 3; ///< Connect/read/write timeout on every MySQL socket
+static const int MAINTAIN_INTERVAL_S = 5;   ///< Maintainer wake-up period
+static const int PING_IDLE_S = 30;          ///< Ping connections that have been silent this long
+static const int SHRINK_IDLE_S = 60;        ///< Close connections unused this long (above min_conn)
+static const size_t WRITE_BATCH_ROWS = 64;  ///< Flush the write-behind queue at this many rows (a power of two)
+static const int WRITE_FLUSH_MS = 5;        ///< ... or once its oldest row has waited this long
+
+static long long now_us()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000LL + t.tv_nsec / 1000;
+}
+
+thread_local vector<DB_CONNECTION_POOL::PINNED_SLOT> DB_CONNECTION_POOL::t_pinned;
+
 DB_CONNECTION_POOL::DB_CONNECTION_POOL()
 {
     m_curr_conn = 0;
     m_free_conn = 0;
+    m_max_conn = 0;
+    m_min_conn = 0;
+    m_total_conn = 0;
+    m_pin_conn = 0;
+    m_grow_wanted = 0;
+    m_stop = false;
+    m_maintaining = false;
+    m_acquire_timeout_ms = ACQUIRE_TIMEOUT_MS;
+    m_timeouts = 0;
+    m_rejected = 0;
+    m_reconnects = 0;
+    m_write_stop = false;
+    m_writing = false;
+    m_writer_started = false;
+    m_write_batches = 0;
+    m_write_rows = 0;
+    m_stmt_count = 0;
+    m_stmt_slots = NULL;
 }
 DB_CONNECTION_POOL::~DB_CONNECTION_POOL()
 {
     destroy_conn_pool();
+    delete[] m_stmt_slots;
 }
 
 DB_CONNECTION_POOL *DB_CONNECTION_POOL::get_instance()
@@ -30,53 +84,303 @@ DB_CONNECTION_POOL *DB_CONNECTION_POOL::get_instance()
     return &conn_pool;
 }
 
-void DB_CONNECTION_POOL::init(string url, string user, string password, string db_name, int port, int max_conn, int close_log)
+MYSQL *DB_CONNECTION_POOL::connect_one()
+{
+    // put all the config data to address
+    MYSQL *con = mysql_init(NULL);
+    if (con == NULL)
+    {
+        LOG_ERROR("%s", "Mysql Error: mysql_init out of memory");
+        return NULL;
+    }
+
+    // a stalled host must surface as an error, never as a worker blocked forever
+    mysql_options(con, MYSQL_OPT_CONNECT_TIMEOUT, &IO_TIMEOUT_S);
+    mysql_options(con, MYSQL_OPT_READ_TIMEOUT, &IO_TIMEOUT_S);
+    mysql_options(con, MYSQL_OPT_WRITE_TIMEOUT, &IO_TIMEOUT_S);
+
+    if (mysql_real_connect(con, m_url.c_str(), m_user.c_str(), m_password.c_str(), m_db_name.c_str(), m_port, NULL, 0) == NULL)
+    {
+        LOG_ERROR("MySQL Error: %s", mysql_error(con));
+        mysql_close(con); // never hand out a half-initialised handle
+        return NULL;
+    }
+    return con;
+}
+
+/**
+ * @struct CONNECT_TASK
+ * @brief Argument/result slot of one parallel connect thread
+ */
+struct CONNECT_TASK
+{
+    DB_CONNECTION_POOL *pool;
+    MYSQL *con;
+    pthread_t tid;
+    bool joinable;
+};
+
+vector<MYSQL *> DB_CONNECTION_POOL::connect_many(int count)
+{
+    vector<MYSQL *> conns;
+    if (count <= 0)
+        return conns;
+
+    // connecting is one handshake RTT each, doing them side by side costs ~1 RTT in total
+    vector<CONNECT_TASK> tasks(count);
+    auto run = [](void *args) -> void *
+    {
+        CONNECT_TASK *task = (CONNECT_TASK *)args;
+        mysql_thread_init();
+        task->con = task->pool->connect_one();
+        mysql_thread_end();
+        return NULL;
+    };
+
+    for (CONNECT_TASK &task : tasks)
+    {
+        task.pool = this;
+        task.con = NULL;
+        task.joinable = pthread_create(&task.tid, NULL, run, &task) == 0;
+        if (!task.joinable)
+            run(&task); // no thread available, connect inline
+    }
+    for (CONNECT_TASK &task : tasks)
+    {
+        if (task.joinable)
+            pthread_join(task.tid, NULL);
+        if (task.con)
+            conns.push_back(task.con);
+    }
+    return conns;
+}
+
+void DB_CONNECTION_POOL::add_conns(const vector<MYSQL *> &conns)
+{
+    time_t now = time(NULL);
+    lock.lock();
+    for (MYSQL *con : conns)
+    {
+        conn_list.push_front({con, now, now});
+        ++m_free_conn;
+    }
+    lock.unlock();
+
+    for (size_t i = 0; i < conns.size(); i++)
+        reserve.post();
+}
+
+MYSQL *DB_CONNECTION_POOL::validate(MYSQL *con)
+{
+    if (mysql_ping(con) == 0)
+        return con;
+
+    LOG_WARN("mysql pool: connection lost (%s), reconnecting", mysql_error(con));
+    close_conn(con);
+    ++m_reconnects;
+    return connect_one();
+}
+
+void DB_CONNECTION_POOL::init(string url, string user, string password, string db_name, int port, int max_conn, int close_log, int pin_conn, int min_conn)
 {
     m_url = url;
     m_port = port;
     m_user = user;
     m_password = password;
     m_db_name = db_name;
-    m_close_log = m_close_log;
+    m_close_log = close_log;
+    m_pin_conn = pin_conn;
+    m_max_conn = max_conn;
+    m_min_conn = (min_conn <= 0 || min_conn > max_conn) ? max_conn : min_conn;
 
+    // open connections never exceed max_conn (validate() closes before it reconnects)
+    m_stmt_slots = new STMT_SLOT[max_conn];
     for (int i = 0; i < max_conn; i++)
+    {
+        m_stmt_slots[i].conn = NULL;
+        for (MYSQL_STMT *&stmt : m_stmt_slots[i].stmts)
+            stmt = NULL;
+    }
+
+    // must run once before any thread touches the client library
+    mysql_library_init(0, NULL, NULL);
+
+    m_total_conn = m_min_conn;
+    vector<MYSQL *> conns = connect_many(m_min_conn);
+    lock.lock();
+    m_total_conn = (int)conns.size();
+    lock.unlock();
+    add_conns(conns);
+
+    if ((int)conns.size() < m_min_conn)
+        LOG_ERROR("mysql pool: only %d of %d connections opened", (int)conns.size(), m_min_conn);
+
+    m_stop = false;
+    if (pthread_create(&m_maintainer, NULL, maintain_thread, this) == 0)
+        m_maintaining = true;
+
+    // m_writing is set before the thread exists: from then on only the writer clears it,
+    // under m_write_lock
+    m_write_stop = false;
+    m_writing = true;
+    if (pthread_create(&m_writer, NULL, write_thread, this) == 0)
+        m_writer_started = true;
+    else
+        m_writing = false;
+}
+
+int DB_CONNECTION_POOL::pin_thread()
+{
+    if (m_pin_conn <= 0)
+        return 0;
+
+    while ((int)t_pinned.size() < m_pin_conn)
     {
         MYSQL *con = NULL;
-        // put all the config data to address
-        con = mysql_init(con);
+        bool open_new = false;
 
-        if (con == NULL)
+        lock.lock();
+        if (m_total_conn < m_max_conn)
         {
-            LOG_ERROR("Mysql Error");
-            exit(1);
+            ++m_total_conn; // reserve the slot, connect outside the lock
+            open_new = true;
         }
-        con = mysql_real_connect(con, url.c_str(), user.c_str(), password.c_str(), db_name.c_str(), port, NULL, 0);
-        if (con == NULL)
+        // never drain the shared pool completely, it is the fallback for every worker
+        else if (conn_list.size() > 1 && reserve.trywait())
         {
-            LOG_ERROR("MySQL Error");
+            con = conn_list.front().conn;
+            conn_list.pop_front();
+            --m_free_conn;
         }
-        conn_list.push_back(con);
-        ++m_free_conn;
+        lock.unlock();
+
+        if (open_new && (con = connect_one()) == NULL)
+        {
+            lock.lock();
+            --m_total_conn;
+            lock.unlock();
+        }
+        if (con == NULL)
+            break;
+
+        lock.lock();
+        pinned_list.push_back(con);
+        lock.unlock();
+        t_pinned.push_back({con, false, time(NULL)});
     }
-    reserve = SEM(m_free_conn);
-    m_max_conn = m_free_conn;
+
+    LOG_INFO("pinned %d mysql connection(s) to worker thread", (int)t_pinned.size());
+    return t_pinned.size();
 }
+
 MYSQL *DB_CONNECTION_POOL::get_conn()
 {
-    MYSQL *con = NULL;
-    if (0 == conn_list.size())
+    if (0 == m_max_conn)
         return NULL;
-    reserve.wait();
 
-    lock.lock();
+    bool probe = false;
+    if (!m_breaker.allow(probe))
+    {
+        ++m_rejected;
+        return NULL;
+    }
 
-    con = conn_list.front();
-    conn_list.pop_front();
+    MYSQL *con = NULL;
+    PINNED_SLOT *pinned = NULL;
+    time_t last_checked = 0;
+    long long start = now_us();
 
-    --m_free_conn;
-    ++m_curr_conn;
+    // fast path: connections pinned to this thread are never seen by other threads
+    for (PINNED_SLOT &slot : t_pinned)
+    {
+        if (!slot.busy)
+        {
+            slot.busy = true;
+            pinned = &slot;
+            con = slot.conn;
+            last_checked = slot.last_checked;
+            break;
+        }
+    }
 
-    lock.unlock();
+    if (con == NULL)
+    {
+        if (!reserve.trywait())
+        {
+            // pool exhausted: ask the maintainer for another connection while we wait
+            lock.lock();
+            if (m_total_conn + m_grow_wanted < m_max_conn)
+            {
+                ++m_grow_wanted;
+                m_maintain_cond.signal();
+            }
+            lock.unlock();
+
+            if (!reserve.timedwait(m_acquire_timeout_ms))
+            {
+                ++m_timeouts;
+                m_wait_hist.record(now_us() - start);
+                m_breaker.record_failure(false, m_acquire_timeout_ms);
+                LOG_WARN("mysql pool: no connection within %dms", m_acquire_timeout_ms);
+                return NULL;
+            }
+        }
+
+        lock.lock();
+
+        con = conn_list.front().conn;
+        last_checked = conn_list.front().last_checked;
+        conn_list.pop_front();
+
+        --m_free_conn;
+        ++m_curr_conn;
+
+        lock.unlock();
+        m_wait_hist.record(now_us() - start);
+    }
+
+    // lazy validation: only connections that have been silent for a while pay for a ping
+    bool ok = true;
+    if (probe || time(NULL) - last_checked >= PING_IDLE_S)
+    {
+        MYSQL *live = validate(con);
+        if (pinned)
+        {
+            pinned->last_checked = time(NULL);
+            pinned->conn = live;
+        }
+        if (live != con)
+        {
+            lock.lock();
+            if (pinned)
+                pinned_list.remove(con);
+            if (pinned && live)
+                pinned_list.push_back(live);
+            lock.unlock();
+        }
+        ok = live != NULL;
+        con = live;
+    }
+
+    // taking a connection never closes the breaker, the queries run on it do: only the
+    // half-open probe, whose ping is a round-trip to the server, reports a success here
+    if (probe)
+        m_breaker.record(ok, (now_us() - start) / 1000);
+    else
+        m_breaker.record_failure(ok, (now_us() - start) / 1000);
+    if (!ok)
+    {
+        // the connection is gone for good, give its slot back to the maintainer
+        lock.lock();
+        --m_total_conn;
+        if (pinned)
+            t_pinned.erase(t_pinned.begin() + (pinned - t_pinned.data()));
+        else
+            --m_curr_conn;
+        lock.unlock();
+        LOG_ERROR("mysql pool: reconnect failed%s", probe ? " (half-open probe)" : "");
+        return NULL;
+    }
     return con;
 }
 
@@ -84,9 +388,21 @@ bool DB_CONNECTION_POOL::release_conn(MYSQL *conn)
 {
     if (conn == NULL)
         return false;
+
+    for (PINNED_SLOT &slot : t_pinned)
+    {
+        if (slot.conn == conn)
+        {
+            slot.busy = false;
+            slot.last_checked = time(NULL);
+            return true;
+        }
+    }
+
+    time_t now = time(NULL);
     lock.lock();
 
-    conn_list.push_back(conn);
+    conn_list.push_front({conn, now, now});
     ++m_free_conn;
     --m_curr_conn;
 
@@ -96,29 +412,514 @@ bool DB_CONNECTION_POOL::release_conn(MYSQL *conn)
     return true;
 }
 
+void DB_CONNECTION_POOL::maintain()
+{
+    lock.lock();
+    int grow = m_grow_wanted;
+    m_grow_wanted = 0;
+    if (m_total_conn < m_min_conn && m_min_conn - m_total_conn > grow)
+        grow = m_min_conn - m_total_conn;
+    if (grow > m_max_conn - m_total_conn)
+        grow = m_max_conn - m_total_conn;
+    m_total_conn += grow; // reserved until the connects finish
+    lock.unlock();
+
+    if (grow > 0)
+    {
+        vector<MYSQL *> conns = connect_many(grow);
+        lock.lock();
+        m_total_conn -= grow - (int)conns.size();
+        lock.unlock();
+        add_conns(conns);
+        LOG_INFO("mysql pool: grew by %d connection(s)", (int)conns.size());
+    }
+
+    // take the cold connections off the back of the list, they are the ones that may have died
+    time_t now = time(NULL);
+    vector<SQL_CONN> cold;
+    vector<MYSQL *> unwanted;
+    lock.lock();
+    while (!conn_list.empty() && now - conn_list.back().last_checked >= PING_IDLE_S && reserve.trywait())
+    {
+        SQL_CONN idle = conn_list.back();
+        conn_list.pop_back();
+        --m_free_conn;
+
+        if (now - idle.last_used >= SHRINK_IDLE_S && m_total_conn > m_min_conn)
+        {
+            unwanted.push_back(idle.conn);
+            --m_total_conn;
+        }
+        else
+            cold.push_back(idle);
+    }
+    lock.unlock();
+
+    // mysql_close() sends COM_QUIT: a round-trip no caller should wait behind
+    for (MYSQL *con : unwanted)
+        close_conn(con);
+    if (!unwanted.empty())
+        LOG_INFO("mysql pool: closed %d idle connection(s)", (int)unwanted.size());
+
+    for (SQL_CONN &idle : cold)
+    {
+        MYSQL *live = validate(idle.conn);
+        if (live == NULL)
+        {
+            lock.lock();
+            --m_total_conn; // the next pass grows back to min_conn
+            lock.unlock();
+            continue;
+        }
+        lock.lock();
+        conn_list.push_back({live, idle.last_used, time(NULL)});
+        ++m_free_conn;
+        lock.unlock();
+        reserve.post();
+    }
+}
+
+void *DB_CONNECTION_POOL::maintain_thread(void *args)
+{
+    DB_CONNECTION_POOL *pool = (DB_CONNECTION_POOL *)args;
+    mysql_thread_init();
+
+    pool->lock.lock();
+    while (!pool->m_stop)
+    {
+        if (pool->m_grow_wanted == 0)
+        {
+            struct timespec t;
+            clock_gettime(CLOCK_REALTIME, &t);
+            t.tv_sec += MAINTAIN_INTERVAL_S;
+            pool->m_maintain_cond.timewait(pool->lock.get(), t);
+        }
+        if (pool->m_stop)
+            break;
+        pool->lock.unlock();
+        pool->maintain();
+        pool->lock.lock();
+    }
+    pool->lock.unlock();
+
+    mysql_thread_end();
+    return NULL;
+}
+
 void DB_CONNECTION_POOL::destroy_conn_pool()
 {
+    // the writer drains the queue through the pool, stop it while connections still exist
+    m_write_lock.lock();
+    m_write_stop = true;
+    m_write_cond.broadcast();
+    m_write_lock.unlock();
+    if (m_writer_started)
+    {
+        pthread_join(m_writer, NULL);
+        m_writer_started = false;
+    }
+
+    lock.lock();
+    m_stop = true;
+    m_maintain_cond.broadcast();
+    lock.unlock();
+    if (m_maintaining)
+    {
+        pthread_join(m_maintainer, NULL);
+        m_maintaining = false;
+    }
+
     lock.lock();
     if (conn_list.size() > 0)
     {
-        list<MYSQL *>::iterator it;
+        list<SQL_CONN>::iterator it;
         for (it = conn_list.begin(); it != conn_list.end(); ++it)
         {
-            MYSQL *con = *it;
-            mysql_close(con);
+            MYSQL *con = it->conn;
+            close_conn(con);
         }
         m_free_conn = 0;
         m_curr_conn = 0;
         conn_list.clear();
     }
+    // pinned connections are owned by worker threads that never exit, close them here
+    for (MYSQL *con : pinned_list)
+        close_conn(con);
+    pinned_list.clear();
+    m_total_conn = 0;
     lock.unlock();
 }
 
+void DB_CONNECTION_POOL::close_conn(MYSQL *con)
+{
+    STMT_SLOT *slot = stmt_slot(con, false);
+    if (slot)
+    {
+        for (MYSQL_STMT *&stmt : slot->stmts)
+        {
+            if (stmt)
+                mysql_stmt_close(stmt);
+            stmt = NULL;
+        }
+        slot->conn.store(NULL, std::memory_order_release);
+    }
+
+    mysql_close(con);
+}
+
+int DB_CONNECTION_POOL::register_stmt(const string &sql)
+{
+    m_stmt_lock.lock();
+    int id = m_stmt_count.load();
+    if (id == MAX_STMTS)
+    {
+        m_stmt_lock.unlock();
+        LOG_ERROR("mysql pool: cannot register more than %d statements", MAX_STMTS);
+        return -1;
+    }
+    // the text is in place before the count makes it visible to stmt_for()
+    m_stmt_sql[id] = sql;
+    m_stmt_count.store(id + 1, std::memory_order_release);
+    m_stmt_lock.unlock();
+    return id;
+}
+
+DB_CONNECTION_POOL::STMT_SLOT *DB_CONNECTION_POOL::stmt_slot(MYSQL *conn, bool claim)
+{
+    for (int i = 0; i < m_max_conn; i++)
+    {
+        if (m_stmt_slots[i].conn.load(std::memory_order_acquire) == conn)
+            return &m_stmt_slots[i];
+    }
+    if (!claim)
+        return NULL;
+    // the caller holds conn exclusively, nobody else can claim a slot for it meanwhile
+    for (int i = 0; i < m_max_conn; i++)
+    {
+        MYSQL *none = NULL;
+        if (m_stmt_slots[i].conn.compare_exchange_strong(none, conn))
+            return &m_stmt_slots[i];
+    }
+    return NULL;
+}
+
+MYSQL_STMT *DB_CONNECTION_POOL::stmt_for(MYSQL *conn, int stmt_id, unsigned int &err)
+{
+    err = CR_UNKNOWN_ERROR;
+    if (stmt_id < 0 || stmt_id >= m_stmt_count.load(std::memory_order_acquire))
+        return NULL;
+    STMT_SLOT *slot = stmt_slot(conn, true);
+    if (slot == NULL)
+    {
+        LOG_ERROR("%s", "mysql pool: no statement slot left for a connection");
+        return NULL;
+    }
+    if (slot->stmts[stmt_id])
+        return slot->stmts[stmt_id];
+
+    MYSQL_STMT *stmt = mysql_stmt_init(conn);
+    if (stmt == NULL)
+    {
+        err = CR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    if (mysql_stmt_prepare(stmt, m_stmt_sql[stmt_id].c_str(), m_stmt_sql[stmt_id].length()) != 0)
+    {
+        err = mysql_stmt_errno(stmt);
+        LOG_ERROR("mysql pool: prepare failed: %s", mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return NULL;
+    }
+    slot->stmts[stmt_id] = stmt;
+    return stmt;
+}
+
+void DB_CONNECTION_POOL::forget_stmt(MYSQL *conn, int stmt_id)
+{
+    STMT_SLOT *slot = stmt_slot(conn, false);
+    if (slot == NULL || slot->stmts[stmt_id] == NULL)
+        return;
+    mysql_stmt_close(slot->stmts[stmt_id]);
+    slot->stmts[stmt_id] = NULL;
+}
+
+MYSQL_STMT *DB_CONNECTION_POOL::run_stmt(MYSQL *conn, int stmt_id, MYSQL_BIND *params, unsigned int &err)
+{
+    // a statement the server no longer knows (it was restarted, or the handle went stale)
+    // is prepared once more and retried, any other error is final
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        MYSQL_STMT *stmt = stmt_for(conn, stmt_id, err);
+        if (stmt == NULL)
+            return NULL;
+
+        if ((params && mysql_stmt_bind_param(stmt, params)) ||
+            mysql_stmt_execute(stmt) != 0 ||
+            mysql_stmt_store_result(stmt) != 0)
+        {
+            err = mysql_stmt_errno(stmt);
+            if (err == ER_UNKNOWN_STMT_HANDLER && attempt == 0)
+            {
+                forget_stmt(conn, stmt_id);
+                continue;
+            }
+            return NULL;
+        }
+        err = 0;
+        return stmt;
+    }
+    return NULL;
+}
+
+MYSQL_STMT *DB_CONNECTION_POOL::execute_stmt(MYSQL *conn, int stmt_id, MYSQL_BIND *params, unsigned int *err_out)
+{
+    if (err_out)
+        *err_out = CR_SERVER_GONE_ERROR;
+    if (conn == NULL)
+        return NULL;
+
+    long long start = now_us();
+    unsigned int err;
+    MYSQL_STMT *stmt = run_stmt(conn, stmt_id, params, err);
+    if (stmt == NULL)
+        LOG_ERROR("mysql pool: statement %d failed: %u", stmt_id, err);
+
+    // only losing the server counts against it, constraint violations are the caller's business
+    bool server_ok = err != CR_SERVER_GONE_ERROR && err != CR_SERVER_LOST;
+    m_breaker.record(server_ok, (now_us() - start) / 1000);
+    if (err_out)
+        *err_out = err;
+    return stmt;
+}
+
+void DB_CONNECTION_POOL::insert_later(const string &target, const vector<string> &row, WRITE_CALLBACK cb)
+{
+    // one placeholder per column of "table(col, ...)", the statement is built from the target
+    if (row.empty() || (size_t)count(target.begin(), target.end(), ',') + 1 != row.size())
+    {
+        cb(ER_WRONG_VALUE_COUNT_ON_ROW);
+        return;
+    }
+
+    m_write_lock.lock();
+    if (!m_writing)
+    {
+        m_write_lock.unlock();
+        cb(CR_SERVER_GONE_ERROR);
+        return;
+    }
+    m_writes.push_back({target, row, cb, 0, now_us()});
+    // the writer sleeps until the oldest row is due, wake it early only for a full batch
+    if (m_writes.size() == 1 || m_writes.size() >= WRITE_BATCH_ROWS)
+        m_write_cond.signal();
+    m_write_lock.unlock();
+}
+
+future<unsigned int> DB_CONNECTION_POOL::insert_later(const string &target, const vector<string> &row)
+{
+    shared_ptr<promise<unsigned int>> done = make_shared<promise<unsigned int>>();
+    insert_later(target, row, [done](unsigned int err)
+                 { done->set_value(err); });
+    return done->get_future();
+}
+
+int DB_CONNECTION_POOL::insert_stmt(const string &target, size_t rows, size_t cols)
+{
+    vector<int> &ids = m_insert_stmts[target];
+    size_t log2 = 0;
+    while (((size_t)1 << log2) < rows)
+        ++log2;
+    if (ids.size() <= log2)
+        ids.resize(log2 + 1, -1);
+    if (ids[log2] != -1)
+        return ids[log2];
+
+    string group = "(?";
+    for (size_t i = 1; i < cols; i++)
+        group += ",?";
+    group += ')';
+    string sql = "INSERT INTO " + target + " VALUES " + group;
+    for (size_t i = 1; i < rows; i++)
+        sql += ',' + group;
+    ids[log2] = register_stmt(sql);
+    return ids[log2];
+}
+
+void DB_CONNECTION_POOL::insert_rows(MYSQL *conn, vector<PENDING_WRITE *> &rows)
+{
+    size_t cols = rows[0]->row.size();
+    vector<MYSQL_BIND> params;
+    vector<unsigned long> lengths;
+
+    // execute the statement for rows[first, first + n), false if the server is gone
+    auto insert = [&](size_t first, size_t n, unsigned int &err)
+    {
+        params.assign(n * cols, MYSQL_BIND());
+        lengths.resize(n * cols);
+        for (size_t i = 0; i < n * cols; i++)
+        {
+            const string &value = rows[first + i / cols]->row[i % cols];
+            lengths[i] = value.length();
+            params[i].buffer_type = MYSQL_TYPE_STRING;
+            params[i].buffer = (void *)value.data();
+            params[i].buffer_length = value.length();
+            params[i].length = &lengths[i];
+        }
+        MYSQL_STMT *stmt = run_stmt(conn, insert_stmt(rows[0]->target, n, cols), params.data(), err);
+        if (stmt)
+            mysql_stmt_free_result(stmt);
+        return err != CR_SERVER_GONE_ERROR && err != CR_SERVER_LOST;
+    };
+
+    size_t first = 0;
+    while (first < rows.size())
+    {
+        size_t n = WRITE_BATCH_ROWS;
+        while (n > rows.size() - first)
+            n /= 2;
+
+        unsigned int err;
+        bool alive = insert(first, n, err);
+        if (err && (n == 1 || !alive))
+        {
+            // the server is gone: nothing after this gets in either
+            for (size_t i = first; i < (alive ? first + 1 : rows.size()); i++)
+                rows[i]->err = err;
+            if (!alive)
+                return;
+        }
+        else if (err)
+        {
+            // one bad row (duplicate key, ...) rejects the whole statement: retry each row
+            // alone inside the same transaction so only the offending rows fail
+            for (size_t i = first; i < first + n; i++)
+            {
+                if (!insert(i, 1, rows[i]->err))
+                {
+                    for (size_t j = i; j < rows.size(); j++)
+                        rows[j]->err = rows[i]->err;
+                    return;
+                }
+            }
+        }
+        first += n;
+    }
+}
+
+void DB_CONNECTION_POOL::flush_writes(list<PENDING_WRITE> &batch)
+{
+    long long start = now_us();
+    MYSQL *conn = get_conn();
+    if (conn == NULL)
+    {
+        for (PENDING_WRITE &w : batch)
+            w.cb(CR_SERVER_GONE_ERROR);
+        return;
+    }
+
+    map<string, vector<PENDING_WRITE *>> by_target;
+    for (PENDING_WRITE &w : batch)
+        by_target[w.target].push_back(&w);
+
+    unsigned int err = 0;
+    if (mysql_autocommit(conn, false))
+        err = mysql_errno(conn);
+    for (auto it = by_target.begin(); err == 0 && it != by_target.end(); ++it)
+    {
+        insert_rows(conn, it->second);
+        unsigned int last = it->second.back()->err;
+        if (last == CR_SERVER_GONE_ERROR || last == CR_SERVER_LOST)
+            err = last;
+    }
+    if (err == 0 && mysql_commit(conn))
+        err = mysql_errno(conn);
+    if (err)
+    {
+        mysql_rollback(conn);
+        LOG_ERROR("mysql pool: write-behind batch of %d row(s) failed: %s", (int)batch.size(), mysql_error(conn));
+    }
+    mysql_autocommit(conn, true);
+    release_conn(conn);
+
+    report_query(err == 0, (now_us() - start) / 1000);
+    if (err == 0)
+    {
+        ++m_write_batches;
+        for (PENDING_WRITE &w : batch)
+            m_write_rows += w.err == 0;
+    }
+
+    // callbacks only after COMMIT: success means durable
+    for (PENDING_WRITE &w : batch)
+        w.cb(err ? err : w.err);
+}
+
+void *DB_CONNECTION_POOL::write_thread(void *args)
+{
+    DB_CONNECTION_POOL *pool = (DB_CONNECTION_POOL *)args;
+    mysql_thread_init();
+
+    pool->m_write_lock.lock();
+    while (true)
+    {
+        if (pool->m_writes.empty())
+        {
+            if (pool->m_write_stop)
+                break;
+            pool->m_write_cond.wait(pool->m_write_lock.get());
+            continue;
+        }
+
+        long long due_us = pool->m_writes.front().queued_us + WRITE_FLUSH_MS * 1000LL;
+        if (!pool->m_write_stop && pool->m_writes.size() < WRITE_BATCH_ROWS && now_us() < due_us)
+        {
+            // sleep until the oldest row is due, more rows may join the batch meanwhile
+            struct timespec t;
+            clock_gettime(CLOCK_REALTIME, &t);
+            long long wake_ns = t.tv_nsec + (due_us - now_us()) * 1000LL;
+            t.tv_sec += wake_ns / 1000000000LL;
+            t.tv_nsec = wake_ns % 1000000000LL;
+            pool->m_write_cond.timewait(pool->m_write_lock.get(), t);
+            continue;
+        }
+
+        // a backlog leaves in WRITE_BATCH_ROWS slices, keeping each statement and transaction small
+        list<PENDING_WRITE> batch;
+        list<PENDING_WRITE>::iterator end = pool->m_writes.begin();
+        for (size_t n = 0; n < WRITE_BATCH_ROWS && end != pool->m_writes.end(); n++)
+            ++end;
+        batch.splice(batch.end(), pool->m_writes, pool->m_writes.begin(), end);
+        pool->m_write_lock.unlock();
+        pool->flush_writes(batch);
+        pool->m_write_lock.lock();
+    }
+    pool->m_writing = false;
+    pool->m_write_lock.unlock();
+
+    mysql_thread_end();
+    return NULL;
+}
+
 int DB_CONNECTION_POOL::get_free_count()
 {
     return this->m_free_conn;
 }
 
+void DB_CONNECTION_POOL::report_query(bool ok, long long latency_ms)
+{
+    m_breaker.record(ok, latency_ms);
+}
+
+string DB_CONNECTION_POOL::stats()
+{
+    static const char *state_name[] = {"closed", "open", "half-open"};
+    char line[256];
+    snprintf(line, sizeof(line), "breaker=%s trips=%lld timeouts=%lld rejected=%lld reconnects=%lld open=%d free=%d busy=%d pinned=%d write_batches=%lld write_rows=%lld\n",
+             state_name[m_breaker.state()], m_breaker.trips(), m_timeouts.load(), m_rejected.load(), m_reconnects.load(),
+             m_total_conn, m_free_conn, m_curr_conn, (int)pinned_list.size(), m_write_batches.load(), m_write_rows.load());
+    return line + m_wait_hist.dump("wait");
+}
+
 // Double pointer is used because if we want to modify a pointer we have to use double pointer
 CONNECTION_POOL_RAII::CONNECTION_POOL_RAII(MYSQL **SQL, DB_CONNECTION_POOL *conn_pool)
 {
@@ -132,4 +933,4 @@ CONNECTION_POOL_RAII::CONNECTION_POOL_RAII(MYSQL **SQL, DB_CONNECTION_POOL *conn
 CONNECTION_POOL_RAII::~CONNECTION_POOL_RAII()
 {
     poolRAII->release_conn(conRAII);
-}
\ No newline at end of file
+}
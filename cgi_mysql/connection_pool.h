@@ -2,12 +2,29 @@
 #define _CONNECTION_POOL_
 
 #include <list>
+#include <map>
+#include <future>
+#include <functional>
+#include <vector>
+#include <string>
 #include <mysql/mysql.h>
+#include <mysql/errmsg.h>
+#include <mysql/mysqld_error.h>
 #include "../log/log.h"
 #include "../lock/locker.h"
+#include "circuit_breaker.h"
+#include "wait_histogram.h"
 
 using namespace std;
 
+/**
+ * @brief Durability callback of a write-behind insert
+ * @param err 0 once the row is committed, otherwise the MySQL error that rejected it
+ *            (ER_DUP_ENTRY, CR_SERVER_GONE_ERROR when no connection was available, ...)
+ * @note Runs on the writer thread, it must not block
+ */
+using WRITE_CALLBACK = function<void(unsigned int err)>;
+
 /**
  * @class DB_CONNECTION_POOL
  * @brief MySQL database connection pool manager (thread-safe)
@@ -16,6 +33,14 @@ using namespace std;
  * - Singleton pattern for global access
  * - Connection reuse for performance
  * - Semaphore-controlled connection limiting
+ * - Optional per-worker pinned connections (no locking on the hot path)
+ * - Bounded acquisition wait and a circuit breaker that fails fast when MySQL stalls
+ * - Self-healing: parallel connects, lazy and periodic pings, reconnect on failure,
+ *   and pool size adjusted between min/max bounds according to demand
+ * - Prepared statement registry: statements are declared once and prepared lazily on
+ *   each connection, then executed over the binary protocol
+ * - Write-behind inserts: queued rows are coalesced into multi-row INSERTs committed in
+ *   one transaction by a writer thread, flushed on batch size or age
  * - RAII wrapper for automatic management
  */
 class DB_CONNECTION_POOL
@@ -24,20 +49,231 @@ private:
     DB_CONNECTION_POOL();
     ~DB_CONNECTION_POOL();
 
-    int m_max_conn;          ///< Maximum connection capacity
-    int m_curr_conn;         ///< Current active connections
-    int m_free_conn;         ///< Available idle connections
-    LOCKER lock;             ///< Mutex for thread safety
-    list<MYSQL *> conn_list; ///< Pool of MySQL connections
-    SEM reserve;             ///< Semaphore for connection limiting
+    /**
+     * @struct SQL_CONN
+     * @brief An idle connection waiting in the shared pool
+     */
+    struct SQL_CONN
+    {
+        MYSQL *conn;         ///< Connection handle
+        time_t last_used;    ///< When it was last released by a caller (drives shrinking)
+        time_t last_checked; ///< When it last talked to the server (drives health pings)
+    };
+
+    int m_max_conn;            ///< Upper bound on open connections (shared + pinned)
+    int m_min_conn;            ///< Connections kept open even when idle
+    int m_total_conn;          ///< Open connections (shared + pinned) plus connects in flight
+    int m_curr_conn;           ///< Current active connections
+    int m_free_conn;           ///< Available idle connections
+    LOCKER lock;               ///< Mutex for thread safety
+    list<SQL_CONN> conn_list;  ///< Idle connections, most recently used at the front
+    SEM reserve;               ///< Semaphore for connection limiting
+
+    int m_pin_conn;            ///< Connections pinned to each worker thread (0 = shared pool only)
+    list<MYSQL *> pinned_list; ///< Every pinned connection, kept only so destroy_conn_pool() can close them
+
+    /**
+     * @struct PINNED_SLOT
+     * @brief A connection owned by exactly one worker thread
+     */
+    struct PINNED_SLOT
+    {
+        MYSQL *conn;         ///< Pinned connection handle
+        bool busy;           ///< Handed out by get_conn() and not yet released
+        time_t last_checked; ///< When it last talked to the server
+    };
+    static thread_local vector<PINNED_SLOT> t_pinned; ///< Connections pinned to the calling thread
+
+    pthread_t m_maintainer;     ///< Background thread doing health pings, growing and shrinking
+    CONDITION m_maintain_cond;  ///< Wakes the maintainer early (demand or shutdown), paired with lock
+    int m_grow_wanted;          ///< Connections requested by callers that found the pool empty
+    bool m_stop;                ///< Tells the maintainer to exit
+    bool m_maintaining;         ///< The maintainer thread is running
+
+    int m_acquire_timeout_ms;           ///< Longest get_conn() waits for a shared connection
+    CIRCUIT_BREAKER m_breaker;          ///< Trips on acquisition timeouts, slow waits and query errors; only queries close it
+    WAIT_HISTOGRAM m_wait_hist;         ///< Time spent waiting for a shared connection
+    std::atomic<long long> m_timeouts;  ///< get_conn() calls that hit the deadline
+    std::atomic<long long> m_rejected;  ///< get_conn() calls refused by the open breaker
+    std::atomic<long long> m_reconnects; ///< Dead connections that were replaced
+
+    static const int MAX_STMTS = 32; ///< Statements that can be registered
+
+    /**
+     * @struct STMT_SLOT
+     * @brief Statements prepared on one open connection
+     * @note Claimed by the first statement a connection executes and released by close_conn().
+     *       Only the thread holding the connection touches stmts, so a lookup takes no lock.
+     */
+    struct STMT_SLOT
+    {
+        std::atomic<MYSQL *> conn;      ///< Owning connection, NULL while the slot is free
+        MYSQL_STMT *stmts[MAX_STMTS];   ///< Indexed by statement id, NULL until prepared
+    };
+
+    string m_stmt_sql[MAX_STMTS];        ///< Registered statement text, indexed by statement id
+    std::atomic<int> m_stmt_count;       ///< Registered statements, published after their text
+    LOCKER m_stmt_lock;                  ///< Serializes register_stmt()
+    STMT_SLOT *m_stmt_slots;             ///< One slot per connection the pool may open (max_conn)
+    map<string, vector<int>> m_insert_stmts; ///< Write-behind INSERTs per target, by log2(rows); writer thread only
+
+    /**
+     * @struct PENDING_WRITE
+     * @brief A row waiting in the write-behind queue
+     */
+    struct PENDING_WRITE
+    {
+        string target;      ///< "table(col, ...)" the row goes to
+        vector<string> row; ///< Column values, in target order
+        WRITE_CALLBACK cb;  ///< Durability callback
+        unsigned int err;   ///< Outcome, filled in by the flush
+        long long queued_us; ///< When insert_later() queued it
+    };
+    list<PENDING_WRITE> m_writes;       ///< Queued rows, oldest first
+    LOCKER m_write_lock;                ///< Guards the write-behind queue
+    CONDITION m_write_cond;             ///< Wakes the writer (batch full or shutdown)
+    pthread_t m_writer;                 ///< Write-behind flusher thread
+    bool m_write_stop;                  ///< Tells the writer to drain the queue and exit
+    bool m_writing;                     ///< The writer accepts rows (guarded by m_write_lock)
+    bool m_writer_started;              ///< m_writer was created and not joined yet
+    std::atomic<long long> m_write_batches; ///< Transactions committed by the writer
+    std::atomic<long long> m_write_rows;    ///< Rows committed by the writer
+
+    /**
+     * @brief Open one connection using the stored credentials
+     * @return Connected handle, or NULL (the failed handle is closed, never pooled)
+     */
+    MYSQL *connect_one();
+    /**
+     * @brief Open @p count connections concurrently, one short-lived thread each
+     * @return The handles that connected successfully
+     */
+    vector<MYSQL *> connect_many(int count);
+    /**
+     * @brief Ping a connection and replace it if the server no longer answers
+     * @param con Connection to validate
+     * @return A live handle (possibly new) or NULL if reconnecting failed
+     */
+    MYSQL *validate(MYSQL *con);
+    /**
+     * @brief Close a connection together with the statements prepared on it
+     * @note Every pooled connection must be closed through here: a new connection may get
+     *       the same address and must not inherit stale statement handles
+     */
+    void close_conn(MYSQL *con);
+    /**
+     * @brief Find the statement slot of @p conn
+     * @param claim Take a free slot if it has none yet
+     * @return Slot or NULL (none, or all taken)
+     */
+    STMT_SLOT *stmt_slot(MYSQL *conn, bool claim);
+    /**
+     * @brief Find the statement @p stmt_id on @p conn, preparing it on first use
+     * @param[out] err Error number when NULL is returned
+     * @return Prepared statement or NULL if preparing failed
+     */
+    MYSQL_STMT *stmt_for(MYSQL *conn, int stmt_id, unsigned int &err);
+    /**
+     * @brief Drop the cached statement @p stmt_id of @p conn so the next use prepares it again
+     */
+    void forget_stmt(MYSQL *conn, int stmt_id);
+    /**
+     * @brief execute_stmt() without logging or feeding the circuit breaker
+     */
+    MYSQL_STMT *run_stmt(MYSQL *conn, int stmt_id, MYSQL_BIND *params, unsigned int &err);
+    /**
+     * @brief Statement inserting @p rows rows of @p cols values into @p target (a power of
+     *        two), registered on first use
+     * @return Statement id, -1 if the registry is full
+     */
+    int insert_stmt(const string &target, size_t rows, size_t cols);
+    /**
+     * @brief Add freshly opened connections to the shared pool
+     */
+    void add_conns(const vector<MYSQL *> &conns);
+    /**
+     * @brief One maintenance pass: grow on demand or up to min, ping idle connections, shrink
+     */
+    void maintain();
+    /**
+     * @brief Maintenance thread entry point
+     */
+    static void *maintain_thread(void *args);
+    /**
+     * @brief Insert one batch in a single transaction and run its callbacks
+     */
+    void flush_writes(list<PENDING_WRITE> &batch);
+    /**
+     * @brief Insert the rows of one target, multi-row first and row by row if that is rejected
+     * @note Rows go out in chunks of WRITE_BATCH_ROWS, then halves of it down to one row, so
+     *       any batch costs a few executions of a handful of prepared statements
+     */
+    void insert_rows(MYSQL *conn, vector<PENDING_WRITE *> &rows);
+    /**
+     * @brief Write-behind thread entry point
+     */
+    static void *write_thread(void *args);
 
 public:
     /**
      * @brief Acquire a database connection
-     * @return MYSQL* Connection handle (NULL if failed)
-     * @note Blocks if no connections available (when pool exhausted)
+     * @return MYSQL* Connection handle (NULL if the pool is empty, the wait timed out
+     *         or the circuit breaker is open; callers should answer 503)
+     * @note A free connection pinned to the calling thread is returned without any
+     *       synchronization; otherwise falls back to the shared pool and waits at most
+     *       m_acquire_timeout_ms for it. While the breaker is half-open the caller
+     *       doubles as the probe and the connection is pinged before being returned.
      */
     MYSQL *get_conn();
+    /**
+     * @brief Report the outcome of a query so failures and slow queries feed the breaker
+     * @param ok Whether the query succeeded
+     * @param latency_ms Query duration in milliseconds
+     */
+    void report_query(bool ok, long long latency_ms);
+    /**
+     * @brief Declare a statement that handlers will execute with execute_stmt()
+     * @param sql Statement text with '?' placeholders
+     * @return Statement id
+     * @note Nothing is sent to the server here, each connection prepares the statement the
+     *       first time it executes it (again after a reconnect). Register at startup, at most
+     *       MAX_STMTS statements (the write-behind INSERTs included); -1 once full.
+     */
+    int register_stmt(const string &sql);
+    /**
+     * @brief Execute a registered statement on a connection obtained from get_conn()
+     * @param conn Connection the caller holds
+     * @param stmt_id Id returned by register_stmt()
+     * @param params One bind per placeholder (NULL if the statement has none)
+     * @param[out] err Error number of the failed call, 0 on success (optional)
+     * @return The executed statement with its result set buffered client-side, ready for
+     *         mysql_stmt_bind_result()/mysql_stmt_fetch(); NULL on error. The caller must
+     *         call mysql_stmt_free_result() when done, the handle itself stays cached.
+     * @note Parameters travel in binary form, they are never spliced into the SQL text.
+     *       Failures and the execution time are reported to the circuit breaker. Finding the
+     *       prepared handle takes no lock: the statements hang off the connection's slot.
+     */
+    MYSQL_STMT *execute_stmt(MYSQL *conn, int stmt_id, MYSQL_BIND *params, unsigned int *err = NULL);
+    /**
+     * @brief Queue a row for a batched insert and return at once
+     * @param target Table and column list, e.g. "user(username, passwd)"
+     * @param row Column values in the order of @p target (ER_WRONG_VALUE_COUNT_ON_ROW at
+     *            once if their number differs)
+     * @param cb Called once the row is committed or rejected
+     * @note Rows for the same target are sent as multi-row prepared INSERTs, all rows of a flush
+     *       share one transaction. A batch goes out when WRITE_BATCH_ROWS rows are queued or
+     *       the oldest row has waited WRITE_FLUSH_MS.
+     */
+    void insert_later(const string &target, const vector<string> &row, WRITE_CALLBACK cb);
+    /**
+     * @brief Future flavour of insert_later()
+     * @return Becomes ready with the error number (0 = committed)
+     */
+    future<unsigned int> insert_later(const string &target, const vector<string> &row);
+    /**
+     * @brief Render pool counters, breaker state and the wait-time histogram as text
+     */
+    string stats();
     /**
      * @brief Release a connection back to pool
      * @param conn Connection to release
@@ -49,6 +285,14 @@ public:
      * @return Number of free connections
      */
     int get_free_count();
+    /**
+     * @brief Move connections from the shared pool into the calling thread's pinned set
+     * @return Number of connections pinned to the calling thread
+     * @note Called once by each worker thread before it starts taking requests. Opens
+     *       new connections while below max_conn, otherwise takes them from the shared
+     *       pool; at least one connection is always left shared as fallback.
+     */
+    int pin_thread();
     /**
      * @brief Destroy all connections in pool
      * @note Called automatically on destructor
@@ -70,12 +314,14 @@ public:
      * @param port Database server port
      * @param max_conn Maximum pool size
      * @param close_log Disable logging if non-zero
+     * @param pin_conn Connections to pin to each worker thread (0 = shared pool only)
+     * @param min_conn Connections opened at startup and kept when idle (<= 0 or > max_conn: max_conn)
      */
-    void init(string url, string user, string password, string db_name, int port, int max_conn, int close_log);
+    void init(string url, string user, string password, string db_name, int port, int max_conn, int close_log, int pin_conn = 0, int min_conn = 0);
 
 public:
     string m_url;      ///< Database server host
-    string m_port;     ///< Database server port
+    int m_port;        ///< Database server port
     string m_user;     ///< Database username
     string m_password; ///< Database password
     string m_db_name;  ///< Database name
@@ -0,0 +1,165 @@
+#define LOG_MODULE LOG_MOD_SQL
+
+#include "user_cache.h"
+#include <sched.h>
+#include <algorithm>
+
+USER_CACHE::USER_CACHE()
+{
+    m_store = NULL;
+    m_close_log = 0;
+    m_reader_count = 0;
+    m_epoch = 1;
+    for (READER &reader : m_readers)
+        reader.epoch = 0;
+    for (SHARD &shard : m_shards)
+        shard.users = new USER_MAP();
+}
+
+USER_CACHE::~USER_CACHE()
+{
+    for (SHARD &shard : m_shards)
+        delete shard.users.load();
+}
+
+USER_CACHE *USER_CACHE::get_instance()
+{
+    static USER_CACHE user_cache;
+    return &user_cache;
+}
+
+int USER_CACHE::reader_slot()
+{
+    // not in the read_shard() template: each instantiation would get its own thread_local,
+    // and a thread would take one slot per kind of lookup
+    static thread_local int t_reader = -1;
+    if (t_reader == -1)
+        t_reader = m_reader_count.fetch_add(1);
+    return t_reader;
+}
+
+template <typename F>
+bool USER_CACHE::read_shard(SHARD &shard, F &&read)
+{
+    int slot = reader_slot();
+    if (slot >= MAX_READERS)
+    {
+        shard.write_lock.lock();
+        bool ret = read(*shard.users.load());
+        shard.write_lock.unlock();
+        return ret;
+    }
+
+    // seq_cst: the slot is visible before the pointer is read, so a writer that swaps the
+    // pointer afterwards sees this reader in synchronize() and waits for it
+    READER &reader = m_readers[slot];
+    reader.epoch.store(m_epoch.load(std::memory_order_acquire));
+    bool ret = read(*shard.users.load());
+    reader.epoch.store(0, std::memory_order_release);
+    return ret;
+}
+
+void USER_CACHE::synchronize()
+{
+    // readers that enter from now on see the new epoch, and the new map
+    uint64_t target = m_epoch.fetch_add(1) + 1;
+    int readers = std::min(m_reader_count.load(), MAX_READERS);
+    for (int i = 0; i < readers; i++)
+    {
+        while (true)
+        {
+            uint64_t epoch = m_readers[i].epoch.load();
+            if (epoch == 0 || epoch >= target)
+                break;
+            sched_yield(); // a lookup is short
+        }
+    }
+}
+
+void USER_CACHE::replace(SHARD &shard, const USER_MAP *users)
+{
+    const USER_MAP *old = shard.users.exchange(users);
+    synchronize();
+    delete old;
+}
+
+int USER_CACHE::init(USER_STORE *store, int close_log)
+{
+    m_store = store;
+    m_close_log = close_log;
+
+    // build every shard privately, then publish each one in a single store
+    USER_MAP maps[SHARDS];
+    int count = m_store->load([&maps](const string &name, const string &password)
+                              { maps[hash<string>()(name) % SHARDS][name] = password; });
+    if (count < 0)
+    {
+        LOG_ERROR("user cache: %s store unreadable, starting empty", m_store->name());
+        return 0;
+    }
+
+    for (int i = 0; i < SHARDS; i++)
+    {
+        m_shards[i].write_lock.lock();
+        replace(m_shards[i], new USER_MAP(std::move(maps[i])));
+        m_shards[i].write_lock.unlock();
+    }
+
+    LOG_INFO("user cache: loaded %d user(s) from %s store", count, m_store->name());
+    return count;
+}
+
+bool USER_CACHE::authenticate(const string &name, const string &password)
+{
+    return read_shard(shard_of(name), [&](const USER_MAP &users)
+                      {
+        USER_MAP::const_iterator it = users.find(name);
+        return it != users.end() && it->second == password; });
+}
+
+bool USER_CACHE::contains(const string &name)
+{
+    return read_shard(shard_of(name), [&](const USER_MAP &users)
+                      { return users.count(name) != 0; });
+}
+
+void USER_CACHE::add_user_later(const string &name, const string &password, function<void(ADD_RESULT)> cb)
+{
+    // the reservation makes a concurrent registration of the same name fail here, whatever
+    // keys the table has
+    SHARD &shard = shard_of(name);
+    shard.write_lock.lock();
+    bool taken = shard.users.load()->count(name) != 0 || !shard.reserved.insert(name).second;
+    shard.write_lock.unlock();
+    if (taken)
+    {
+        cb(EXISTS);
+        return;
+    }
+
+    m_store->insert(name, password, [this, &shard, name, password, cb](unsigned int err)
+                    {
+        shard.write_lock.lock();
+        shard.reserved.erase(name);
+        if (err == 0)
+        {
+            // the name goes from reserved to published in one critical section
+            USER_MAP *copy = new USER_MAP(*shard.users.load());
+            (*copy)[name] = password;
+            replace(shard, copy);
+        }
+        shard.write_lock.unlock();
+        cb(err == 0 ? ADDED : err == ER_DUP_ENTRY ? EXISTS : DB_ERROR); });
+}
+
+size_t USER_CACHE::size()
+{
+    size_t total = 0;
+    for (SHARD &shard : m_shards)
+    {
+        read_shard(shard, [&](const USER_MAP &users)
+                   { total += users.size();
+                     return true; });
+    }
+    return total;
+}
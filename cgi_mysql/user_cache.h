@@ -0,0 +1,158 @@
+/**
+ * NOTE:
+ * Logins vastly outnumber registrations, so the user table is mirrored in memory once at
+ * startup and /login never touches the storage backend (USER_STORE, MySQL in production).
+ *
+ * READ PATH (RCU): each shard publishes an immutable map through an atomic pointer. A reader
+ * announces itself in its own cache line (the epoch it entered in), loads the pointer and
+ * looks the user up: no lock and no write to memory shared with other readers (no refcount).
+ * A writer that replaces a map frees the old one only after synchronize(): once every reader
+ * that entered before the swap has left, no one can still see it. Reader slots are claimed
+ * per thread on first use; threads beyond MAX_READERS read under the shard lock instead.
+ *
+ * WRITE PATH: a registration first reserves the name in its shard (under the shard lock, so
+ * two concurrent registrations of one name cannot both pass), then inserts into the store
+ * (write-through, the table stays the source of truth), then copies the shard, adds the user
+ * and publishes the copy, dropping the reservation in the same critical section. Writers of
+ * a shard are serialized by the shard lock. Each registration copies one shard, 1/SHARDS of
+ * the table: with tens of registrations per second that stays cheap up to ~10^5 users, a far
+ * larger table would want more shards. With MySQL the insert rides the pool's write-behind
+ * queue, so concurrent registrations share one multi-row INSERT.
+ */
+
+#ifndef _USER_CACHE_H_
+#define _USER_CACHE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "user_store.h"
+
+using namespace std;
+
+/**
+ * @class USER_CACHE
+ * @brief Process-wide, sharded, read-mostly cache of the user table (singleton)
+ */
+class USER_CACHE
+{
+public:
+    /**
+     * @enum ADD_RESULT
+     * @brief Outcome of add_user_later()
+     */
+    enum ADD_RESULT
+    {
+        ADDED = 0, ///< Stored in MySQL and in the cache
+        EXISTS,    ///< Username already taken
+        DB_ERROR   ///< MySQL refused or is unreachable, nothing cached
+    };
+
+private:
+    static const int SHARDS = 16;       ///< Number of independently published maps
+    static const int MAX_READERS = 128; ///< Threads with their own reader slot
+
+    typedef unordered_map<string, string> USER_MAP; ///< username -> password
+
+    /**
+     * @struct SHARD
+     * @brief One published map and the lock serializing its writers
+     */
+    struct SHARD
+    {
+        std::atomic<const USER_MAP *> users; ///< Current snapshot, freed after synchronize()
+        unordered_set<string> reserved;      ///< Names being registered, guarded by write_lock
+        LOCKER write_lock;                   ///< Serializes copy-and-publish and reservations
+    };
+
+    /**
+     * @struct READER
+     * @brief Epoch a reader thread entered its read section in, 0 outside (own cache line)
+     */
+    struct alignas(64) READER
+    {
+        std::atomic<uint64_t> epoch;
+    };
+
+    USER_CACHE();
+    ~USER_CACHE();
+
+    SHARD m_shards[SHARDS];          ///< Users spread by hash of the name
+    READER m_readers[MAX_READERS];   ///< Reader slots, one per thread
+    std::atomic<int> m_reader_count; ///< Slots handed out so far
+    std::atomic<uint64_t> m_epoch;   ///< Advanced by every synchronize(), starts at 1
+    USER_STORE *m_store;             ///< Persistent user table
+    int m_close_log;                 ///< Logging disable flag
+
+    SHARD &shard_of(const string &name)
+    {
+        return m_shards[hash<string>()(name) % SHARDS];
+    }
+
+    /**
+     * @brief Reader slot of the calling thread, claimed on first use and kept for the life
+     *        of the thread; MAX_READERS or more once the slots ran out
+     */
+    int reader_slot();
+
+    /**
+     * @brief Run @p read on the current map of @p shard inside a read section
+     */
+    template <typename F>
+    bool read_shard(SHARD &shard, F &&read);
+
+    /**
+     * @brief Wait until every reader that entered before the call has left
+     */
+    void synchronize();
+
+    /**
+     * @brief Publish @p users as the map of @p shard (write_lock held) and free the old one
+     */
+    void replace(SHARD &shard, const USER_MAP *users);
+
+public:
+    /**
+     * @brief Get singleton instance
+     */
+    static USER_CACHE *get_instance();
+
+    /**
+     * @brief Warm the cache from the user table
+     * @param store Storage backend, must outlive the cache
+     * @param close_log Disable logging if non-zero
+     * @return Number of users loaded
+     */
+    int init(USER_STORE *store, int close_log);
+
+    /**
+     * @brief Check credentials in memory, without locking
+     * @return true if the user exists and the password matches
+     */
+    bool authenticate(const string &name, const string &password);
+
+    /**
+     * @brief Whether @p name is already registered (without locking)
+     */
+    bool contains(const string &name);
+
+    /**
+     * @brief Register a user, write-through
+     * @param name Username
+     * @param password Password
+     * @param cb Called with the outcome once the store committed or rejected the row
+     *           (on the MySQL writer thread, or before this returns for the memory store)
+     * @note The user becomes visible to authenticate() right before @p cb runs. A name that
+     *       is registered or being registered gets EXISTS at once.
+     */
+    void add_user_later(const string &name, const string &password, function<void(ADD_RESULT)> cb);
+
+    /**
+     * @brief Number of cached users
+     */
+    size_t size();
+};
+
+#endif
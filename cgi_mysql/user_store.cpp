@@ -0,0 +1,101 @@
+#define LOG_MODULE LOG_MOD_SQL
+
+#include "user_store.h"
+#include <string.h>
+
+MYSQL_USER_STORE::MYSQL_USER_STORE(DB_CONNECTION_POOL *conn_pool, int close_log) : m_connpool(conn_pool), m_close_log(close_log)
+{
+    m_select_all = m_connpool->register_stmt("SELECT username, passwd FROM user");
+}
+
+int MYSQL_USER_STORE::load(function<void(const string &, const string &)> visit)
+{
+    MYSQL *mysql = NULL;
+    CONNECTION_POOL_RAII mysqlcon(&mysql, m_connpool);
+    if (mysql == NULL)
+    {
+        LOG_ERROR("%s", "user store: no database connection");
+        return -1;
+    }
+
+    unsigned int err;
+    MYSQL_STMT *stmt = m_connpool->execute_stmt(mysql, m_select_all, NULL, &err);
+    if (stmt == NULL)
+    {
+        LOG_ERROR("user store: SELECT error %u", err);
+        return -1;
+    }
+
+    // fixed buffers fit any sane column, a longer value is fetched again at its full length
+    char buf[2][256];
+    unsigned long len[2];
+    bool is_null[2];
+    MYSQL_BIND result[2];
+    memset(result, 0, sizeof(result));
+    for (int i = 0; i < 2; i++)
+    {
+        result[i].buffer_type = MYSQL_TYPE_STRING;
+        result[i].buffer = buf[i];
+        result[i].buffer_length = sizeof(buf[i]);
+        result[i].length = &len[i];
+        result[i].is_null = &is_null[i];
+    }
+    if (mysql_stmt_bind_result(stmt, result))
+    {
+        LOG_ERROR("user store: bind error: %s", mysql_stmt_error(stmt));
+        mysql_stmt_free_result(stmt);
+        return -1;
+    }
+
+    int count = 0;
+    string value[2];
+    int ret;
+    while ((ret = mysql_stmt_fetch(stmt)) == 0 || ret == MYSQL_DATA_TRUNCATED)
+    {
+        if (is_null[0] || is_null[1])
+            continue;
+        for (int i = 0; i < 2; i++)
+        {
+            if (len[i] <= sizeof(buf[i]))
+            {
+                value[i].assign(buf[i], len[i]);
+                continue;
+            }
+            value[i].resize(len[i]);
+            MYSQL_BIND full;
+            memset(&full, 0, sizeof(full));
+            full.buffer_type = MYSQL_TYPE_STRING;
+            full.buffer = &value[i][0];
+            full.buffer_length = len[i];
+            mysql_stmt_fetch_column(stmt, &full, i, 0);
+        }
+        visit(value[0], value[1]);
+        ++count;
+    }
+    mysql_stmt_free_result(stmt);
+    return count;
+}
+
+void MYSQL_USER_STORE::insert(const string &user, const string &password, WRITE_CALLBACK cb)
+{
+    m_connpool->insert_later("user(username, passwd)", {user, password}, cb);
+}
+
+int MEMORY_USER_STORE::load(function<void(const string &, const string &)> visit)
+{
+    m_lock.lock();
+    for (const pair<const string, string> &row : m_table)
+        visit(row.first, row.second);
+    int count = m_table.size();
+    m_lock.unlock();
+    return count;
+}
+
+void MEMORY_USER_STORE::insert(const string &user, const string &password, WRITE_CALLBACK cb)
+{
+    m_lock.lock();
+    bool added = m_table.emplace(user, password).second;
+    m_lock.unlock();
+
+    cb(added ? 0 : ER_DUP_ENTRY);
+}
@@ -0,0 +1,86 @@
+/**
+ * NOTE:
+ * USER_CACHE talks to persistent storage only through USER_STORE, so the login/register flows
+ * run unchanged against either backend:
+ * - MYSQL_USER_STORE: the remote MySQL server through DB_CONNECTION_POOL (production).
+ * - MEMORY_USER_STORE: an in-process table with the same semantics (unique username,
+ *   ER_DUP_ENTRY on conflict). No network and no libmysqlclient round-trips, so load tests and
+ *   CI perf runs measure the server itself and are reproducible. Contents die with the process.
+ */
+
+#ifndef _USER_STORE_H_
+#define _USER_STORE_H_
+
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include "connection_pool.h"
+
+using namespace std;
+
+/**
+ * @class USER_STORE
+ * @brief Storage backend of the user table
+ */
+class USER_STORE
+{
+public:
+    virtual ~USER_STORE() {}
+
+    /**
+     * @brief Backend name, for logs
+     */
+    virtual const char *name() const = 0;
+
+    /**
+     * @brief Read every stored user
+     * @param visit Called once per user with (username, password)
+     * @return Number of users visited, -1 if the backend could not be read
+     */
+    virtual int load(function<void(const string &, const string &)> visit) = 0;
+
+    /**
+     * @brief Store a new user
+     * @param cb Called with 0 once stored, ER_DUP_ENTRY if the name is taken, another
+     *           MySQL error number otherwise. May run before insert() returns.
+     */
+    virtual void insert(const string &user, const string &password, WRITE_CALLBACK cb) = 0;
+};
+
+/**
+ * @class MYSQL_USER_STORE
+ * @brief User table in MySQL, read with a prepared SELECT; inserts go through the pool's
+ *        write-behind queue (prepared multi-row INSERTs)
+ */
+class MYSQL_USER_STORE : public USER_STORE
+{
+private:
+    DB_CONNECTION_POOL *m_connpool; ///< Initialized connection pool
+    int m_close_log;                ///< Logging disable flag
+    int m_select_all;               ///< Registered "SELECT username, passwd" statement
+
+public:
+    MYSQL_USER_STORE(DB_CONNECTION_POOL *conn_pool, int close_log);
+
+    const char *name() const { return "mysql"; }
+    int load(function<void(const string &, const string &)> visit);
+    void insert(const string &user, const string &password, WRITE_CALLBACK cb);
+};
+
+/**
+ * @class MEMORY_USER_STORE
+ * @brief Embedded in-process user table (thread-safe), for benchmarks and tests
+ */
+class MEMORY_USER_STORE : public USER_STORE
+{
+private:
+    unordered_map<string, string> m_table; ///< username -> password, username is the unique key
+    LOCKER m_lock;                         ///< Guards m_table
+
+public:
+    const char *name() const { return "memory"; }
+    int load(function<void(const string &, const string &)> visit);
+    void insert(const string &user, const string &password, WRITE_CALLBACK cb);
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef _WAIT_HISTOGRAM_H_
+#define _WAIT_HISTOGRAM_H_
+
+#include <atomic>
+#include <string>
+#include <stdio.h>
+
+/**
+ * @class WAIT_HISTOGRAM
+ * @brief Lock-free log2 histogram of wait times in microseconds
+ *
+ * Bucket i counts samples in [2^(i-1), 2^i) us, bucket 0 counts samples under 1us
+ * and the last bucket collects everything above ~8s.
+ */
+class WAIT_HISTOGRAM
+{
+public:
+    static const int BUCKETS = 24; ///< Number of log2 buckets
+
+private:
+    std::atomic<unsigned long long> m_buckets[BUCKETS]; ///< Sample count per bucket
+    std::atomic<unsigned long long> m_count;            ///< Total samples
+    std::atomic<unsigned long long> m_sum_us;           ///< Sum of all samples (us)
+    std::atomic<unsigned long long> m_max_us;           ///< Largest sample (us)
+
+public:
+    WAIT_HISTOGRAM() : m_count(0), m_sum_us(0), m_max_us(0)
+    {
+        for (int i = 0; i < BUCKETS; i++)
+            m_buckets[i] = 0;
+    }
+
+    /**
+     * @brief Record one sample
+     * @param us Wait time in microseconds
+     */
+    void record(unsigned long long us)
+    {
+        int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+        if (bucket >= BUCKETS)
+            bucket = BUCKETS - 1;
+
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum_us.fetch_add(us, std::memory_order_relaxed);
+
+        unsigned long long max = m_max_us.load(std::memory_order_relaxed);
+        while (us > max && !m_max_us.compare_exchange_weak(max, us, std::memory_order_relaxed))
+            ;
+    }
+
+    /**
+     * @brief Render the histogram as plain text, one "<upper bound>us count" line per non-empty bucket
+     * @param name Label printed on the summary line
+     */
+    std::string dump(const char *name) const
+    {
+        char line[128];
+        unsigned long long count = m_count.load();
+        snprintf(line, sizeof(line), "%s count=%llu avg_us=%llu max_us=%llu\n", name, count,
+                 count ? m_sum_us.load() / count : 0ULL, m_max_us.load());
+        std::string out = line;
+
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            unsigned long long n = m_buckets[i].load();
+            if (n == 0)
+                continue;
+            if (i == BUCKETS - 1)
+                snprintf(line, sizeof(line), "  >=%lluus %llu\n", 1ULL << (i - 1), n);
+            else
+                snprintf(line, sizeof(line), "  <%lluus %llu\n", 1ULL << i, n);
+            out += line;
+        }
+        return out;
+    }
+};
+
+#endif
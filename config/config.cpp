@@ -9,6 +9,17 @@ CONFIG::CONFIG()
     conn_trigger_mode = 0;   // LT mode for connections
     opt_linger = 0;          // 0 = Disable SO_LINGER (fast close)
     sql_num = 8;             // 0 = Will be set properly during init
+    sql_pin = 0;             // 0 = Workers share the whole connection pool
+    sql_min = 2;             // Pool grows from 2 up to sql_num on demand
+    sql_async = 2;           // 2 non-blocking connections for deferred handlers
+    storage = 0;             // 0 = Remote MySQL
+    log_level = 1;           // 1 = info, per-request debug lines are skipped
+    log_binary = 0;          // 0 = Human readable text log
+    access_sample = 1;       // 1 = Every request has an access record
+    access_rate = 1000;      // Bursts above 1000 req/s are counted, not logged
+    log_compress = 1;        // 1 = Rotated files are gzipped in the background
+    log_keep_files = 30;     // Oldest rotated files are deleted beyond 30
+    log_keep_mb = 1024;      // or beyond 1 GB in total
     thread_num = 8;          // 0 = Will be auto-configured later
     close_log = 0;           // 0 = Enable logging
     actor_model = 0;         // 0 = Proactor pattern
@@ -25,8 +36,8 @@ CONFIG::CONFIG()
 void CONFIG::parse_arg(int argc, char *argv[])
 {
     int opt;
-    const char *str = "p:l:m:o:s:t:c:a:";
-    while (opt = getopt(argc, argv, str) != -1)
+    const char *str = "p:l:m:o:s:t:c:a:w:n:q:d:v:b:A:R:z:k:K:";
+    while ((opt = getopt(argc, argv, str)) != -1)
     {
         switch (opt)
         {
@@ -70,6 +81,61 @@ void CONFIG::parse_arg(int argc, char *argv[])
             actor_model = atoi(optarg);
             break;
         }
+        case 'w':
+        {
+            sql_pin = atoi(optarg);
+            break;
+        }
+        case 'n':
+        {
+            sql_min = atoi(optarg);
+            break;
+        }
+        case 'q':
+        {
+            sql_async = atoi(optarg);
+            break;
+        }
+        case 'd':
+        {
+            storage = atoi(optarg);
+            break;
+        }
+        case 'v':
+        {
+            log_level = atoi(optarg);
+            break;
+        }
+        case 'b':
+        {
+            log_binary = atoi(optarg);
+            break;
+        }
+        case 'A':
+        {
+            access_sample = atoi(optarg);
+            break;
+        }
+        case 'R':
+        {
+            access_rate = atoi(optarg);
+            break;
+        }
+        case 'z':
+        {
+            log_compress = atoi(optarg);
+            break;
+        }
+        case 'k':
+        {
+            log_keep_files = atoi(optarg);
+            break;
+        }
+        case 'K':
+        {
+            log_keep_mb = atoi(optarg);
+            break;
+        }
         default:
             break;
         }
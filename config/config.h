@@ -38,6 +38,17 @@ public:
      * -t <thread_num>    Thread pool size
      * -c <0|1>           Close log (0:enable, 1:disable)
      * -a <0|1>           Actor model (0:Proactor, 1:Reactor)
+     * -w <sql_pin>       SQL connections pinned to each worker thread
+     * -n <sql_min>       Minimum SQL connections kept open (pool grows to sql_num)
+     * -q <sql_async>     Non-blocking SQL connections driven by the event loop (0:off)
+     * -d <0|1>           Storage backend (0:MySQL, 1:embedded in-memory, no network)
+     * -v <level>         Runtime log level (0:debug, 1:info, 2:warn, 3:error, 4:off)
+     * -b <0|1>           Log file format (0:text, 1:binary, read with log_decoder)
+     * -A <sample>         Access log 1 request in N per worker thread (0:off)
+     * -R <rate>           Access log records per second at most (0:unlimited)
+     * -z <0|1>           gzip rotated log files
+     * -k <files>         Rotated log files kept (0:unlimited)
+     * -K <MB>            Total size of rotated log files kept (0:unlimited)
      */
     void parse_arg(int argc, char *argv[]);
 
@@ -50,6 +61,17 @@ public:
     int conn_trigger_mode;   ///< Connection trigger mode (0:LT, 1:ET)
     int opt_linger;          ///< Linger option (0:off, 1:on)
     int sql_num;             ///< SQL connection pool size (default: 8)
+    int sql_pin;             ///< SQL connections pinned per worker (default: 0)
+    int sql_min;             ///< SQL connections kept open when idle (default: 2)
+    int sql_async;           ///< Non-blocking SQL connections on the event loop (default: 2)
+    int storage;             ///< Storage backend (0:MySQL, 1:embedded in-memory)
+    int log_level;           ///< Initial runtime log level of every module (default: 1)
+    int log_binary;          ///< Log file format (0:text, 1:binary)
+    int access_sample;       ///< Access log sampling, 1 request in N (default: 1)
+    int access_rate;         ///< Access log records per second (default: 1000)
+    int log_compress;        ///< gzip rotated log files (default: 1)
+    int log_keep_files;      ///< Rotated log files kept (default: 30)
+    int log_keep_mb;         ///< Megabytes of rotated log files kept (default: 1024)
     int thread_num;          ///< Thread pool size (default: 8)
     int close_log;           ///< Logging enable (0) or disable (1)
     int actor_model;         ///< Concurrency model (0:Proactor, 1:Reactor)
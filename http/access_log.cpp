@@ -0,0 +1,116 @@
+#define LOG_MODULE LOG_MOD_ACCESS
+
+#include "access_log.h"
+#include <arpa/inet.h>
+#include <string.h>
+
+static const char *method_names[] = {"GET", "POST", "HEAD", "PUT", "DELETE", "TRACE", "OPTIONS", "CONNECT", "PATH"};
+
+/**
+ * @brief @p s (client data) made safe between the quotes of a record: '"' and '\\' are
+ *        escaped, other non-printable bytes written as \\xhh (as Apache does), "-" if empty
+ * @param out Receives the result, cut short (never mid-escape) if it does not fit
+ */
+static const char *escape(const char *s, size_t len, char *out, size_t size)
+{
+    if (s == NULL || len == 0)
+        return "-";
+    static const char hex[] = "0123456789abcdef";
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+        {
+            if (n + 2 >= size)
+                break;
+            out[n++] = '\\';
+            out[n++] = c;
+        }
+        else if (c < 0x20 || c >= 0x7f)
+        {
+            if (n + 4 >= size)
+                break;
+            out[n++] = '\\';
+            out[n++] = 'x';
+            out[n++] = hex[c >> 4];
+            out[n++] = hex[c & 15];
+        }
+        else
+        {
+            if (n + 1 >= size)
+                break;
+            out[n++] = c;
+        }
+    }
+    out[n] = '\0';
+    return out;
+}
+
+void ACCESS_LOG::init(int close_log, int sample, int rate)
+{
+    m_close_log = close_log;
+    m_sample = sample;
+    m_rate = rate;
+}
+
+bool ACCESS_LOG::admit(time_t now)
+{
+    if (m_rate <= 0)
+        return true;
+
+    // the first record of a new second resets the budget; threads racing on the boundary may
+    // land in either second, the limit is approximate by design
+    long window = m_window.load(std::memory_order_relaxed);
+    if (window != now && m_window.compare_exchange_strong(window, now))
+    {
+        m_window_count.store(0, std::memory_order_relaxed);
+        long long over = m_suppressed.exchange(0);
+        if (over > 0)
+            LOG_WARN("access log: %lld record(s) over the %d/s limit dropped", over, m_rate);
+    }
+    if (m_window_count.fetch_add(1, std::memory_order_relaxed) < m_rate)
+        return true;
+    ++m_suppressed;
+    return false;
+}
+
+void ACCESS_LOG::record(const HttpRequest &req, const HttpResponse &res)
+{
+    if (m_sample <= 0 || !LOG_ENABLED(LOG_LEVEL_INFO))
+        return;
+
+    // per-thread counter: sampling never touches shared memory
+    thread_local unsigned t_seen = 0;
+    if (++t_seen % m_sample != 0)
+        return;
+
+    time_t now = time(NULL);
+    if (!admit(now))
+        return;
+
+    // CLF date, only rebuilt once a second per thread
+    thread_local time_t t_sec = 0;
+    thread_local char t_date[32];
+    if (now != t_sec)
+    {
+        struct tm my_tm;
+        localtime_r(&now, &my_tm);
+        strftime(t_date, sizeof(t_date), "%d/%b/%Y:%H:%M:%S %z", &my_tm);
+        t_sec = now;
+    }
+
+    char ip[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &req.m_address.sin_addr, ip, sizeof(ip)) == NULL)
+        strcpy(ip, "-");
+
+    // the target as the client sent it, not the routed path; every quoted field is escaped
+    // so that a record always parses
+    char target[1024], referer[512], agent[512];
+    LOG_INFO("%s - - [%s] \"%s %s HTTP/1.1\" %d %ld \"%s\" \"%s\" %lldus",
+             ip, t_date, method_names[req.m_method], escape(req.m_target.data(), req.m_target.size(), target, sizeof(target)),
+             res.m_status, res.m_body_bytes,
+             escape(req.m_referer, req.m_referer ? strlen(req.m_referer) : 0, referer, sizeof(referer)),
+             escape(req.m_user_agent, req.m_user_agent ? strlen(req.m_user_agent) : 0, agent, sizeof(agent)),
+             now_us() - req.m_start_us);
+}
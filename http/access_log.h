@@ -0,0 +1,80 @@
+/**
+ * NOTE:
+ * One access record per completed request, in Combined Log Format plus the latency:
+ *
+ *   127.0.0.1 - - [18/Oct/2026:11:27:22 +0000] "GET /index.html HTTP/1.1" 200 1043 "-" "curl/8.5.0" 312us
+ *
+ * The record is handed to LOG (module "access", INFO level) once the last byte was written,
+ * so in async mode it costs a ring push and in binary mode no formatting at all. Volume is
+ * bounded twice, both without locks:
+ * - sampling: only every Nth request of each worker thread is recorded
+ * - rate limit: at most R records per second process-wide, the overflow is counted and
+ *   reported once per second as a WARN line
+ * Turn it off at runtime with POST /log_level {"module":"access","level":"off"}.
+ */
+
+#ifndef _ACCESS_LOG_H_
+#define _ACCESS_LOG_H_
+
+#include <time.h>
+#include <atomic>
+
+#include "http_types.h"
+
+/**
+ * @class ACCESS_LOG
+ * @brief Sampled, rate limited per-request access log
+ */
+class ACCESS_LOG
+{
+private:
+    int m_sample;     ///< Record 1 request out of m_sample (0: access log disabled)
+    int m_rate;       ///< Max records per second (0: unlimited)
+    int m_close_log;  ///< Logging disable flag
+
+    std::atomic<long> m_window;           ///< Second the rate counter belongs to
+    std::atomic<int> m_window_count;      ///< Records in that second
+    std::atomic<long long> m_suppressed;  ///< Records over the rate limit, not yet reported
+
+    ACCESS_LOG() : m_sample(0), m_rate(0), m_close_log(1), m_window(0), m_window_count(0), m_suppressed(0) {}
+
+    /**
+     * @brief Take a slot in the current second's budget
+     * @return false if the rate limit is reached
+     */
+    bool admit(time_t now);
+
+public:
+    static ACCESS_LOG *get_instance()
+    {
+        static ACCESS_LOG instance;
+        return &instance;
+    }
+
+    /**
+     * @brief Configure the access log
+     * @param close_log Logging disable flag
+     * @param sample Record every Nth request (1: all, 0: none)
+     * @param rate Max records per second (0: unlimited)
+     */
+    void init(int close_log, int sample, int rate);
+
+    /**
+     * @brief Monotonic clock in microseconds, for request latency
+     */
+    static long long now_us()
+    {
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (long long)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+    }
+
+    /**
+     * @brief Record a completed request (called by the thread that wrote its last byte)
+     * @param req Parsed request, m_start_us set when its first byte was read
+     * @param res Response, m_status and m_body_bytes set by send()/render()
+     */
+    void record(const HttpRequest &req, const HttpResponse &res);
+};
+
+#endif
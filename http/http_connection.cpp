@@ -38,11 +38,14 @@
     ssize_t bytes_written = writev(fd, iov, 2);
  */
 
+#define LOG_MODULE LOG_MOD_HTTP
+
 #include "http_coonection.h"
 
 #include <mysql/mysql.h>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 
 int set_non_blocking(int fd)
 {
@@ -95,7 +98,7 @@ void HTTP_CONN::close_conn(bool real_close)
 {
     if (real_close && (req.m_sockfd != -1)) // if sockfd is -1 than it that socket is already closed.
     {
-        printf("close %d\n", req.m_sockfd);
+        res.cancel(); // a late callback must not touch the response or arm the fd
         removefd(m_epollfd, req.m_sockfd);
         req.m_sockfd = -1;
         m_user_count--;
@@ -112,6 +115,8 @@ void HTTP_CONN::init(int sockfd, const sockaddr_in &addr, int trigger_mode, int
 
     if (router.isStatic())
         res.doc_root = router.root_path();
+    res.m_rearm = [this]()
+    { modfd(m_epollfd, req.m_sockfd, EPOLLOUT, m_trigger_mode); };
     m_trigger_mode = trigger_mode;
     m_close_log = close_log;
 
@@ -128,18 +133,38 @@ void HTTP_CONN::init()
     mysql = NULL;
     res.bytes_to_send = 0;
     res.bytes_have_send = 0;
+    res.m_defer = 0;
     m_check_state = CHECK_STATE_REQUESTLINE;
     req.m_linger = false;
     res.m_linger = false;
     req.m_method = GET;
     req.m_url = 0;
+    req.m_target.clear();
     req.m_version = 0;
     req.m_content_length = 0;
     req.m_host = 0;
+    req.m_referer = 0;
+    req.m_user_agent = 0;
+    req.m_content_type = 0;
+    res.m_status = 0;
+    res.m_body_bytes = 0;
     req.m_start_line = 0;
+    req.m_body.clear();
+    req.m_query.clear();
+    req.m_form.clear();
+    req.m_sink.reset();
+    req.m_param_names = NULL;
+    req.m_param_count = 0;
+    req.m_route = NULL;
+    req.m_routed = false;
+    req.m_body_read = 0;
     req.m_checked_idx = 0;
     req.m_read_idx = 0;
     res.m_write_idx = 0;
+    res.m_content = NULL;
+    res.m_content_buf.clear();
+    if (res.m_content_buf.capacity() > 65536) // a large response does not pin its buffer
+        std::string().swap(res.m_content_buf);
     cgi = 0;
     m_state = 0;
     timer_flag = 0;
@@ -154,6 +179,8 @@ bool HTTP_CONN::read_once()
 {
     if (req.m_read_idx >= READ_BUFFER_SIZE)
         return false;
+    if (req.m_read_idx == 0)
+        req.m_start_us = ACCESS_LOG::now_us(); // latency covers reading, handling and writing
 
     int byte_read = 0;
 
@@ -193,6 +220,8 @@ bool HTTP_CONN::read_once()
                 return false;
 
             req.m_read_idx += byte_read;
+            if (req.m_read_idx >= READ_BUFFER_SIZE)
+                break; // full: a streamed body makes room in process(), the socket is re-armed then
         }
         return true; // Successfully read all available data
     }
@@ -263,6 +292,7 @@ HTTP_CONN::HTTP_CODE HTTP_CONN::parse_request_line(char *text) // helps in parsi
         return BAD_REQUEST;
     *req.m_version++ = '\0';
     // m_url: "/index.html\0HTTP/1.1\r\n"
+    req.m_target.assign(req.m_url); // before the rewrites below and in-place query decoding
 
     req.m_version += strspn(req.m_version, " \t");
     // m_version = "HTTP/1.1\r\n"
@@ -283,8 +313,18 @@ HTTP_CONN::HTTP_CODE HTTP_CONN::parse_request_line(char *text) // helps in parsi
     // check if m_url has / or not
     if (!req.m_url || req.m_url[0] != '/')
         return BAD_REQUEST;
+    // routes are looked up by path: the query string is split off, parsed if a handler asks
+    char *query = strchr(req.m_url, '?');
+    if (query)
+    {
+        *query++ = '\0';
+        req.m_query.assign(query, strlen(query));
+    }
     if (strlen(req.m_url) == 1)
-        strcat(req.m_url, "judge.html");
+    {
+        static char home[] = "/judge.html"; // not appended in place: a query string follows "/"
+        req.m_url = home;
+    }
     m_check_state = CHECK_STATE_HEADER;
 
     return NO_REQUEST;
@@ -297,11 +337,15 @@ HTTP_CONN::HTTP_CODE HTTP_CONN::parse_headers(char *text)
 {
     if (text[0] == '\0') // we have reached end of header as we encounterd space line
     {
+        // a streaming route gets its body through a sink, see parse_content()
+        req.m_sink.reset(router.open_sink(req));
         if (req.m_content_length != 0) // when we have some content
         {
             m_check_state = CHECK_STATE_CONTENT;
             return NO_REQUEST; // continue parsing
         }
+        if (req.m_sink)
+            req.m_sink->finish();
         return GET_REQUEST; // dirsctly make request
     }
     else if (strncasecmp(text, "Connection:", 11) == 0)
@@ -320,15 +364,29 @@ HTTP_CONN::HTTP_CODE HTTP_CONN::parse_headers(char *text)
         text += strspn(text, " \t"); // skip leading zero
         req.m_content_length = atoi(text);
     }
+    else if (strncasecmp(text, "Content-Type:", 13) == 0)
+    {
+        text += 13;
+        text += strspn(text, " \t");
+        req.m_content_type = text;
+    }
     else if (strncasecmp(text, "Host:", 5) == 0)
     {
         text += 5;
         text += strspn(text, " \t");
         req.m_host = text;
     }
-    else
+    else if (strncasecmp(text, "Referer:", 8) == 0)
     {
-        LOG_INFO("Oops!! Unknown header: %s.", text);
+        text += 8;
+        text += strspn(text, " \t");
+        req.m_referer = text;
+    }
+    else if (strncasecmp(text, "User-Agent:", 11) == 0)
+    {
+        text += 11;
+        text += strspn(text, " \t");
+        req.m_user_agent = text;
     }
 
     return NO_REQUEST; // continue parsing
@@ -336,11 +394,45 @@ HTTP_CONN::HTTP_CODE HTTP_CONN::parse_headers(char *text)
 
 HTTP_CONN::HTTP_CODE HTTP_CONN::parse_content(char *text)
 {
+    if (req.m_sink)
+    {
+        // streamed: whatever arrived goes to the sink and the buffer is reused for the rest,
+        // so the body may be larger than READ_BUFFER_SIZE
+        long n = std::min(req.m_read_idx - req.m_checked_idx, req.m_content_length - req.m_body_read);
+        if (n > 0)
+        {
+            req.m_sink->write(text, n);
+            req.m_body_read += n;
+        }
+        req.m_read_idx = req.m_checked_idx;
+        if (req.m_body_read < req.m_content_length)
+            return NO_REQUEST;
+        req.m_sink->finish();
+        return GET_REQUEST;
+    }
+
     // check if from m_check_idx + m_content_length we can react end of buffer
     if (req.m_read_idx >= (req.m_content_length + req.m_checked_idx))
     {
-        std::string content(text, req.m_content_length);
-        req.m_body = JSON::parse(content);
+        // by Content-Type: a form is only located, its params are split and decoded in
+        // place if the handler reads them
+        if (req.is_form())
+        {
+            req.m_form.assign(text, req.m_content_length);
+            return GET_REQUEST;
+        }
+        // anything else is taken as JSON, only validated here: values are read from
+        // m_read_buf when the handler asks for them, and init() resets the buffer together
+        // with m_body, so the document never outlives the bytes it points to
+        try
+        {
+            req.m_body.parse(text, req.m_content_length);
+        }
+        catch (const std::exception &e)
+        {
+            // not JSON (or malformed): handlers see a null body and answer 400
+            LOG_DEBUG("request body: %s", e.what());
+        }
         return GET_REQUEST;
     }
     return NO_REQUEST;
@@ -420,8 +512,8 @@ bool HTTP_CONN::write()
         if (res.bytes_have_send >= res.m_iv[0].iov_len) // if response header have been sent
         {
             res.m_iv[0].iov_len = 0; // make first buffer zero
-            // give the 2nd buufer of file stored in memory map
-            res.m_iv[1].iov_base = res.m_file_address + (res.bytes_have_send - res.m_write_idx);
+            // give the 2nd buufer of the body (memory mapped file or generated content)
+            res.m_iv[1].iov_base = (char *)res.m_content + (res.bytes_have_send - res.m_write_idx);
             res.m_iv[1].iov_len = res.bytes_to_send;
         }
         else
@@ -431,6 +523,7 @@ bool HTTP_CONN::write()
         }
         if (res.bytes_to_send <= 0) // we have sent everything to client
         {
+            ACCESS_LOG::get_instance()->record(req, res);
             res.unmap();
             modfd(m_epollfd, req.m_sockfd, EPOLLIN, m_trigger_mode);
             if (req.m_linger) // if connection is keep alive
@@ -454,8 +547,15 @@ void HTTP_CONN::process()
         return;
     }
 
+    // NULL when the DB pool timed out or its breaker is open, DB routes answer 503
+    req.m_mysql = mysql;
     router.handleRequest(req, res);
 
+    // a deferred answer is armed by resume() unless its callback already ran: exactly one
+    // of the two arms the socket
+    if (!res.finish_handler())
+        return;
+
     // if everything is ready tell the evernt loop to write to the socket through epoll
     modfd(m_epollfd, req.m_sockfd, EPOLLOUT, m_trigger_mode);
 }
\ No newline at end of file
@@ -28,6 +28,7 @@
 #include "../log/log.h"
 #include "http_types.h"
 #include "http_routes.h"
+#include "access_log.h"
 
 /**
  * @class HTTP_CONN
@@ -114,6 +115,15 @@ public:
      */
     void close_conn(bool real_close = true);
 
+    /**
+     * @brief Drop a deferred response before the socket is closed by someone else (the
+     *        timer), see HttpResponse::cancel()
+     */
+    void cancel_deferred()
+    {
+        res.cancel();
+    }
+
     /**
      * @brief Main processing method
      */
@@ -140,12 +150,6 @@ public:
         return &req.m_address;
     }
 
-    /**
-     * @brief Initialize MySQL result set
-     * @param conn_pool Database connection pool
-     */
-    void initmysql_result(DB_CONNECTION_POOL *conn_pool);
-
     int timer_flag; ///< Timer expiration flag
     int improv;     ///< Improv flag for connection state
 
@@ -155,8 +159,7 @@ private:
     int cgi;                   ///< CGI flag
 
     /* Configuration */
-    map<string, string> m_users; ///< User credentials cache
-    int m_trigger_mode;          ///< Event trigger mode
+    int m_trigger_mode; ///< Event trigger mode
 
     /* Database credentials */
     char sql_user[100];     ///< Database username
@@ -4,26 +4,108 @@
 #include <unordered_map>
 #include <functional>
 #include <string>
+#include <vector>
+#include <deque>
 #include <iostream>
+#include <atomic>
+#include <stdexcept>
 
 #include "../lock/locker.h"
 #include "../log/log.h"
 #include "http_types.h"
+#include "route_tree.h"
 
 // Alias for handler function type
 using RouteHandler = function<void(const HttpRequest &, HttpResponse &)>;
+// Makes the BODY_SINK a streaming route feeds its body to (the connection owns it)
+using SinkFactory = function<BODY_SINK *(const HttpRequest &)>;
 
+/**
+ * @struct ROUTE
+ * @brief What is registered for one method and pattern
+ */
+struct ROUTE
+{
+    RouteHandler handler;            ///< Empty if only stream() was called for the pattern
+    SinkFactory sink;                ///< Body sink factory, empty if the body is buffered
+    std::vector<std::string> params; ///< Names of the pattern's parameters, in order
+};
+
+/*
+ * Routes are patterns (see route_tree.h): "/users/:id" puts the segment in
+ * req.param("id"), "*path" ending a pattern (after "/files/", say) the rest of the URL in
+ * req.param("path"). Each method has its own radix tree, so a lookup walks the path once
+ * and allocates nothing; a request matching no route is served from the document root (GET
+ * only) or gets a 404.
+ * Routes are registered before the server starts, then freeze() makes the trees read-only:
+ * lookups take no lock from there on (the worker threads start after it), handlers are
+ * called without copying them and a ROUTE never moves. A request is matched once, when its
+ * headers are read (open_sink()); handleRequest() reuses that route.
+ */
 class ROUTER
 {
 private:
     // Private constructor for singleton
     ROUTER() = default;
-    // Map to store routes: key = "METHOD:URL", value = handler function
-    unordered_map<string, RouteHandler> routes;
-    LOCKER routes_locker; ///< Mutex for thread safety
+    ROUTE_TREE trees[PATH + 1];                        ///< Pattern -> index in route_list, per method
+    std::deque<ROUTE> route_list;                      ///< Every route (a deque: added routes stay in place)
+    unordered_map<string, int> patterns[PATH + 1];     ///< Pattern -> index, to update a route at registration
+    LOCKER routes_locker;              ///< Guards registration, and lookups until freeze()
+    std::atomic<bool> frozen{false};   ///< No route may be added: lookups are lock-free
     std::string doc_root;
     bool static_files = false;
 
+    /**
+     * @brief The route of @p method and @p path, created if needed (routes_locker held)
+     * @param params Parameter names of @p path, from ROUTE_TREE::parse (which validated it)
+     */
+    ROUTE &route_for(METHOD method, const string &path, std::vector<std::string> &&params)
+    {
+        if (frozen.load(std::memory_order_relaxed))
+            throw std::logic_error("route added after ROUTER::freeze(): " + path);
+        auto it = patterns[method].find(path);
+        if (it != patterns[method].end())
+            return route_list[it->second];
+        ROUTE route;
+        route.params = std::move(params);
+        int index = (int)route_list.size();
+        trees[method].insert(path, index);
+        patterns[method][path] = index;
+        route_list.push_back(route);
+        return route_list.back();
+    }
+
+    /**
+     * @brief Route of @p req, looked up once: it and its parameters are stored in the request
+     * @return NULL if none matches
+     */
+    const ROUTE *match(HttpRequest &req)
+    {
+        if (req.m_routed)
+            return req.m_route;
+        req.m_routed = true;
+        req.m_route = NULL;
+        req.m_param_count = 0;
+        req.m_param_names = NULL;
+        if (req.m_url == NULL || req.m_method < GET || req.m_method > PATH)
+            return NULL;
+        int count;
+        bool locked = !frozen.load(std::memory_order_acquire);
+        if (locked)
+            routes_locker.lock();
+        int index = trees[req.m_method].find(req.m_url, req.m_params, count);
+        const ROUTE *route = index >= 0 ? &route_list[index] : NULL;
+        if (locked)
+            routes_locker.unlock();
+        if (route)
+        {
+            req.m_param_count = count;
+            req.m_param_names = &route->params;
+        }
+        req.m_route = route;
+        return route;
+    }
+
 public:
     // Delete copy constructor and assignment operator
     ROUTER(const ROUTER &) = delete;
@@ -56,39 +138,65 @@ public:
         return doc_root.data();
     }
 
-    // Add route to the map
+    /**
+     * @brief No more routes: lookups stop taking routes_locker. Call it once every route is
+     *        registered, before the threads that serve requests start
+     */
+    void freeze()
+    {
+        routes_locker.lock();
+        frozen.store(true, std::memory_order_release);
+        routes_locker.unlock();
+    }
+
+    /**
+     * @brief Add a route
+     * @throws std::invalid_argument if @p path is not a valid pattern, std::logic_error
+     *         after freeze()
+     */
     void add_route(const METHOD &method, const string &path, RouteHandler handler)
     {
-        string key = find_method_str(method) + ":" + path;
+        std::vector<std::string> params = ROUTE_TREE::parse(path);
         routes_locker.lock();
-        routes[key] = handler;
+        route_for(method, path, std::move(params)).handler = handler;
         routes_locker.unlock();
     }
-    // Handle incoming request
-    void handleRequest(const HttpRequest &req, HttpResponse &res)
+    /**
+     * @brief Stream the body of a route to a sink from @p factory instead of buffering it:
+     *        it is called once the headers are read, the body is then written to the sink
+     *        as it arrives and the handler (registered as usual) finds it in req.sink<T>()
+     * @throws std::invalid_argument if @p path is not a valid pattern, std::logic_error
+     *         after freeze()
+     */
+    void stream(const METHOD &method, const string &path, SinkFactory factory)
     {
-        string key = find_method_str(req.m_method) + ":" + req.m_url;
+        std::vector<std::string> params = ROUTE_TREE::parse(path);
         routes_locker.lock();
-        auto it = routes.find(key);
-        if (it != routes.end())
-        {
-            // Found matching route, execute handler
-            // Unlock before calling the handler to avoid holding the lock during user code
-            RouteHandler handler = it->second;
-            routes_locker.unlock();
-            handler(req, res);
-            return;
-        }
-        else if (res.render(202, req.m_url))
-        {
-            routes_locker.unlock();
+        route_for(method, path, std::move(params)).sink = factory;
+        routes_locker.unlock();
+    }
+
+    /**
+     * @brief Sink for the body of @p req, once its headers are read (its route and route
+     *        parameters are set first)
+     * @return NULL if its route buffers the body
+     */
+    BODY_SINK *open_sink(HttpRequest &req)
+    {
+        const ROUTE *route = match(req);
+        return route && route->sink ? route->sink(req) : NULL;
+    }
+
+    // Handle incoming request, with the route open_sink() found
+    void handleRequest(HttpRequest &req, HttpResponse &res)
+    {
+        const ROUTE *route = match(req);
+        if (route && route->handler)
+            route->handler(req, res);
+        else if (static_files && req.m_method == GET && res.render(202, req.m_url))
             return;
-        }
         else
-        {
-            routes_locker.unlock();
             res.send(404, "404 not found");
-        }
     }
     // Convenience methods for common HTTP methods
     void get(const string &path, RouteHandler handler)
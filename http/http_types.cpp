@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MOD_HTTP
+
 #include "http_types.h"
 #include <cstdarg>
 #include <cstdio>
@@ -22,8 +24,6 @@ bool HttpResponse::add_response(const char *format, ...)
     }
     m_write_idx += len;
     va_end(arg_list);
-
-    LOG_INFO("request: %s", m_write_buf);
     return true;
 }
 
@@ -73,44 +73,61 @@ void HttpResponse::unmap()
     }
 }
 
-bool HttpResponse::send(int status, const std::string &content)
+bool HttpResponse::send_content(int status, const char *content_type)
 {
-    const char *content_type = "text/plain";
-
     // Reset write buffer and response state
     m_write_idx = 0;
     bytes_to_send = 0;
     bytes_have_send = 0;
     m_iv_count = 0;
 
-    // Build the response
-    if (!add_status_line(status, get_status_message(status)))
-        return false;
-
-    if (!add_content_type(content_type))
+    // Build the headers, the body stays where it was written
+    if (!add_status_line(status, get_status_message(status)) ||
+        !add_content_type(content_type) ||
+        !add_content_length(m_content_buf.size()) ||
+        !add_linger() ||
+        !add_blank_line())
         return false;
 
-    if (!add_content_length(content.length()))
-        return false;
+    // Set up the I/O vectors for writev
+    m_content = m_content_buf.data();
+    m_iv[0].iov_base = m_write_buf;
+    m_iv[0].iov_len = m_write_idx;
+    m_iv[1].iov_base = (void *)m_content;
+    m_iv[1].iov_len = m_content_buf.size();
+    m_iv_count = 2;
+    bytes_to_send = m_write_idx + m_content_buf.size();
+    m_status = status;
+    m_body_bytes = m_content_buf.size();
 
-    if (!add_linger())
-        return false;
+    return true;
+}
 
-    if (!add_blank_line())
-        return false;
+bool HttpResponse::send(int status, const std::string &content)
+{
+    m_content_buf.assign(content);
+    return send_content(status, "text/plain");
+}
 
-    if (!add_content(content.c_str()))
-        return false;
+bool HttpResponse::json(int status, const JSONNode &value)
+{
+    m_content_buf.clear();
+    JSON_WRITER(m_content_buf).value(value);
+    return send_content(status, "application/json");
+}
 
-    // Set up the I/O vector for writev
-    m_iv[0].iov_base = m_write_buf;
-    m_iv[0].iov_len = m_write_idx;
-    m_iv_count = 1;
-    bytes_to_send = m_write_idx;
-    // Log the response
-    LOG_INFO("Response: %.*s", m_write_idx, m_write_buf);
+bool HttpResponse::json(int status, const JSON_VALUE &value)
+{
+    m_content_buf.clear();
+    JSON_WRITER(m_content_buf).value(value);
+    return send_content(status, "application/json");
+}
 
-    return true;
+bool HttpResponse::json(int status, const JSON_LAZY_VALUE &value)
+{
+    m_content_buf.clear();
+    JSON_WRITER(m_content_buf).value(value);
+    return send_content(status, "application/json");
 }
 
 bool HttpResponse::mapfile(const char *file_name)
@@ -221,12 +238,13 @@ bool HttpResponse::render(int status, const std::string &file_name)
     // Set up I/O vectors
     m_iv[0].iov_base = m_write_buf;
     m_iv[0].iov_len = m_write_idx;
+    m_content = m_file_address;
     m_iv[1].iov_base = m_file_address;
     m_iv[1].iov_len = m_file_stat.st_size;
     m_iv_count = 2;
     bytes_to_send = m_write_idx + m_file_stat.st_size;
+    m_status = status;
+    m_body_bytes = m_file_stat.st_size;
 
-    cout<<"files send "<<file_name<<endl;
- 
     return true;
 }
\ No newline at end of file
@@ -3,14 +3,25 @@
 
 #include <string>
 #include <functional>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <type_traits>
+#include <sched.h>
+#include <stdint.h>
+#include <strings.h>
 #include <sys/stat.h>
 #include <netinet/in.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <mysql/mysql.h>
 
 #include "./jsonparser.h"
+#include "./json_lazy.h"
+#include "./json_writer.h"
+#include "./url_params.h"
+#include "./route_tree.h"
 #include "../log/log.h"
 
 static const int FILENAME_LEN = 200;       ///< Maximum length for file paths
@@ -19,6 +30,8 @@ static const int WRITE_BUFFER_SIZE = 1024; ///< Size of write buffer
 
 static int m_close_log;
 
+struct ROUTE; // http_routes.h
+
 /**
  * @enum METHOD
  * @brief Supported HTTP methods
@@ -36,6 +49,28 @@ enum METHOD
     PATH     ///< PATH method
 };
 
+/**
+ * @class BODY_SINK
+ * @brief Takes a request body chunk by chunk while it arrives, for routes registered with
+ *        ROUTER::stream(): the body never has to fit in the read buffer
+ */
+class BODY_SINK
+{
+public:
+    virtual ~BODY_SINK() {}
+
+    /**
+     * @brief The next @p len body bytes, only valid during the call
+     */
+    virtual void write(const char *data, size_t len) = 0;
+
+    /**
+     * @brief The whole body was written (also called for an empty body), the handler runs
+     *        next and asks the sink what it got
+     */
+    virtual void finish() = 0;
+};
+
 // Simple request and response classes.
 class HttpRequest
 {
@@ -47,14 +82,61 @@ public:
     long m_read_idx;                   ///< Read buffer index
     long m_checked_idx;                ///< Checked position in buffer
     int m_start_line;                  ///< Start line position
-    char *m_url;                       ///< Request URL
+    char *m_url;                       ///< Request path, the query string split off
+    std::string m_target;              ///< Request target as sent (path and query), for the access log
     char *m_version;                   ///< HTTP version
     char *m_host;                      ///< Host header
+    char *m_referer;                   ///< Referer header, for the access log
+    char *m_user_agent;                ///< User-Agent header, for the access log
+    char *m_content_type;              ///< Content-Type header, picks how the body is parsed
+    long long m_start_us;              ///< When the first byte arrived (ACCESS_LOG::now_us())
     long m_content_length;             ///< Content length
     bool m_linger;                     ///< Keep-alive flag
     int m_sockfd;                      ///< Client socket descriptor
+    MYSQL *m_mysql;                    ///< Pooled DB connection (NULL when the pool is unavailable)
+
+    JSON_LAZY m_body; ///< JSON body, validated and read on demand (null if absent or invalid), cleared by HTTP_CONN::init()
+    URL_PARAMS m_query; ///< Params of the query string (after '?' in the URL), decoded when first read
+    URL_PARAMS m_form;  ///< Params of an application/x-www-form-urlencoded body (m_body then stays null)
+
+    std::unique_ptr<BODY_SINK> m_sink; ///< Body consumer of a streaming route (m_body then stays null)
+
+    std::string_view m_params[ROUTE_MAX_PARAMS];   ///< Values of the route's :params and *wildcard, views into m_url
+    const std::vector<std::string> *m_param_names; ///< Their names (the route's), NULL if no route matched
+    int m_param_count;                             ///< Parameters set
+    const ROUTE *m_route;                          ///< Route found by ROUTER::open_sink(), NULL if none matched
+    bool m_routed;                                 ///< m_route was looked up, handleRequest() reuses it
+    long m_body_read;                  ///< Body bytes given to m_sink so far
+
+    /**
+     * @brief The sink of a streaming route, as the type its ROUTER::stream() factory made
+     * @return NULL if the route does not stream or @p T is not that type
+     */
+    template <typename T>
+    T *sink() const
+    {
+        return dynamic_cast<T *>(m_sink.get());
+    }
+
+    /**
+     * @brief Value of route parameter @p name ("/users/:id" -> param("id"))
+     * @return Empty if the route has no such parameter
+     */
+    std::string_view param(std::string_view name) const
+    {
+        for (int i = 0; i < m_param_count; i++)
+            if ((*m_param_names)[i] == name)
+                return m_params[i];
+        return std::string_view();
+    }
 
-    JSON m_body;
+    /**
+     * @brief The body is application/x-www-form-urlencoded: it goes to m_form, not m_body
+     */
+    bool is_form() const
+    {
+        return m_content_type && strncasecmp(m_content_type, "application/x-www-form-urlencoded", 33) == 0;
+    }
 
     // Add more request properties as needed...
 
@@ -78,6 +160,10 @@ public:
     int m_iv_count;          ///< I/O vector count
     char *doc_root;          ///< Document root directory
 
+    /* Body */
+    std::string m_content_buf; ///< Body written by send()/json(), kept across requests
+    const char *m_content;     ///< Body sent after the headers: m_content_buf or the mapped file
+
     /* CGI and database */
     char *m_string;      ///< String storage
     int bytes_to_send;   ///< Bytes remaining to send
@@ -85,6 +171,14 @@ public:
 
     bool m_linger;
 
+    /* Access log */
+    int m_status;      ///< Status code of the response being sent
+    long m_body_bytes; ///< Body size of that response (headers excluded, as in CLF)
+
+    /* Deferred (async) responses */
+    std::atomic<uint64_t> m_defer; ///< Ticket of the current deferral << 3 | DEFER_* bits, 0 if none
+    std::function<void()> m_rearm; ///< Re-arms EPOLLOUT for this connection, set by HTTP_CONN
+
     int m_close_log; ///< Logging control flag
 
     sockaddr_in m_address; ///< Client address
@@ -99,18 +193,33 @@ private:
         {
         case 200:
             return "OK";
+        case 201:
+            return "Created";
         case 400:
             return "Bad Request";
+        case 401:
+            return "Unauthorized";
+        case 403:
+            return "Forbidden";
         case 404:
             return "Not Found";
+        case 409:
+            return "Conflict";
         case 500:
             return "Internal Server Error";
+        case 503:
+            return "Service Unavailable";
         default:
             return "Unknown Status";
         }
     }
     bool mapfile(const char *file_name);
 
+    /**
+     * @brief Headers for the body in m_content_buf, then queue both for writev
+     */
+    bool send_content(int status, const char *content_type);
+
 public:
     /**
      * @brief Send plain text response to the client
@@ -123,6 +232,135 @@ public:
 
     bool render(int status, const std::string &file_name);
 
+    /**
+     * @brief Send @p value as an application/json response, serialized straight into the
+     *        body buffer
+     */
+    bool json(int status, const JSONNode &value);
+    bool json(int status, const JSON_VALUE &value);
+    bool json(int status, const JSON_LAZY_VALUE &value);
+
+    /**
+     * @brief Send the JSON that @p write produces, without building a tree first:
+     *        res.json(200, [&](JSON_WRITER &w) { w.start_object().key("n").integer(n).end_object(); });
+     */
+    template <typename F>
+    std::enable_if_t<std::is_invocable_v<F, JSON_WRITER &>, bool> json(int status, F &&write)
+    {
+        m_content_buf.clear();
+        JSON_WRITER writer(m_content_buf);
+        write(writer);
+        return send_content(status, "application/json");
+    }
+
+    /*
+     * A deferred response is armed (EPOLLOUT) exactly once, by whichever of the handler's
+     * return (finish_handler()) and the callback's resume() comes second. Both move m_defer
+     * with a CAS, so each sees whether the other already passed:
+     *
+     *   defer():          ticket | RUNNING
+     *   claim():          | CLAIMED, the callback owns the response until resume()
+     *   resume():         RUNNING -> READY (the handler arms) or WAITING -> 0 (arms here)
+     *   finish_handler(): RUNNING -> WAITING (the callback arms) or READY -> 0 (arms)
+     *   cancel():         -> 0 when the connection closes, later claims fail
+     */
+    static const uint64_t DEFER_RUNNING = 0; ///< The handler has not returned, no answer yet
+    static const uint64_t DEFER_WAITING = 1; ///< The handler returned, the callback arms the socket
+    static const uint64_t DEFER_READY = 2;   ///< The answer is ready, the handler arms when it returns
+    static const uint64_t DEFER_PHASE = 3;   ///< Mask of the three above
+    static const uint64_t DEFER_CLAIMED = 4; ///< A callback is writing the answer
+
+    /**
+     * @brief Tell the connection not to send anything when the handler returns
+     * @return Ticket to claim() before touching the response later
+     * @note Call before starting the async work, the callback may run before the handler returns
+     */
+    uint64_t defer()
+    {
+        // tickets are unique process-wide so a reused connection slot never matches a stale one
+        static std::atomic<uint64_t> next_ticket(0);
+        uint64_t ticket = ++next_ticket;
+        m_defer = ticket << 3 | DEFER_RUNNING;
+        return ticket;
+    }
+
+    /**
+     * @brief Take the response of deferral @p ticket, to fill it then resume() (any thread)
+     * @return false if the connection was closed or reused since, or the ticket was
+     *         already claimed: the response must not be touched
+     */
+    bool claim(uint64_t ticket)
+    {
+        uint64_t cur = m_defer.load();
+        while (true)
+        {
+            if (cur >> 3 != ticket || (cur & DEFER_CLAIMED) || (cur & DEFER_PHASE) == DEFER_READY)
+                return false;
+            if (m_defer.compare_exchange_weak(cur, cur | DEFER_CLAIMED))
+                return true;
+        }
+    }
+
+    /**
+     * @brief Send the response filled after claim() (any thread)
+     */
+    void resume()
+    {
+        uint64_t cur = m_defer.load();
+        while (cur & DEFER_CLAIMED)
+        {
+            if ((cur & DEFER_PHASE) == DEFER_RUNNING)
+            {
+                // the handler is still running, it arms the socket when it returns
+                if (m_defer.compare_exchange_weak(cur, (cur >> 3) << 3 | DEFER_READY))
+                    return;
+                continue;
+            }
+            // the handler returned: arm before letting go of the claim, so that a close
+            // (cancel() waits for claims) cannot slip in between and reuse the fd
+            if (m_rearm)
+                m_rearm();
+            m_defer.compare_exchange_strong(cur, 0); // fails if the connection already moved on
+            return;
+        }
+    }
+
+    /**
+     * @brief Called by the connection once the handler returned
+     * @return true if the connection arms the socket now: the response was not deferred,
+     *         or its callback already resumed
+     */
+    bool finish_handler()
+    {
+        uint64_t cur = m_defer.load();
+        while (cur != 0)
+        {
+            uint64_t next = (cur & DEFER_PHASE) == DEFER_READY ? 0 : (cur & ~DEFER_PHASE) | DEFER_WAITING;
+            if (m_defer.compare_exchange_weak(cur, next))
+                return next == 0;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Drop the current deferral when the connection closes: a callback that claimed
+     *        the response is waited for (it does not block), any later claim() fails
+     */
+    void cancel()
+    {
+        uint64_t cur = m_defer.load();
+        while (cur != 0)
+        {
+            if (cur & DEFER_CLAIMED)
+            {
+                sched_yield();
+                cur = m_defer.load();
+            }
+            else
+                m_defer.compare_exchange_weak(cur, 0);
+        }
+    }
+
     /**
      * @brief Unmap memory-mapped file
      */
@@ -0,0 +1,77 @@
+#include "json_bind.h"
+
+JSON_BIND_SINK::JSON_BIND_SINK(size_t fields)
+    : m_reader(*this), m_fields(fields), m_set(0), m_depth(0), m_field(-1), m_valid(true)
+{
+}
+
+JSON_HANDLER::ACTION JSON_BIND_SINK::found(const JSON_VALUE &v)
+{
+    if (m_depth == 0) // the body is a scalar, not an object
+    {
+        m_valid = false;
+        return STOP;
+    }
+    // only fields are not skipped, so m_field is set
+    int i = m_field;
+    m_field = -1;
+    if (v.isNULL())
+        return CONTINUE;
+    if (!assign(i, v))
+    {
+        m_valid = false;
+        return STOP;
+    }
+    m_set |= (uint32_t)1 << i;
+    return m_set == ((uint32_t)1 << m_fields) - 1 ? STOP : CONTINUE;
+}
+
+JSON_HANDLER::ACTION JSON_BIND_SINK::container()
+{
+    // a field holding an object or an array: no member type takes one
+    m_valid = false;
+    return STOP;
+}
+
+JSON_HANDLER::ACTION JSON_BIND_SINK::start_object()
+{
+    if (m_depth == 0)
+    {
+        m_depth++;
+        return CONTINUE;
+    }
+    return container();
+}
+
+JSON_HANDLER::ACTION JSON_BIND_SINK::start_array()
+{
+    return container(); // at the top, not an object either
+}
+
+JSON_HANDLER::ACTION JSON_BIND_SINK::key(std::string_view k)
+{
+    int i = field(k);
+    if (i < 0 || is_set(i))
+        return SKIP;
+    m_field = i;
+    return CONTINUE;
+}
+
+void JSON_BIND_SINK::write(const char *data, size_t len)
+{
+    m_reader.feed(data, len); // a no-op once stopped or failed
+}
+
+void JSON_BIND_SINK::finish()
+{
+    if (m_reader.finish() == JSON_READER::FAILED)
+    {
+        LOG_DEBUG("request body: JSON parse error at offset %zu: %s", m_reader.error_offset(), m_reader.error());
+        m_valid = false;
+    }
+    if (!m_valid) // an invalid body sets no field
+    {
+        m_set = 0;
+        reset();
+    }
+}
@@ -0,0 +1,335 @@
+/**
+ * NOTE:
+ * JSON object bodies read straight into a C++ struct, no tree in between:
+ *
+ *   struct CREDENTIALS { std::string username; std::string password; };
+ *   JSON_BIND(CREDENTIALS, username, password);   // at namespace scope
+ *
+ *   router.stream(POST, "/login", [](const HttpRequest &) { return new JSON_BODY<CREDENTIALS>(); });
+ *   router.post("/login", [](const HttpRequest &req, HttpResponse &res)
+ *               { const JSON_BODY<CREDENTIALS> &body = *req.sink<JSON_BODY<CREDENTIALS>>();
+ *                 if (body.complete()) check(body.value().username, ...); });
+ *
+ * JSON_BIND records the names and member pointers of the fields. From them a perfect hash
+ * of the names is found at compile time (a seed for which no two names share a slot of a
+ * power-of-two table), together with one setter per field: a key of the body costs one
+ * hash, one comparison and, if it is a field, one indirect call that converts the value
+ * into the member. Other keys are skipped by the reader without being copied.
+ *
+ * Members may be std::string, bool or any arithmetic type; a field whose value has another
+ * type (an object for a string...) or does not fit the member (out of its range, a fraction
+ * for an integer) makes the body invalid, a null leaves the member as it was. Fields are the
+ * first occurrence of their key and reading stops once all of them were set. json_bind()
+ * does the same for a body that is already in memory.
+ */
+
+#ifndef _JSON_BIND_H_
+#define _JSON_BIND_H_
+
+#include <stdint.h>
+#include <cmath>
+#include <array>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "http_types.h"
+#include "json_reader.h"
+#include "json_value.h"
+
+/**
+ * @brief Fields of a struct, specialized by JSON_BIND
+ *
+ * A specialization has `names`, an array of the field names, and `members`, a tuple of the
+ * matching member pointers.
+ */
+template <typename T>
+struct JSON_BINDING;
+
+/* JSON_BIND_EACH(m, T, a, b, c) expands to m(T, a), m(T, b), m(T, c) (up to 16 fields) */
+#define JSON_BIND_EXPAND(x) x
+#define JSON_BIND_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define JSON_BIND_1(m, T, a) m(T, a)
+#define JSON_BIND_2(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_1(m, T, __VA_ARGS__))
+#define JSON_BIND_3(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_2(m, T, __VA_ARGS__))
+#define JSON_BIND_4(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_3(m, T, __VA_ARGS__))
+#define JSON_BIND_5(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_4(m, T, __VA_ARGS__))
+#define JSON_BIND_6(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_5(m, T, __VA_ARGS__))
+#define JSON_BIND_7(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_6(m, T, __VA_ARGS__))
+#define JSON_BIND_8(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_7(m, T, __VA_ARGS__))
+#define JSON_BIND_9(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_8(m, T, __VA_ARGS__))
+#define JSON_BIND_10(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_9(m, T, __VA_ARGS__))
+#define JSON_BIND_11(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_10(m, T, __VA_ARGS__))
+#define JSON_BIND_12(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_11(m, T, __VA_ARGS__))
+#define JSON_BIND_13(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_12(m, T, __VA_ARGS__))
+#define JSON_BIND_14(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_13(m, T, __VA_ARGS__))
+#define JSON_BIND_15(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_14(m, T, __VA_ARGS__))
+#define JSON_BIND_16(m, T, a, ...) m(T, a), JSON_BIND_EXPAND(JSON_BIND_15(m, T, __VA_ARGS__))
+#define JSON_BIND_EACH(m, T, ...)                                                                    \
+    JSON_BIND_EXPAND(JSON_BIND_PICK(__VA_ARGS__, JSON_BIND_16, JSON_BIND_15, JSON_BIND_14,           \
+                                    JSON_BIND_13, JSON_BIND_12, JSON_BIND_11, JSON_BIND_10,          \
+                                    JSON_BIND_9, JSON_BIND_8, JSON_BIND_7, JSON_BIND_6, JSON_BIND_5, \
+                                    JSON_BIND_4, JSON_BIND_3, JSON_BIND_2, JSON_BIND_1)(m, T, __VA_ARGS__))
+#define JSON_BIND_NAME(T, f) std::string_view(#f)
+#define JSON_BIND_MEMBER(T, f) &T::f
+
+/**
+ * @brief Make the members @p ... of struct @p TYPE the fields of its JSON form (at most 16)
+ */
+#define JSON_BIND(TYPE, ...)                                                                      \
+    template <>                                                                                   \
+    struct JSON_BINDING<TYPE>                                                                     \
+    {                                                                                             \
+        static constexpr std::string_view names[] = {JSON_BIND_EACH(JSON_BIND_NAME, TYPE, __VA_ARGS__)}; \
+        static constexpr auto members = std::make_tuple(JSON_BIND_EACH(JSON_BIND_MEMBER, TYPE, __VA_ARGS__)); \
+    }
+
+/**
+ * @brief Seeded FNV-1a, usable at compile time
+ */
+constexpr uint32_t json_bind_hash(std::string_view s, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : s)
+        h = (h ^ (unsigned char)c) * 16777619u;
+    return h ^ (h >> 16);
+}
+
+/**
+ * @struct JSON_BIND_TABLE
+ * @brief Perfect hash of @p N names: slot[hash(name, seed) & (SLOTS - 1)] is its index
+ */
+template <size_t N>
+struct JSON_BIND_TABLE
+{
+    static constexpr size_t SLOTS = N <= 2 ? 4 : N <= 4 ? 8 : N <= 8 ? 16 : 32; ///< Load <= 1/2
+
+    uint32_t seed;                   ///< First collision-free seed, 0 if none was found
+    std::array<int8_t, SLOTS> slot;  ///< Field index, -1 for an empty slot
+
+    static constexpr JSON_BIND_TABLE build(const std::string_view (&names)[N])
+    {
+        JSON_BIND_TABLE t{0, {}};
+        for (uint32_t seed = 1; seed < 100000; seed++)
+        {
+            for (size_t i = 0; i < SLOTS; i++)
+                t.slot[i] = -1;
+            bool ok = true;
+            for (size_t i = 0; i < N && ok; i++)
+            {
+                int8_t &s = t.slot[json_bind_hash(names[i], seed) & (SLOTS - 1)];
+                ok = s == -1;
+                s = (int8_t)i;
+            }
+            if (ok)
+            {
+                t.seed = seed;
+                return t;
+            }
+        }
+        return t;
+    }
+};
+
+/* Conversion of a scalar of the body into a member, false if the types do not match */
+inline bool json_bind_assign(std::string &out, const JSON_VALUE &v)
+{
+    if (v.type() != JSONType::STRING)
+        return false;
+    out.assign(v.get<std::string_view>());
+    return true;
+}
+
+inline bool json_bind_assign(bool &out, const JSON_VALUE &v)
+{
+    if (v.type() != JSONType::BOOL)
+        return false;
+    out = v.get<bool>();
+    return true;
+}
+
+/* A number is only stored if M holds it: the conversion would otherwise be undefined (1e300
+   into an int) or silently change it (4294967296 wrapping to 0, 1.5 truncated to 1) */
+template <typename M>
+bool json_bind_assign(M &out, const JSON_VALUE &v)
+{
+    static_assert(std::is_arithmetic_v<M>, "JSON_BIND fields must be std::string, bool or arithmetic");
+    using LIMITS = std::numeric_limits<M>;
+    if (v.type() == JSONType::INTEGER)
+    {
+        int64_t i = v.get<int64_t>();
+        if constexpr (std::is_integral_v<M> && std::is_signed_v<M>)
+        {
+            if (i < (int64_t)LIMITS::min() || i > (int64_t)LIMITS::max())
+                return false;
+        }
+        else if constexpr (std::is_integral_v<M>)
+        {
+            if (i < 0 || (uint64_t)i > (uint64_t)LIMITS::max())
+                return false;
+        }
+        out = (M)i; // to a floating type: rounded, always in range
+        return true;
+    }
+    if (v.type() != JSONType::NUMBER)
+        return false;
+    double d = v.get<double>();
+    if constexpr (std::is_integral_v<M>)
+    {
+        // [-2^digits, 2^digits) for signed M, [0, 2^digits) for unsigned: exact in a double
+        double limit = std::ldexp(1.0, LIMITS::digits);
+        if (d != std::trunc(d) || d >= limit || d < (std::is_signed_v<M> ? -limit : 0.0))
+            return false;
+    }
+    else if (std::isfinite(d) && std::fabs(d) > (double)LIMITS::max())
+        return false;
+    out = (M)d;
+    return true;
+}
+
+/**
+ * @class JSON_BIND_SINK
+ * @brief Streaming part of JSON_BODY, independent of the struct
+ *
+ * Reads the body with a JSON_READER and hands each scalar of a known field to assign().
+ */
+class JSON_BIND_SINK : public BODY_SINK, private JSON_HANDLER
+{
+private:
+    JSON_READER m_reader;
+    size_t m_fields;   ///< Number of fields
+    uint32_t m_set;    ///< Bit per field that was set
+    int m_depth;       ///< 1 once inside the top-level object
+    int m_field;       ///< Field the next value belongs to, -1 if none
+    bool m_valid;      ///< The body is an object and no field had a wrong type
+
+    ACTION found(const JSON_VALUE &v);
+    ACTION container();
+
+    /* JSON_HANDLER */
+    ACTION start_object() override;
+    ACTION start_array() override;
+    ACTION key(std::string_view k) override;
+    ACTION string(std::string_view s) override { return found(JSON_VALUE(s.data(), (uint32_t)s.size())); }
+    ACTION number(double d) override { return found(JSON_VALUE(d)); }
+    ACTION integer(int64_t i) override { return found(JSON_VALUE(i)); }
+    ACTION boolean(bool b) override { return found(JSON_VALUE(b)); }
+    ACTION null() override { return found(JSON_VALUE()); }
+
+protected:
+    explicit JSON_BIND_SINK(size_t fields);
+
+    /**
+     * @brief Index of the field named @p key, -1 if it is not one
+     */
+    virtual int field(std::string_view key) const = 0;
+
+    /**
+     * @brief Store @p v in field @p index, false if its type does not fit
+     */
+    virtual bool assign(int index, const JSON_VALUE &v) = 0;
+
+    /**
+     * @brief Forget every field (the body was invalid)
+     */
+    virtual void reset() = 0;
+
+    bool is_set(int index) const { return index >= 0 && (m_set >> index & 1); }
+
+public:
+    /* BODY_SINK */
+    void write(const char *data, size_t len) override;
+    void finish() override;
+
+    /**
+     * @brief The body was a JSON object whose fields all had usable types
+     */
+    bool valid() const { return m_valid; }
+
+    /**
+     * @brief valid(), and every field was in the body
+     */
+    bool complete() const { return m_valid && m_set == ((uint32_t)1 << m_fields) - 1; }
+};
+
+/**
+ * @class JSON_BODY
+ * @brief Body sink filling a T declared with JSON_BIND
+ */
+template <typename T>
+class JSON_BODY : public JSON_BIND_SINK
+{
+private:
+    using BINDING = JSON_BINDING<T>;
+    static constexpr size_t N = std::size(BINDING::names);
+    using TABLE = JSON_BIND_TABLE<N>;
+    using SETTER = bool (*)(T &, const JSON_VALUE &);
+
+    static_assert(N <= 16, "JSON_BIND takes up to 16 fields");
+    static constexpr TABLE s_table = TABLE::build(BINDING::names);
+    static_assert(s_table.seed != 0, "no perfect hash found for the JSON_BIND field names");
+
+    template <size_t I>
+    static bool set(T &out, const JSON_VALUE &v)
+    {
+        return json_bind_assign(out.*std::get<I>(BINDING::members), v);
+    }
+
+    template <size_t... I>
+    static constexpr std::array<SETTER, N> setters(std::index_sequence<I...>)
+    {
+        return {&set<I>...};
+    }
+
+    static constexpr std::array<SETTER, N> s_setters = setters(std::make_index_sequence<N>());
+
+    T m_value;
+
+protected:
+    int field(std::string_view key) const override { return index(key); }
+    bool assign(int i, const JSON_VALUE &v) override { return s_setters[i](m_value, v); }
+    void reset() override { m_value = T(); }
+
+public:
+    JSON_BODY() : JSON_BIND_SINK(N), m_value() {}
+
+    /**
+     * @brief Index of field @p name, -1 if T has none by that name
+     */
+    static int index(std::string_view name)
+    {
+        int i = s_table.slot[json_bind_hash(name, s_table.seed) & (TABLE::SLOTS - 1)];
+        return i >= 0 && BINDING::names[i] == name ? i : -1;
+    }
+
+    /**
+     * @brief The struct; fields missing from the body keep their default value
+     */
+    const T &value() const { return m_value; }
+    T &value() { return m_value; }
+
+    /**
+     * @brief Whether field @p name was in the body
+     */
+    bool has(std::string_view name) const { return is_set(index(name)); }
+};
+
+/**
+ * @brief Fill @p out from the JSON object in @p data
+ * @return JSON_BODY::complete(): valid and every field present
+ */
+template <typename T>
+bool json_bind(const char *data, size_t len, T &out)
+{
+    JSON_BODY<T> body;
+    body.write(data, len);
+    body.finish();
+    out = std::move(body.value());
+    return body.complete();
+}
+
+#endif
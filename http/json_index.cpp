@@ -0,0 +1,271 @@
+#include <string.h>
+#include "json_index.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define JSON_INDEX_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @struct BLOCK_MASKS
+ * @brief Character classes of one 64-byte block, bit i for byte i
+ */
+struct BLOCK_MASKS
+{
+    uint64_t quote;     ///< '"'
+    uint64_t backslash; ///< '\\'
+    uint64_t op;        ///< { } [ ] : ,
+    uint64_t ws;        ///< space, \t, \n, \r
+    uint64_t ctrl;      ///< bytes below 0x20
+};
+
+static inline __attribute__((always_inline)) void classify_scalar(const char *block, BLOCK_MASKS &m)
+{
+    m.quote = m.backslash = m.op = m.ws = m.ctrl = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        unsigned char c = block[i];
+        uint64_t bit = 1ULL << i;
+        if (c == '"')
+            m.quote |= bit;
+        else if (c == '\\')
+            m.backslash |= bit;
+        else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',')
+            m.op |= bit;
+        else if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            m.ws |= bit;
+        if (c < 0x20)
+            m.ctrl |= bit;
+    }
+}
+
+#ifdef JSON_INDEX_X86
+static inline __attribute__((always_inline)) void classify_sse2(const char *block, BLOCK_MASKS &m)
+{
+    m.quote = m.backslash = m.op = m.ws = m.ctrl = 0;
+    for (int k = 0; k < 4; k++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + 16 * k));
+        // '{' | 0x20 == '{' and '[' | 0x20 == '{', same for '}' and ']'
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        __m128i ctrl = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F)); // v <= 0x1F
+        int shift = 16 * k;
+        m.quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << shift;
+        m.backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << shift;
+        m.op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << shift;
+        m.ws |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << shift;
+        m.ctrl |= (uint64_t)(uint16_t)_mm_movemask_epi8(ctrl) << shift;
+    }
+}
+
+__attribute__((target("avx2"))) static inline void classify_avx2(const char *block, BLOCK_MASKS &m)
+{
+    m.quote = m.backslash = m.op = m.ws = m.ctrl = 0;
+    for (int k = 0; k < 2; k++)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + 32 * k));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        __m256i ctrl = _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x1F)), _mm256_set1_epi8(0x1F));
+        int shift = 32 * k;
+        m.quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << shift;
+        m.backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << shift;
+        m.op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+        m.ws |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << shift;
+        m.ctrl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ctrl) << shift;
+    }
+}
+#endif
+
+JSON_INDEX::KERNEL JSON_INDEX::kernel()
+{
+    static const KERNEL detected = []()
+    {
+#ifdef JSON_INDEX_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("popcnt"))
+            return AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return SSE2;
+#endif
+        return SCALAR;
+    }();
+    return detected;
+}
+
+const char *JSON_INDEX::kernel_name(KERNEL k)
+{
+    switch (k)
+    {
+    case AVX2:
+        return "avx2";
+    case SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+/**
+ * @brief Bits following an odd-length run of backslashes, i.e. escaped characters
+ * @param prev_odd In/out: 1 if the previous block ended inside such a run
+ */
+static inline __attribute__((always_inline)) uint64_t escaped_bits(uint64_t backslash, uint64_t &prev_odd)
+{
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    const uint64_t odd_bits = ~even_bits;
+
+    // runs are found through their start; a run starting at an even bit and ending at an odd
+    // one has odd length (and vice versa), which the carry of an addition reveals
+    uint64_t start_edges = backslash & ~(backslash << 1);
+    uint64_t even_start_mask = even_bits ^ prev_odd;
+    uint64_t even_starts = start_edges & even_start_mask;
+    uint64_t odd_starts = start_edges & ~even_start_mask;
+    uint64_t even_carries = backslash + even_starts;
+    unsigned long long odd_carries;
+    bool ends_odd = __builtin_uaddll_overflow(backslash, odd_starts, &odd_carries);
+    odd_carries |= prev_odd;
+    prev_odd = ends_odd ? 1 : 0;
+    uint64_t even_carry_ends = even_carries & ~backslash;
+    uint64_t odd_carry_ends = odd_carries & ~backslash;
+    return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+}
+
+/**
+ * @brief Bit i = XOR of bits 0..i, turns quote positions into an in-string mask
+ */
+static inline __attribute__((always_inline)) uint64_t prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/**
+ * @brief Append the offsets of the bits of @p bits
+ *
+ * Writes 8 offsets at a time whatever the count (the extra ones are overwritten by the next
+ * block, the buffer has slack): the loop then has one well predicted branch per 8 bits
+ * instead of one mispredicted exit per block.
+ */
+static inline __attribute__((always_inline)) uint32_t *flatten(uint32_t *out, uint32_t base, uint64_t bits)
+{
+    int count = __builtin_popcountll(bits);
+    uint32_t *p = out;
+    do
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            p[i] = base + __builtin_ctzll(bits | (1ULL << 63));
+            bits &= bits - 1;
+        }
+        p += 8;
+    } while (bits);
+    return out + count;
+}
+
+/**
+ * @struct INDEX_RESULT
+ * @brief Outcome of index_blocks()
+ */
+struct INDEX_RESULT
+{
+    size_t count;      ///< Positions written
+    const char *error; ///< NULL on success
+    size_t offset;     ///< Where the error is
+};
+
+/**
+ * @brief The stage 1 loop, instantiated once per kernel and flattened into its entry point
+ *        so that each copy is compiled for its instruction set (ctz and popcount included)
+ */
+template <void (*CLASSIFY)(const char *, BLOCK_MASKS &)>
+static inline INDEX_RESULT index_blocks(const char *data, size_t len, uint32_t *positions)
+{
+    uint32_t *out = positions;
+    uint64_t prev_odd = 0;       // previous block ended in an odd backslash run
+    uint64_t prev_in_string = 0; // all ones if the previous block ended inside a string
+    uint64_t prev_scalar = 0;    // previous block ended inside a number/literal
+    char tail[64];
+    for (size_t base = 0; base < len; base += 64)
+    {
+        const char *block = data + base;
+        if (len - base < 64)
+        {
+            memset(tail, ' ', sizeof(tail)); // padding is whitespace, it never changes the result
+            memcpy(tail, block, len - base);
+            block = tail;
+        }
+
+        BLOCK_MASKS m;
+        CLASSIFY(block, m);
+
+        uint64_t quotes = m.quote & ~escaped_bits(m.backslash, prev_odd);
+        uint64_t in_string = prefix_xor(quotes) ^ prev_in_string; // opening quote in, closing quote out
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+        uint64_t bad = m.ctrl & in_string;
+        if (bad)
+            return INDEX_RESULT{0, "control character in string", base + __builtin_ctzll(bad)};
+
+        uint64_t scalar = ~(m.op | m.ws | quotes | in_string);
+        uint64_t scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+        prev_scalar = scalar >> 63;
+        uint64_t structural = (m.op & ~in_string) | quotes | scalar_start;
+
+        out = flatten(out, base, structural);
+    }
+
+    if (prev_in_string)
+        return INDEX_RESULT{0, "unterminated string", len};
+    return INDEX_RESULT{(size_t)(out - positions), NULL, 0};
+}
+
+__attribute__((flatten)) static INDEX_RESULT index_scalar(const char *data, size_t len, uint32_t *positions)
+{
+    return index_blocks<classify_scalar>(data, len, positions);
+}
+
+#ifdef JSON_INDEX_X86
+__attribute__((flatten)) static INDEX_RESULT index_sse2(const char *data, size_t len, uint32_t *positions)
+{
+    return index_blocks<classify_sse2>(data, len, positions);
+}
+
+__attribute__((target("avx2,bmi,popcnt"), flatten)) static INDEX_RESULT index_avx2(const char *data, size_t len, uint32_t *positions)
+{
+    return index_blocks<classify_avx2>(data, len, positions);
+}
+#endif
+
+bool JSON_INDEX::build(const char *data, size_t len, KERNEL k)
+{
+    if (m_positions.size() < len + 64)
+        m_positions.resize(len + 64); // every byte structural is the worst case, plus flatten() slack
+
+    INDEX_RESULT r;
+#ifdef JSON_INDEX_X86
+    if (k == AVX2)
+        r = index_avx2(data, len, m_positions.data());
+    else if (k == SSE2)
+        r = index_sse2(data, len, m_positions.data());
+    else
+#endif
+        r = index_scalar(data, len, m_positions.data());
+
+    m_count = r.count;
+    m_error = r.error;
+    m_error_offset = r.offset;
+    return r.error == NULL;
+}
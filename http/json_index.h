@@ -0,0 +1,85 @@
+/**
+ * NOTE:
+ * Stage 1 of the indexed JSON parser (simdjson-style): one pass over the text, 64 bytes at a
+ * time, turning it into bitmaps and then into the list of structural positions:
+ * - the opening and closing quote of every string
+ * - { } [ ] : , outside strings
+ * - the first byte of every number/literal
+ * Stage 2 (JSON_LAZY::parse, see JSON_INDEX_MIN_BYTES) then jumps from position to
+ * position and never looks at whitespace or string contents byte by byte.
+ *
+ * Per block: SIMD compares give the quote, backslash, operator, whitespace and control
+ * character masks; quotes preceded by an odd run of backslashes are dropped; a prefix XOR
+ * of the remaining quotes gives the in-string mask. Block-to-block state is three carries.
+ * The kernel (AVX2, SSE2 or portable scalar) is chosen once, from the running CPU.
+ */
+
+#ifndef _JSON_INDEX_H_
+#define _JSON_INDEX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * JSON_LAZY::parse validates texts of this size and more through the index when a sample of
+ * their head has at most one operator or quote per JSON_INDEX_SPARSE bytes: the index pays
+ * off on long strings (1.6x on records of 50-400 byte strings), the recursive-descent
+ * validator wins on dense documents of short tokens (~0.7x for those)
+ */
+static const size_t JSON_INDEX_MIN_BYTES = 16 * 1024;
+static const size_t JSON_INDEX_SAMPLE = 4096; ///< Bytes sampled
+static const size_t JSON_INDEX_SPARSE = 8;
+
+/**
+ * @class JSON_INDEX
+ * @brief Structural positions of a JSON text (stage 1)
+ */
+class JSON_INDEX
+{
+public:
+    /**
+     * @enum KERNEL
+     * @brief Block classifier implementation
+     */
+    enum KERNEL
+    {
+        SCALAR = 0, ///< Portable, byte by byte
+        SSE2,       ///< 4 x 16 bytes
+        AVX2        ///< 2 x 32 bytes
+    };
+
+private:
+    std::vector<uint32_t> m_positions; ///< Structural offsets, reused across build() calls
+    size_t m_count;                    ///< Valid entries in m_positions
+    const char *m_error;               ///< Why build() failed
+    size_t m_error_offset;             ///< Where
+
+public:
+    JSON_INDEX() : m_count(0), m_error(NULL), m_error_offset(0) {}
+
+    /**
+     * @brief Kernel used by build(), detected on first use
+     */
+    static KERNEL kernel();
+
+    /**
+     * @brief Name of a kernel ("scalar", "sse2", "avx2")
+     */
+    static const char *kernel_name(KERNEL k);
+
+    /**
+     * @brief Index @p len bytes at @p data
+     * @param k Kernel to use, kernel() by default (benchmarks compare them)
+     * @return false on an unterminated string or a control character inside a string; the
+     *         rest of the grammar is checked by stage 2
+     */
+    bool build(const char *data, size_t len, KERNEL k = kernel());
+
+    const uint32_t *positions() const { return m_positions.data(); }
+    size_t count() const { return m_count; }
+    const char *error() const { return m_error; }
+    size_t error_offset() const { return m_error_offset; }
+};
+
+#endif
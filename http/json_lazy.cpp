@@ -0,0 +1,169 @@
+#include <string.h>
+#include "json_lazy.h"
+
+/* The text was validated by JSON_LAZY::parse: the scanners below trust its structure */
+
+static inline const char *skip_whitespace(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        p++;
+    return p;
+}
+
+/**
+ * @brief Past the closing quote of the string whose opening quote is at @p p
+ */
+static const char *skip_string(const char *p, const char *end)
+{
+    p++;
+    while (true)
+    {
+        const char *q = (const char *)memchr(p, '"', end - p);
+        // escaped if an odd run of backslashes precedes it
+        const char *b = q;
+        while (b > p && b[-1] == '\\')
+            b--;
+        if (((q - b) & 1) == 0)
+            return q + 1;
+        p = q + 1;
+    }
+}
+
+/**
+ * @brief Past the value starting at @p p, without decoding it
+ */
+static const char *skip_value(const char *p, const char *end)
+{
+    switch (*p)
+    {
+    case '"':
+        return skip_string(p, end);
+    case '{':
+    case '[':
+    {
+        int depth = 0;
+        while (true)
+        {
+            char c = *p;
+            if (c == '"')
+            {
+                p = skip_string(p, end);
+                continue;
+            }
+            if (c == '{' || c == '[')
+                depth++;
+            else if ((c == '}' || c == ']') && --depth == 0)
+                return p + 1;
+            p++;
+        }
+    }
+    default: // number or literal
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+            p++;
+        return p;
+    }
+}
+
+JSONType JSON_LAZY_VALUE::type() const
+{
+    switch (*m_begin)
+    {
+    case '{':
+        return JSONType::OBJECT;
+    case '[':
+        return JSONType::ARRAY;
+    case '"':
+        return JSONType::STRING;
+    case 't':
+    case 'f':
+        return JSONType::BOOL;
+    case 'n':
+        return JSONType::NULLT;
+    default:
+        return JSON_VALUE::number(m_begin, m_end - m_begin).type();
+    }
+}
+
+size_t JSON_LAZY_VALUE::size() const
+{
+    if (!isArray() && !isObject())
+        return 0;
+    const char *p = skip_whitespace(m_begin + 1, m_end);
+    if (*p == ']' || *p == '}')
+        return 0;
+    size_t n = 1;
+    while (true)
+    {
+        if (isObject()) // key and ':'
+            p = skip_whitespace(skip_whitespace(skip_string(p, m_end), m_end) + 1, m_end);
+        p = skip_whitespace(skip_value(p, m_end), m_end);
+        if (*p != ',')
+            return n;
+        p = skip_whitespace(p + 1, m_end);
+        n++;
+    }
+}
+
+JSON_LAZY_VALUE JSON_LAZY_VALUE::operator[](size_t index) const
+{
+    limitToArray();
+    const char *p = skip_whitespace(m_begin + 1, m_end);
+    if (*p != ']')
+        for (size_t i = 0;; i++)
+        {
+            const char *v = p;
+            p = skip_value(p, m_end);
+            if (i == index)
+                return JSON_LAZY_VALUE(v, p, m_arena);
+            p = skip_whitespace(p, m_end);
+            if (*p != ',')
+                break;
+            p = skip_whitespace(p + 1, m_end);
+        }
+    throw std::out_of_range("array index out of range");
+}
+
+bool JSON_LAZY_VALUE::find(std::string_view key, JSON_LAZY_VALUE &out) const
+{
+    limitToObject();
+    bool found = false;
+    const char *p = skip_whitespace(m_begin + 1, m_end);
+    if (*p == '}')
+        return false;
+    while (true)
+    {
+        const char *k = p;
+        p = skip_string(p, m_end);
+        std::string_view name(k + 1, p - k - 2);
+        if (memchr(name.data(), '\\', name.size())) // escaped key: compared decoded
+            name = JSON_LAZY_VALUE(k, p, m_arena).get<std::string_view>();
+        bool match = name == key;
+
+        p = skip_whitespace(skip_whitespace(p, m_end) + 1, m_end); // ':'
+        const char *v = p;
+        p = skip_value(p, m_end);
+        if (match) // keep going: the last repeated key wins
+        {
+            out = JSON_LAZY_VALUE(v, p, m_arena);
+            found = true;
+        }
+        p = skip_whitespace(p, m_end);
+        if (*p != ',')
+            return found;
+        p = skip_whitespace(p + 1, m_end);
+    }
+}
+
+bool JSON_LAZY_VALUE::has(std::string_view key) const
+{
+    JSON_LAZY_VALUE v;
+    return find(key, v);
+}
+
+JSON_LAZY_VALUE JSON_LAZY_VALUE::operator[](std::string_view key) const
+{
+    JSON_LAZY_VALUE v;
+    if (!find(key, v))
+        throw std::out_of_range("no member named " + std::string(key));
+    return v;
+}
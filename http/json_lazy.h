@@ -0,0 +1,189 @@
+/**
+ * NOTE:
+ * On-demand JSON document, the type of request bodies (req.m_body):
+ * - parse() only validates the text (same grammar as JSON_DOCUMENT::parse) and allocates
+ *   nothing: the document is the text itself, which must outlive it. Large bodies made
+ *   mostly of string data are validated from a SIMD index (json_index.h)
+ * - a JSON_LAZY_VALUE is a span of that text; operator[] finds a member or an item by
+ *   scanning its container, stepping over the other values without decoding them
+ * - get<T>() converts a scalar when it is read; a string with escapes is then decoded into
+ *   the document's arena, others are views into the text
+ * - value() builds the compact tree (JSON_VALUE) of one subtree, for handlers that iterate
+ *   over it
+ * A handler reading 3 members of a 50-member body thus pays for one validation pass and 3
+ * conversions; every subtree it does not walk into is never allocated. Each operator[]
+ * rescans its container: keep the JSON_LAZY_VALUE of a container that is used repeatedly.
+ */
+
+#ifndef _JSON_LAZY_H_
+#define _JSON_LAZY_H_
+
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+#include "jsonparser.h"
+#include "json_value.h"
+#include "json_index.h"
+
+/**
+ * @class JSON_LAZY_VALUE
+ * @brief A value of a JSON_LAZY document, as the span of its text
+ */
+class JSON_LAZY_VALUE
+{
+private:
+    const char *m_begin; ///< First byte of the value
+    const char *m_end;   ///< Past its last byte
+    JSON_ARENA *m_arena; ///< Arena of the document, for value()
+
+    /// @throws std::runtime_error if value is not an array
+    void limitToArray() const
+    {
+        if (!isArray())
+            throw std::runtime_error("This operation is only available to array node");
+    }
+    /// @throws std::runtime_error if value is not an object
+    void limitToObject() const
+    {
+        if (!isObject())
+            throw std::runtime_error("This operation is only available to object node");
+    }
+
+public:
+    /**
+     * @brief Value spanning [@p begin, @p end) of validated text
+     */
+    JSON_LAZY_VALUE(const char *begin, const char *end, JSON_ARENA *arena) : m_begin(begin), m_end(end), m_arena(arena) {}
+
+    /**
+     * @brief Null value, outside any document
+     */
+    JSON_LAZY_VALUE() : m_begin("null"), m_end(m_begin + 4), m_arena(NULL) {}
+
+    JSONType type() const;
+
+    bool isValue() const { return !isObject() && !isArray(); }
+    bool isNULL() const { return *m_begin == 'n'; }
+    bool isArray() const { return *m_begin == '['; }
+    bool isObject() const { return *m_begin == '{'; }
+
+    /**
+     * @brief Items of an array, members of an object (counted by a scan), 0 otherwise
+     */
+    size_t size() const;
+
+    /**
+     * @brief The JSON text of the value, as in the body
+     */
+    std::string_view text() const { return std::string_view(m_begin, m_end - m_begin); }
+
+    /**
+     * @brief Array element
+     * @throws std::runtime_error if not an array, std::out_of_range if @p index is invalid
+     */
+    JSON_LAZY_VALUE operator[](size_t index) const;
+    JSON_LAZY_VALUE operator[](int index) const { return (*this)[(size_t)index]; }
+
+    /**
+     * @brief Whether the object has a member @p key
+     * @throws std::runtime_error if not an object
+     */
+    bool has(std::string_view key) const;
+
+    /**
+     * @brief Object member, the last one if the key is repeated (as JSON_VALUE)
+     * @throws std::runtime_error if not an object, std::out_of_range if @p key is missing
+     */
+    JSON_LAZY_VALUE operator[](std::string_view key) const;
+    JSON_LAZY_VALUE operator[](const char *key) const { return (*this)[std::string_view(key)]; }
+    JSON_LAZY_VALUE operator[](const std::string &key) const { return (*this)[std::string_view(key)]; }
+
+    /**
+     * @brief Compact tree of this value and everything below it, built in the document's
+     *        arena (strings without escapes stay views into the text)
+     */
+    JSON_VALUE value() const;
+
+    /**
+     * @brief Value extractor, same types and errors as JSON_VALUE::get
+     */
+    template <typename T>
+    T get() const
+    {
+        if (!isValue())
+            throw std::runtime_error("unable to get value for this type");
+        return value().get<T>();
+    }
+
+    /**
+     * @brief Deep copy into a mutable JSONNode tree
+     */
+    JSONNode to_node() const { return value().to_node(); }
+
+private:
+    /**
+     * @brief Find member @p key
+     * @return false if there is none
+     */
+    bool find(std::string_view key, JSON_LAZY_VALUE &out) const;
+};
+
+/**
+ * @class JSON_LAZY
+ * @brief A validated JSON text whose values are read on demand
+ */
+class JSON_LAZY
+{
+private:
+    mutable JSON_ARENA m_arena; ///< Decoded strings and value() trees, filled as they are read
+    JSON_LAZY_VALUE m_root;     ///< null until parse() succeeds
+
+public:
+    /**
+     * @enum VALIDATOR
+     * @brief How parse() checks the text
+     */
+    enum VALIDATOR
+    {
+        AUTO,      ///< INDEXED for large texts sparse in structure (JSON_INDEX_MIN_BYTES), else RECURSIVE
+        RECURSIVE, ///< Recursive descent, byte by byte
+        INDEXED    ///< Stage 1 index, then the grammar from its positions
+    };
+
+    JSON_LAZY() {}
+    JSON_LAZY(const JSON_LAZY &) = delete;
+    JSON_LAZY &operator=(const JSON_LAZY &) = delete;
+
+    /**
+     * @brief Validate @p len bytes at @p data, replacing the previous document; nothing is
+     *        copied, @p data must stay unchanged for as long as the document is used
+     * @param validator Forces a path, for tests and benchmarks (both accept the same texts)
+     * @param kernel Stage 1 kernel of INDEXED, at most JSON_INDEX::kernel() (the CPU's best)
+     * @throws std::runtime_error on parse errors, the document is then empty. The messages
+     *         are those of JSONNode::parse, but INDEXED checks every string before the
+     *         grammar: in a text with several errors it may report another one first
+     */
+    void parse(const char *data, size_t len, VALIDATOR validator = AUTO, JSON_INDEX::KERNEL kernel = JSON_INDEX::kernel());
+
+    /**
+     * @brief Drop the document and what was read from it
+     */
+    void clear()
+    {
+        m_arena.reset();
+        m_root = JSON_LAZY_VALUE();
+    }
+
+    JSON_LAZY_VALUE root() const { return m_root; }
+
+    /* Shortcuts to the root, so handlers write req.m_body["key"] */
+    bool isNULL() const { return m_root.isNULL(); }
+    bool has(std::string_view key) const { return m_root.has(key); }
+    JSON_LAZY_VALUE operator[](std::string_view key) const { return m_root[key]; }
+    JSON_LAZY_VALUE operator[](const char *key) const { return m_root[key]; }
+    JSON_LAZY_VALUE operator[](const std::string &key) const { return m_root[key]; }
+    JSON_LAZY_VALUE operator[](int index) const { return m_root[index]; }
+};
+
+#endif
@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <string.h>
+#include "json_reader.h"
+#include "json_value.h"
+
+JSON_READER::JSON_READER(JSON_HANDLER &handler)
+    : m_handler(handler), m_state(S_VALUE), m_status(MORE), m_depth(0), m_skip(0),
+      m_copying(false), m_key(false), m_escape(0), m_cp(0), m_high(0),
+      m_literal(NULL), m_literal_pos(0), m_offset(0), m_error(NULL), m_error_at(0)
+{
+}
+
+JSON_READER::STATUS JSON_READER::fail(const char *what, size_t at)
+{
+    m_status = FAILED;
+    m_error = what;
+    m_error_at = at;
+    return m_status;
+}
+
+bool JSON_READER::act(JSON_HANDLER::ACTION a, int level)
+{
+    if (a == JSON_HANDLER::STOP)
+    {
+        m_status = STOPPED;
+        return false;
+    }
+    if (a == JSON_HANDLER::SKIP && m_skip == 0)
+        m_skip = level;
+    return true;
+}
+
+void JSON_READER::value_done(int level)
+{
+    if (m_skip == level)
+        m_skip = 0;
+    if (m_depth > 0)
+        m_state = S_AFTER;
+    else
+    {
+        m_state = S_END;
+        m_status = DONE;
+    }
+}
+
+bool JSON_READER::push(char c, size_t at)
+{
+    if (m_depth >= JSON_MAX_DEPTH)
+    {
+        fail("nesting too deep", at);
+        return false;
+    }
+    m_stack[m_depth++] = c;
+    m_state = c == '{' ? S_KEY_OR_CLOSE : S_VALUE_OR_CLOSE;
+    if (quiet(m_depth))
+        return true;
+    return act(c == '{' ? m_handler.start_object() : m_handler.start_array(), m_depth);
+}
+
+bool JSON_READER::close(char c, size_t at)
+{
+    char open = c == '}' ? '{' : '[';
+    if (m_stack[m_depth - 1] != open)
+    {
+        fail(m_stack[m_depth - 1] == '{' ? "expected ',' or '}'" : "expected ',' or ']'", at);
+        return false;
+    }
+    int level = m_depth--;
+    if (!quiet(level) && !act(c == '}' ? m_handler.end_object() : m_handler.end_array(), level))
+        return false;
+    value_done(level);
+    return true;
+}
+
+bool JSON_READER::string_done(std::string_view s)
+{
+    int level = m_depth + 1;
+    if (m_key)
+    {
+        m_state = S_COLON;
+        return quiet(level) || act(m_handler.key(s), level);
+    }
+    if (!quiet(level) && !act(m_handler.string(s), level))
+        return false;
+    value_done(level);
+    return true;
+}
+
+bool JSON_READER::number_done(size_t at)
+{
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?, m_token only holds [0-9+-.eE]
+    const char *p = m_token.c_str();
+    if (*p == '-')
+        p++;
+    if (*p == '0')
+        p++;
+    else if (*p >= '1' && *p <= '9')
+        while (*p >= '0' && *p <= '9')
+            p++;
+    else
+        goto invalid;
+    if (*p == '.')
+    {
+        if (*++p < '0' || *p > '9')
+            goto invalid;
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    if (*p == 'e' || *p == 'E')
+    {
+        if (*++p == '+' || *p == '-')
+            p++;
+        if (*p < '0' || *p > '9')
+            goto invalid;
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    if (*p != '\0')
+        goto invalid;
+
+    {
+        int level = m_depth + 1;
+        if (!quiet(level))
+        {
+            JSON_VALUE v = JSON_VALUE::number(m_token.data(), m_token.size());
+            JSON_HANDLER::ACTION a = v.type() == JSONType::INTEGER ? m_handler.integer(v.get<int64_t>()) : m_handler.number(v.get<double>());
+            if (!act(a, level))
+                return false;
+        }
+        value_done(level);
+        return true;
+    }
+
+invalid:
+    fail("invalid number", at);
+    return false;
+}
+
+/**
+ * @brief Append @p cp as UTF-8
+ */
+static void put_utf8(std::string &out, unsigned cp)
+{
+    if (cp < 0x80)
+        out += (char)cp;
+    else if (cp < 0x800)
+    {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+bool JSON_READER::escape(char c, size_t at)
+{
+    bool keep = !quiet(m_depth + 1);
+    switch (m_escape)
+    {
+    case 1: // after '\\'
+    {
+        static const char from[] = "\"\\/bfnrt";
+        static const char to[] = "\"\\/\b\f\n\r\t";
+        const char *e = c ? strchr(from, c) : NULL;
+        if (e)
+        {
+            if (keep)
+                m_token += to[e - from];
+            m_escape = 0;
+        }
+        else if (c == 'u')
+        {
+            m_cp = 0;
+            m_escape = 2;
+        }
+        else
+        {
+            fail("invalid escape", at);
+            return false;
+        }
+        return true;
+    }
+    case 6: // a low surrogate must follow: '\\'
+    case 7: // then 'u'
+        if (c != (m_escape == 6 ? '\\' : 'u'))
+        {
+            fail("unpaired surrogate", at);
+            return false;
+        }
+        m_cp = 0;
+        m_escape = m_escape == 6 ? 7 : 2;
+        return true;
+    default: // \\u digits, m_escape 2..5
+        break;
+    }
+
+    unsigned d;
+    if (c >= '0' && c <= '9')
+        d = c - '0';
+    else if (c >= 'a' && c <= 'f')
+        d = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+        d = c - 'A' + 10;
+    else
+    {
+        fail("invalid \\u escape", at);
+        return false;
+    }
+    m_cp = (m_cp << 4) | d;
+    if (m_escape++ < 5)
+        return true;
+
+    unsigned cp = m_cp;
+    m_escape = 0;
+    if (m_high)
+    {
+        if (cp < 0xDC00 || cp > 0xDFFF)
+        {
+            fail("unpaired surrogate", at);
+            return false;
+        }
+        cp = 0x10000 + ((m_high - 0xD800) << 10) + (cp - 0xDC00);
+        m_high = 0;
+    }
+    else if (cp >= 0xD800 && cp <= 0xDBFF)
+    {
+        m_high = cp;
+        m_escape = 6;
+        return true;
+    }
+    else if (cp >= 0xDC00 && cp <= 0xDFFF)
+    {
+        fail("unpaired surrogate", at);
+        return false;
+    }
+    if (keep)
+        put_utf8(m_token, cp);
+    return true;
+}
+
+static inline bool is_number_char(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+JSON_READER::STATUS JSON_READER::feed(const char *data, size_t len)
+{
+    if (m_status == STOPPED || m_status == FAILED)
+        return m_status;
+
+    const char *p = data;
+    const char *end = data + len;
+    while (p < end)
+    {
+        size_t at = m_offset + (p - data);
+        char c = *p;
+
+        if (m_state == S_STRING)
+        {
+            if (m_escape)
+            {
+                if (!escape(c, at))
+                    return m_status;
+                p++;
+                if (m_token.size() > JSON_READER_MAX_TOKEN)
+                    return fail("string too long", at);
+                continue;
+            }
+
+            // everything up to the next quote, backslash or control character at once
+            const char *run = p;
+            while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20)
+                p++;
+            bool keep = !quiet(m_depth + 1);
+            if (p < end && *p == '"' && !m_copying)
+            {
+                // whole in this chunk and escape-free: a view, no copy
+                p++;
+                if (!string_done(std::string_view(run, p - 1 - run)))
+                    return m_status;
+                continue;
+            }
+            if (keep)
+            {
+                if (m_token.size() + (p - run) > JSON_READER_MAX_TOKEN)
+                    return fail("string too long", at);
+                m_token.append(run, p - run);
+            }
+            m_copying = true;
+            if (p == end)
+                break;
+            if (*p == '"')
+            {
+                p++;
+                if (!string_done(m_token))
+                    return m_status;
+            }
+            else if (*p == '\\')
+            {
+                m_escape = 1;
+                p++;
+            }
+            else
+                return fail("control character in string", m_offset + (p - data));
+            continue;
+        }
+
+        if (m_state == S_NUMBER)
+        {
+            const char *run = p;
+            while (p < end && is_number_char(*p))
+                p++;
+            if (m_token.size() + (p - run) > JSON_READER_MAX_TOKEN)
+                return fail("invalid number", at);
+            m_token.append(run, p - run);
+            if (p == end)
+                break;
+            if (!number_done(m_offset + (p - data)))
+                return m_status;
+            continue; // the delimiter is read by the next state
+        }
+
+        if (m_state == S_LITERAL)
+        {
+            if (c != m_literal[m_literal_pos])
+                return fail("invalid literal", at);
+            p++;
+            if (m_literal[++m_literal_pos] != '\0')
+                continue;
+            int level = m_depth + 1;
+            if (!quiet(level))
+            {
+                JSON_HANDLER::ACTION a = m_literal[0] == 'n' ? m_handler.null() : m_handler.boolean(m_literal[0] == 't');
+                if (!act(a, level))
+                    return m_status;
+            }
+            value_done(level);
+            continue;
+        }
+
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        {
+            p++;
+            continue;
+        }
+
+        switch (m_state)
+        {
+        case S_END:
+            return fail("trailing characters after the document", at);
+
+        case S_COLON:
+            if (c != ':')
+                return fail("expected ':' after key", at);
+            m_state = S_VALUE;
+            p++;
+            break;
+
+        case S_AFTER:
+            if (c == ',')
+            {
+                m_state = m_stack[m_depth - 1] == '{' ? S_KEY : S_VALUE;
+                p++;
+            }
+            else if (c == '}' || c == ']')
+            {
+                if (!close(c, at))
+                    return m_status;
+                p++;
+            }
+            else
+                return fail(m_stack[m_depth - 1] == '{' ? "expected ',' or '}'" : "expected ',' or ']'", at);
+            break;
+
+        case S_KEY_OR_CLOSE:
+        case S_KEY:
+            if (c == '}' && m_state == S_KEY_OR_CLOSE)
+            {
+                if (!close(c, at))
+                    return m_status;
+                p++;
+                break;
+            }
+            if (c != '"')
+                return fail("expected string key", at);
+            m_key = true;
+            m_copying = false;
+            m_token.clear();
+            m_state = S_STRING;
+            p++;
+            break;
+
+        default: // S_VALUE, S_VALUE_OR_CLOSE
+            if (c == ']' && m_state == S_VALUE_OR_CLOSE)
+            {
+                if (!close(c, at))
+                    return m_status;
+                p++;
+            }
+            else if (c == '{' || c == '[')
+            {
+                if (!push(c, at))
+                    return m_status;
+                p++;
+            }
+            else if (c == '"')
+            {
+                m_key = false;
+                m_copying = false;
+                m_token.clear();
+                m_state = S_STRING;
+                p++;
+            }
+            else if (c == '-' || (c >= '0' && c <= '9'))
+            {
+                m_token.clear();
+                m_state = S_NUMBER;
+            }
+            else if (c == 't' || c == 'f' || c == 'n')
+            {
+                m_literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+                m_literal_pos = 0;
+                m_state = S_LITERAL;
+            }
+            else
+                return fail("unexpected character", at);
+            break;
+        }
+    }
+
+    m_offset += len;
+    return m_status;
+}
+
+JSON_READER::STATUS JSON_READER::finish()
+{
+    if (m_status != MORE)
+        return m_status;
+    if (m_state == S_NUMBER) // a top-level number ends with the input
+    {
+        if (!number_done(m_offset))
+            return m_status;
+        if (m_status != MORE)
+            return m_status;
+    }
+    switch (m_state)
+    {
+    case S_STRING:
+        return fail("unterminated string", m_offset);
+    case S_LITERAL:
+        return fail("invalid literal", m_offset);
+    case S_VALUE:
+    case S_VALUE_OR_CLOSE:
+        return fail("expected a value", m_offset);
+    case S_KEY:
+    case S_KEY_OR_CLOSE:
+        return fail("expected string key", m_offset);
+    case S_COLON:
+        return fail("expected ':' after key", m_offset);
+    default:
+        return fail(m_stack[m_depth - 1] == '{' ? "expected ',' or '}'" : "expected ',' or ']'", m_offset);
+    }
+}
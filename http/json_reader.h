@@ -0,0 +1,160 @@
+/**
+ * NOTE:
+ * Event-based (SAX) JSON reader, for bodies that should not become a tree:
+ *
+ *   struct COUNTER : JSON_HANDLER { int n = 0; ACTION number(double) override { n++; return CONTINUE; } };
+ *   COUNTER c;
+ *   JSON_READER reader(c);
+ *   reader.feed(chunk1, len1);   // any split, even inside a string or a number
+ *   reader.feed(chunk2, len2);
+ *   reader.finish();             // end of input
+ *
+ * Every callback may answer:
+ * - CONTINUE
+ * - SKIP: on start_object/start_array the rest of that container, on key() its value, is
+ *   still validated but produces no events and no copies
+ * - STOP: nothing more is read, feed()/finish() return STOPPED
+ *
+ * Memory does not depend on the input size: the nesting (at most JSON_MAX_DEPTH) is one
+ * byte per level, and only a string or number cut by a chunk boundary (or holding escapes)
+ * is copied, up to JSON_READER_MAX_TOKEN bytes. Strings that are whole in a chunk and
+ * escape-free are passed as views into it.
+ */
+
+#ifndef _JSON_READER_H_
+#define _JSON_READER_H_
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+
+#include "jsonparser.h"
+
+static const size_t JSON_READER_MAX_TOKEN = 65536; ///< Longest string/number that may be copied
+
+/**
+ * @class JSON_HANDLER
+ * @brief Receives the events of a JSON_READER, every callback defaults to CONTINUE
+ * @note Views passed to key()/string() are only valid during the call
+ */
+class JSON_HANDLER
+{
+public:
+    /**
+     * @enum ACTION
+     * @brief What the reader does after a callback
+     */
+    enum ACTION
+    {
+        CONTINUE = 0, ///< Keep reading
+        SKIP,         ///< Skip this container (start_*) or the value of this key (key)
+        STOP          ///< Stop reading
+    };
+
+    virtual ~JSON_HANDLER() {}
+
+    virtual ACTION start_object() { return CONTINUE; }
+    virtual ACTION end_object() { return CONTINUE; }
+    virtual ACTION start_array() { return CONTINUE; }
+    virtual ACTION end_array() { return CONTINUE; }
+    virtual ACTION key(std::string_view) { return CONTINUE; }
+    virtual ACTION string(std::string_view) { return CONTINUE; }
+    virtual ACTION number(double) { return CONTINUE; }
+    /// A number without fraction or exponent that fits 64 bits, exact; number() by default
+    virtual ACTION integer(int64_t i) { return number((double)i); }
+    virtual ACTION boolean(bool) { return CONTINUE; }
+    virtual ACTION null() { return CONTINUE; }
+};
+
+/**
+ * @class JSON_READER
+ * @brief Incremental JSON parser delivering events to a JSON_HANDLER
+ */
+class JSON_READER
+{
+public:
+    /**
+     * @enum STATUS
+     * @brief Result of feed()/finish()
+     */
+    enum STATUS
+    {
+        MORE = 0, ///< The document is not complete yet
+        DONE,     ///< One complete document was read (only whitespace may follow)
+        STOPPED,  ///< A callback returned STOP
+        FAILED    ///< Invalid JSON, see error()
+    };
+
+private:
+    /**
+     * @enum STATE
+     * @brief What the next byte may be
+     */
+    enum STATE
+    {
+        S_VALUE,          ///< A value
+        S_VALUE_OR_CLOSE, ///< A value or ']' (just after '[')
+        S_KEY,            ///< A key (after ',' in an object)
+        S_KEY_OR_CLOSE,   ///< A key or '}' (just after '{')
+        S_COLON,          ///< ':' after a key
+        S_AFTER,          ///< ',' or the closing bracket, or the end at top level
+        S_STRING,         ///< Inside a string or key
+        S_NUMBER,         ///< Inside a number
+        S_LITERAL,        ///< Inside true/false/null
+        S_END             ///< The document is complete
+    };
+
+    JSON_HANDLER &m_handler;
+    STATE m_state;
+    STATUS m_status;
+    char m_stack[JSON_MAX_DEPTH]; ///< '{' or '[' per open container
+    int m_depth;                  ///< Open containers
+    int m_skip;                   ///< Level whose events are suppressed (0: none)
+
+    std::string m_token;   ///< String/number bytes cut by a chunk boundary or decoded
+    bool m_copying;        ///< The current string is being assembled in m_token
+    bool m_key;            ///< The current string is a key
+    int m_escape;          ///< 0, 1 after '\\', 2..5 reading \\u digits
+    unsigned m_cp;         ///< \\u code point being read
+    unsigned m_high;       ///< Pending high surrogate (0: none)
+    const char *m_literal; ///< "true", "false" or "null"
+    int m_literal_pos;     ///< Bytes of it matched
+
+    size_t m_offset;      ///< Bytes fed before the current chunk
+    const char *m_error;  ///< Why parsing failed
+    size_t m_error_at;    ///< Offset of the failure
+
+    STATUS fail(const char *what, size_t at);
+    bool quiet(int level) const { return m_skip != 0 && level >= m_skip; }
+    /**
+     * @brief Apply a callback's answer for an event at @p level
+     * @return false on STOP
+     */
+    bool act(JSON_HANDLER::ACTION a, int level);
+    void value_done(int level);
+    bool push(char c, size_t at);
+    bool close(char c, size_t at);
+    bool scalar_done();
+    bool string_done(std::string_view s);
+    bool number_done(size_t at);
+    bool escape(char c, size_t at);
+
+public:
+    explicit JSON_READER(JSON_HANDLER &handler);
+
+    /**
+     * @brief Parse the next @p len bytes
+     */
+    STATUS feed(const char *data, size_t len);
+
+    /**
+     * @brief No more input: completes a top-level number, FAILED if the document is cut
+     */
+    STATUS finish();
+
+    STATUS status() const { return m_status; }
+    const char *error() const { return m_error; }
+    size_t error_offset() const { return m_error_at; }
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <charconv>
+#include "json_value.h"
+
+void JSON_ARENA::grow(size_t n)
+{
+    size_t size = m_chunks ? m_chunks->size * 2 : FIRST_CHUNK;
+    while (size < n)
+        size *= 2;
+    CHUNK *chunk = (CHUNK *)malloc(sizeof(CHUNK) + size);
+    if (chunk == NULL)
+        throw std::bad_alloc();
+    chunk->next = m_chunks;
+    chunk->size = size;
+    m_chunks = chunk;
+    m_cur = (char *)(chunk + 1);
+    m_end = m_cur + size;
+}
+
+JSON_ARENA::~JSON_ARENA()
+{
+    while (m_chunks)
+    {
+        CHUNK *next = m_chunks->next;
+        free(m_chunks);
+        m_chunks = next;
+    }
+}
+
+const char *JSON_ARENA::copy(const char *s, size_t len)
+{
+    char *p = (char *)alloc(len + 1);
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+void JSON_ARENA::reset()
+{
+    if (m_chunks == NULL)
+        return;
+
+    // the newest chunk is the largest: keep it unless a huge body made it grow that far
+    CHUNK *keep = m_chunks->size <= KEEP_CHUNK ? m_chunks : NULL;
+    CHUNK *c = keep ? m_chunks->next : m_chunks;
+    while (c)
+    {
+        CHUNK *next = c->next;
+        free(c);
+        c = next;
+    }
+    m_chunks = keep;
+    if (keep)
+    {
+        keep->next = NULL;
+        m_cur = (char *)(keep + 1);
+        m_end = m_cur + keep->size;
+    }
+    else
+        m_cur = m_end = NULL;
+}
+
+const JSON_VALUE *JSON_VALUE::find(std::string_view key) const
+{
+    limitToObject();
+    // backwards, so that a repeated key yields its last value
+    for (size_t i = m_size; i-- > 0;)
+    {
+        const JSON_MEMBER &m = m_u.members[i];
+        if (m.key_len == key.size() && memcmp(m.key, key.data(), key.size()) == 0)
+            return &m.value;
+    }
+    return NULL;
+}
+
+JSON_VALUE JSON_VALUE::number(const char *s, size_t len)
+{
+    const char *end = s + len;
+    // "-0" stays a double: the sign would be lost as an integer
+    if (!memchr(s, '.', len) && !memchr(s, 'e', len) && !memchr(s, 'E', len) && !(len == 2 && s[0] == '-' && s[1] == '0'))
+    {
+        int64_t i;
+        if (std::from_chars(s, end, i).ec == std::errc())
+            return JSON_VALUE(i);
+    }
+    double d;
+    if (std::from_chars(s, end, d).ec == std::errc())
+        return JSON_VALUE(d);
+    // out of range: from_chars leaves d alone, strtod gives +-HUGE_VAL or 0 (needs a terminated copy)
+    return JSON_VALUE(strtod(std::string(s, len).c_str(), NULL));
+}
+
+JSONNode JSON_VALUE::to_node() const
+{
+    switch (m_type)
+    {
+    case JSONType::NUMBER:
+        return JSONNode(m_u.number);
+    case JSONType::INTEGER:
+        return JSONNode(m_u.integer);
+    case JSONType::STRING:
+        return JSONNode(std::string(m_u.string, m_size));
+    case JSONType::BOOL:
+        return JSONNode(m_u.boolean);
+    case JSONType::ARRAY:
+    {
+        JSONNode node(JSONType::ARRAY);
+        for (uint32_t i = 0; i < m_size; i++)
+            node.appendArray(m_u.items[i].to_node());
+        return node;
+    }
+    case JSONType::OBJECT:
+    {
+        JSONNode node(JSONType::OBJECT);
+        for (uint32_t i = 0; i < m_size; i++)
+        {
+            const JSON_MEMBER &m = m_u.members[i];
+            node[std::string(m.key, m.key_len)] = m.value.to_node(); // in order: the last repeated key wins
+        }
+        return node;
+    }
+    default:
+        return JSONNode();
+    }
+}
+
+void JSON_DOCUMENT::own(JSON_VALUE &v)
+{
+    // the containers were allocated writable in the arena, only JSON_VALUE exposes them const
+    switch (v.m_type)
+    {
+    case JSONType::STRING:
+        v.m_u.string = m_arena.copy(v.m_u.string, v.m_size);
+        break;
+    case JSONType::ARRAY:
+        for (uint32_t i = 0; i < v.m_size; i++)
+            own(const_cast<JSON_VALUE &>(v.m_u.items[i]));
+        break;
+    case JSONType::OBJECT:
+        for (uint32_t i = 0; i < v.m_size; i++)
+        {
+            JSON_MEMBER &m = const_cast<JSON_MEMBER &>(v.m_u.members[i]);
+            m.key = m_arena.copy(m.key, m.key_len);
+            own(m.value);
+        }
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,346 @@
+/**
+ * NOTE:
+ * Compact, read-only JSON tree, for whole documents and for the parts of a request body
+ * that JSON_LAZY_VALUE::value() materializes (JSONNode remains the mutable type for
+ * building documents):
+ * - JSON_VALUE is 16 bytes whatever its type: a tag, a size and one 8-byte payload (the
+ *   number, or a pointer to the string bytes, the array items or the object members)
+ * - numbers without fraction or exponent that fit 64 bits are INTEGERs, held exactly; the
+ *   others are doubles
+ * - arrays are contiguous JSON_VALUEs, objects contiguous JSON_MEMBERs (key + value) in
+ *   document order; lookups scan them, which beats hashing at the sizes requests have
+ * - every byte of it comes from the JSON_ARENA of its JSON_DOCUMENT, released at once by
+ *   JSON_DOCUMENT::clear() instead of node by node
+ * - strings too, except in in-situ mode: keys and strings without escapes are then views
+ *   into the parsed text (only strings with escapes are decoded into the arena)
+ * Values are valid until the document is cleared or parsed again, and in in-situ mode as
+ * long as the text; get<std::string>() or JSON_DOCUMENT::own() make copies that are not
+ * tied to it.
+ */
+
+#ifndef _JSON_VALUE_H_
+#define _JSON_VALUE_H_
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+#include "jsonparser.h"
+
+/**
+ * @class JSON_ARENA
+ * @brief Bump allocator: chunks are only freed together, by reset() or the destructor
+ */
+class JSON_ARENA
+{
+private:
+    /**
+     * @struct CHUNK
+     * @brief Header of a malloc'ed block, the usable bytes follow it
+     */
+    struct CHUNK
+    {
+        CHUNK *next;  ///< Previous (smaller) chunk
+        size_t size;  ///< Usable bytes
+    };
+
+    static const size_t FIRST_CHUNK = 4096;  ///< Size of the first chunk, then doubled
+    static const size_t KEEP_CHUNK = 65536;  ///< reset() keeps the newest chunk up to this size
+
+    CHUNK *m_chunks; ///< Newest first
+    char *m_cur;     ///< Next free byte of the newest chunk
+    char *m_end;     ///< End of the newest chunk
+
+    void grow(size_t n);
+
+public:
+    JSON_ARENA() : m_chunks(NULL), m_cur(NULL), m_end(NULL) {}
+    ~JSON_ARENA();
+    JSON_ARENA(const JSON_ARENA &) = delete;
+    JSON_ARENA &operator=(const JSON_ARENA &) = delete;
+
+    /**
+     * @brief @p n bytes, 8-byte aligned
+     */
+    void *alloc(size_t n)
+    {
+        n = (n + 7) & ~(size_t)7;
+        if ((size_t)(m_end - m_cur) < n)
+            grow(n);
+        void *p = m_cur;
+        m_cur += n;
+        return p;
+    }
+
+    /**
+     * @brief Copy of @p len bytes, NUL-terminated
+     */
+    const char *copy(const char *s, size_t len);
+
+    /**
+     * @brief Free everything at once; the newest chunk is kept for the next document
+     */
+    void reset();
+};
+
+struct JSON_MEMBER;
+
+/**
+ * @class JSON_VALUE
+ * @brief 16-byte JSON value pointing into a JSON_ARENA
+ */
+class JSON_VALUE
+{
+private:
+    JSONType m_type; ///< Type of the value
+    uint32_t m_size; ///< String bytes, array items or object members
+
+    union
+    {
+        double number;              ///< JSONType::NUMBER
+        int64_t integer;            ///< JSONType::INTEGER
+        bool boolean;               ///< JSONType::BOOL
+        const char *string;         ///< JSONType::STRING, not NUL-terminated in in-situ mode
+        const JSON_VALUE *items;    ///< JSONType::ARRAY
+        const JSON_MEMBER *members; ///< JSONType::OBJECT
+    } m_u;
+
+    /// @throws std::runtime_error if value is not an array
+    void limitToArray() const
+    {
+        if (m_type != JSONType::ARRAY)
+            throw std::runtime_error("This operation is only available to array node");
+    }
+    /// @throws std::runtime_error if value is not an object
+    void limitToObject() const
+    {
+        if (m_type != JSONType::OBJECT)
+            throw std::runtime_error("This operation is only available to object node");
+    }
+
+public:
+    /// Null value
+    JSON_VALUE() : m_type(JSONType::NULLT), m_size(0) { m_u.string = NULL; }
+
+    explicit JSON_VALUE(double value) : m_type(JSONType::NUMBER), m_size(0) { m_u.number = value; }
+
+    explicit JSON_VALUE(int64_t value) : m_type(JSONType::INTEGER), m_size(0) { m_u.integer = value; }
+
+    /**
+     * @brief Value of the number text at @p s, already validated against the JSON grammar:
+     *        an INTEGER if it has no fraction or exponent and fits int64_t, else a double
+     */
+    static JSON_VALUE number(const char *s, size_t len);
+
+    explicit JSON_VALUE(bool value) : m_type(JSONType::BOOL), m_size(0)
+    {
+        m_u.string = NULL;
+        m_u.boolean = value;
+    }
+
+    /**
+     * @brief String value, @p s must outlive it (arena copy or in-situ text)
+     */
+    JSON_VALUE(const char *s, uint32_t len) : m_type(JSONType::STRING), m_size(len) { m_u.string = s; }
+
+    /**
+     * @brief Array of @p count contiguous items
+     */
+    JSON_VALUE(const JSON_VALUE *items, uint32_t count) : m_type(JSONType::ARRAY), m_size(count) { m_u.items = items; }
+
+    /**
+     * @brief Object of @p count contiguous members
+     */
+    JSON_VALUE(const JSON_MEMBER *members, uint32_t count) : m_type(JSONType::OBJECT), m_size(count) { m_u.members = members; }
+
+    JSONType type() const { return m_type; }
+
+    /**
+     * @brief true if bool, number, string or null (same as JSONNode::isValue)
+     */
+    bool isValue() const { return m_type != JSONType::OBJECT && m_type != JSONType::ARRAY; }
+    bool isNULL() const { return m_type == JSONType::NULLT; }
+    bool isNumber() const { return m_type == JSONType::NUMBER || m_type == JSONType::INTEGER; }
+    bool isArray() const { return m_type == JSONType::ARRAY; }
+    bool isObject() const { return m_type == JSONType::OBJECT; }
+
+    /**
+     * @brief Items of an array, members of an object, bytes of a string, 0 otherwise
+     */
+    size_t size() const { return m_size; }
+
+    const JSON_VALUE *items() const
+    {
+        limitToArray();
+        return m_u.items;
+    }
+
+    const JSON_MEMBER *members() const
+    {
+        limitToObject();
+        return m_u.members;
+    }
+
+    /**
+     * @brief Array element
+     * @throws std::runtime_error if not an array, std::out_of_range if @p index is invalid
+     */
+    const JSON_VALUE &operator[](size_t index) const
+    {
+        limitToArray();
+        if (index >= m_size)
+            throw std::out_of_range("array index out of range");
+        return m_u.items[index];
+    }
+
+    const JSON_VALUE &operator[](int index) const { return (*this)[(size_t)index]; }
+
+    /**
+     * @brief Object member, the last one if the key is repeated
+     * @return NULL if there is none
+     * @throws std::runtime_error if not an object
+     */
+    const JSON_VALUE *find(std::string_view key) const;
+
+    /**
+     * @brief Object member
+     * @throws std::runtime_error if not an object, std::out_of_range if @p key is missing
+     *         (as JSONNode's const operator[])
+     */
+    const JSON_VALUE &operator[](std::string_view key) const
+    {
+        const JSON_VALUE *v = find(key);
+        if (v == NULL)
+            throw std::out_of_range("no member named " + std::string(key));
+        return *v;
+    }
+
+    const JSON_VALUE &operator[](const char *key) const { return (*this)[std::string_view(key)]; }
+    const JSON_VALUE &operator[](const std::string &key) const { return (*this)[std::string_view(key)]; }
+
+    /**
+     * @brief Value extractor, same types and errors as JSONNode::get
+     * @tparam T any integer or floating type, bool, std::string, or std::string_view (no
+     *         copy, valid as long as the document, and the text if parsed in situ)
+     */
+    template <typename T>
+    T get() const
+    {
+        switch (m_type)
+        {
+        case JSONType::STRING:
+            if constexpr (std::is_same_v<T, std::string>)
+                return std::string(m_u.string, m_size);
+            else if constexpr (std::is_same_v<T, std::string_view>)
+                return std::string_view(m_u.string, m_size);
+            else
+                throw std::runtime_error("type mismatch: requested type is not std::string");
+        case JSONType::NUMBER:
+            if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+                return json_number_cast<T>(m_u.number);
+            else
+                throw std::runtime_error("type mismatch: requested type is not a number type");
+        case JSONType::INTEGER:
+            if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+                return json_number_cast<T>(m_u.integer);
+            else
+                throw std::runtime_error("type mismatch: requested type is not a number type");
+        case JSONType::BOOL:
+            if constexpr (std::is_same_v<T, bool>)
+                return m_u.boolean;
+            else
+                throw std::runtime_error("type mismatch: requested type is not bool");
+        case JSONType::NULLT:
+            throw std::runtime_error("cannot get value from null node");
+        default:
+            throw std::runtime_error("unable to get value for this type");
+        }
+    }
+
+    /**
+     * @brief Deep copy into a mutable JSONNode tree
+     */
+    JSONNode to_node() const;
+
+    friend class JSON_DOCUMENT; // own() repoints strings
+};
+
+/**
+ * @struct JSON_MEMBER
+ * @brief Key/value pair of an object
+ */
+struct JSON_MEMBER
+{
+    const char *key;  ///< Key bytes (arena)
+    uint32_t key_len; ///< Key length
+    JSON_VALUE value; ///< Value
+
+    std::string_view name() const { return std::string_view(key, key_len); }
+};
+
+static_assert(sizeof(JSON_VALUE) == 16, "JSON_VALUE must stay 16 bytes");
+
+/**
+ * @class JSON_DOCUMENT
+ * @brief A parsed JSON text: its arena and its root value
+ */
+class JSON_DOCUMENT
+{
+private:
+    JSON_ARENA m_arena; ///< Every node and string of the document
+    JSON_VALUE m_root;  ///< null until parse() succeeds
+    bool m_views;       ///< Some strings point into the parsed text (in-situ parse)
+
+    /**
+     * @brief Copy the strings of @p v and below into the arena
+     */
+    void own(JSON_VALUE &v);
+
+public:
+    JSON_DOCUMENT() : m_views(false) {}
+    JSON_DOCUMENT(const JSON_DOCUMENT &) = delete;
+    JSON_DOCUMENT &operator=(const JSON_DOCUMENT &) = delete;
+
+    /**
+     * @brief Parse @p len bytes at @p data, replacing the previous document
+     * @param in_situ Keys and escape-free strings point into @p data instead of being copied:
+     *        @p data must then stay unchanged for as long as the document is used
+     * @throws std::runtime_error on parse errors (same messages as JSONNode::parse), the
+     *         document is then empty
+     */
+    void parse(const char *data, size_t len, bool in_situ = false);
+
+    /**
+     * @brief Copy every string still pointing into the parsed text into the arena, so the
+     *        document no longer depends on it (no-op unless parsed in situ)
+     */
+    void own()
+    {
+        if (m_views)
+            own(m_root);
+        m_views = false;
+    }
+
+    /**
+     * @brief Drop the document, all of its memory in one step
+     */
+    void clear()
+    {
+        m_arena.reset();
+        m_root = JSON_VALUE();
+        m_views = false;
+    }
+
+    const JSON_VALUE &root() const { return m_root; }
+    JSON_ARENA &arena() { return m_arena; }
+
+    /* Shortcuts to the root, so handlers write req.m_body["key"] */
+    bool isNULL() const { return m_root.isNULL(); }
+    const JSON_VALUE &operator[](std::string_view key) const { return m_root[key]; }
+    const JSON_VALUE &operator[](const char *key) const { return m_root[key]; }
+    const JSON_VALUE &operator[](const std::string &key) const { return m_root[key]; }
+    const JSON_VALUE &operator[](int index) const { return m_root[index]; }
+};
+
+#endif
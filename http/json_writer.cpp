@@ -0,0 +1,167 @@
+#include <math.h>
+#include <charconv>
+#include "json_writer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief First byte of [@p p, @p end) that must be escaped: '"', '\\' or below 0x20
+ */
+static inline const char *find_escape(const char *p, const char *end)
+{
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1F);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl)); // v <= 0x1F
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end; p++)
+        if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20)
+            return p;
+    return end;
+}
+
+void JSON_WRITER::quote(std::string &out, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.reserve(out.size() + s.size() + 2);
+    out += '"';
+    const char *p = s.data(), *end = p + s.size();
+    while (true)
+    {
+        const char *e = find_escape(p, end);
+        out.append(p, e - p);
+        if (e == end)
+            break;
+        switch (*e)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+        {
+            char u[] = {'\\', 'u', '0', '0', hex[(unsigned char)*e >> 4], hex[*e & 0xF]};
+            out.append(u, sizeof(u));
+            break;
+        }
+        }
+        p = e + 1;
+    }
+    out += '"';
+}
+
+void JSON_WRITER::format(std::string &out, double d)
+{
+    if (!isfinite(d))
+    {
+        out += "null";
+        return;
+    }
+    char buf[32];
+    std::to_chars_result r;
+    // integral values (ids, counts...) are the common case and print faster as integers;
+    // not -0, which would lose its sign
+    if (d >= -1e15 && d <= 1e15 && d == (double)(int64_t)d && !(d == 0 && signbit(d)))
+        r = std::to_chars(buf, buf + sizeof(buf), (int64_t)d);
+    else
+        r = std::to_chars(buf, buf + sizeof(buf), d);
+    out.append(buf, r.ptr - buf);
+}
+
+JSON_WRITER &JSON_WRITER::integer(int64_t i)
+{
+    separate();
+    char buf[24];
+    std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), i);
+    m_out.append(buf, r.ptr - buf);
+    m_comma = true;
+    return *this;
+}
+
+JSON_WRITER &JSON_WRITER::value(const JSONNode &node)
+{
+    switch (node.d_type)
+    {
+    case JSONType::BOOL:
+        return boolean(node.d_value.d_bool);
+    case JSONType::NUMBER:
+        return number(node.d_value.d_number);
+    case JSONType::INTEGER:
+        return integer(node.d_value.d_integer);
+    case JSONType::STRING:
+        return string(node.d_value.d_string);
+    case JSONType::ARRAY:
+        start_array();
+        for (const JSONNode &item : node.d_array)
+            value(item);
+        return end_array();
+    case JSONType::OBJECT:
+        start_object();
+        for (const auto &member : node.d_data)
+        {
+            key(member.first);
+            value(member.second);
+        }
+        return end_object();
+    default:
+        return null();
+    }
+}
+
+JSON_WRITER &JSON_WRITER::value(const JSON_VALUE &v)
+{
+    switch (v.type())
+    {
+    case JSONType::BOOL:
+        return boolean(v.get<bool>());
+    case JSONType::NUMBER:
+        return number(v.get<double>());
+    case JSONType::INTEGER:
+        return integer(v.get<int64_t>());
+    case JSONType::STRING:
+        return string(v.get<std::string_view>());
+    case JSONType::ARRAY:
+        start_array();
+        for (size_t i = 0; i < v.size(); i++)
+            value(v.items()[i]);
+        return end_array();
+    case JSONType::OBJECT:
+        start_object();
+        for (size_t i = 0; i < v.size(); i++)
+        {
+            key(v.members()[i].name());
+            value(v.members()[i].value);
+        }
+        return end_object();
+    default:
+        return null();
+    }
+}
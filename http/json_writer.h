@@ -0,0 +1,149 @@
+/**
+ * NOTE:
+ * JSON serializer appending to a std::string, normally the body buffer of a response
+ * (HttpResponse::json()), so nothing is built twice:
+ *
+ *   JSON_WRITER w(out);
+ *   w.start_object().key("id").integer(42).key("name").string(name).end_object();
+ *   w.value(node);            // or a whole JSONNode / JSON_VALUE / JSON_LAZY_VALUE
+ *
+ * Commas are inserted by the writer; keys and strings are escaped (quote, backslash and
+ * control characters), runs that need no escape being found 16 bytes at a time and copied
+ * at once. Numbers use the shortest text that reads back to the same double (to_chars),
+ * integral values the integer formatter; NaN and infinities, which JSON cannot represent,
+ * are written as null. The writer does not check that calls are balanced.
+ */
+
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+#include "jsonparser.h"
+#include "json_value.h"
+#include "json_lazy.h"
+
+/**
+ * @class JSON_WRITER
+ * @brief Appends JSON text to a string
+ */
+class JSON_WRITER
+{
+private:
+    std::string &m_out; ///< Destination, appended to
+    bool m_comma;       ///< A value was just written: the next key/value needs a ','
+
+    void separate()
+    {
+        if (m_comma)
+            m_out += ',';
+    }
+
+public:
+    explicit JSON_WRITER(std::string &out) : m_out(out), m_comma(false) {}
+
+    JSON_WRITER &start_object()
+    {
+        separate();
+        m_out += '{';
+        m_comma = false;
+        return *this;
+    }
+
+    JSON_WRITER &end_object()
+    {
+        m_out += '}';
+        m_comma = true;
+        return *this;
+    }
+
+    JSON_WRITER &start_array()
+    {
+        separate();
+        m_out += '[';
+        m_comma = false;
+        return *this;
+    }
+
+    JSON_WRITER &end_array()
+    {
+        m_out += ']';
+        m_comma = true;
+        return *this;
+    }
+
+    /**
+     * @brief Member key, its value is the next thing written
+     */
+    JSON_WRITER &key(std::string_view k)
+    {
+        separate();
+        quote(m_out, k);
+        m_out += ':';
+        m_comma = false;
+        return *this;
+    }
+
+    JSON_WRITER &string(std::string_view s)
+    {
+        separate();
+        quote(m_out, s);
+        m_comma = true;
+        return *this;
+    }
+
+    JSON_WRITER &number(double d)
+    {
+        separate();
+        format(m_out, d);
+        m_comma = true;
+        return *this;
+    }
+
+    JSON_WRITER &integer(int64_t i);
+
+    JSON_WRITER &boolean(bool b)
+    {
+        separate();
+        m_out += b ? "true" : "false";
+        m_comma = true;
+        return *this;
+    }
+
+    JSON_WRITER &null()
+    {
+        separate();
+        m_out += "null";
+        m_comma = true;
+        return *this;
+    }
+
+    /* Whole values */
+    JSON_WRITER &value(const JSONNode &node);
+    JSON_WRITER &value(const JSON_VALUE &v);
+
+    /**
+     * @brief The text of a request body value, copied as is (it was validated)
+     */
+    JSON_WRITER &value(const JSON_LAZY_VALUE &v)
+    {
+        separate();
+        m_out += v.text();
+        m_comma = true;
+        return *this;
+    }
+
+    /**
+     * @brief Append @p s quoted and escaped
+     */
+    static void quote(std::string &out, std::string_view s);
+
+    /**
+     * @brief Append the shortest round-trip text of @p d (null if not finite)
+     */
+    static void format(std::string &out, double d);
+};
+
+#endif
@@ -1,277 +1,690 @@
 #include "jsonparser.h"
+#include "json_index.h"
+#include "json_value.h"
+#include "json_lazy.h"
+#include "json_writer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <vector>
 
 /**
- * @brief Finds matching pairs of opening and closing braces in a given string.
+ * @struct JSON_BUILDER
+ * @brief Where the parsers put the tree
  *
- * @param s The input string containing braces.
- * @param bracePairs A reference to an unordered_map that stores
- *                   matched brace pairs (opening index -> closing index).
+ * Containers are built bottom-up: the items/members of the containers being parsed wait on
+ * the scratch stacks (innermost last) and are copied into the arena, contiguous, once the
+ * closing bracket is seen. The stacks are per thread and keep their capacity.
  */
-void findBarcePairs(const std::string &s, std::unordered_map<int, int> &bracePairs)
+struct JSON_BUILDER
 {
-    std::vector<int> stack;
-    int n = s.length();
-    for (int i = 0; i < n; i++)
+    JSON_ARENA *arena;                ///< Arena of the document being parsed
+    std::vector<JSON_VALUE> items;    ///< Items of the open arrays
+    std::vector<JSON_MEMBER> members; ///< Members of the open objects
+    std::string text;                 ///< Decoded string with escapes
+    bool in_situ;                     ///< Strings without escapes point into the input
+
+    /**
+     * @brief String value for the raw (escape-free) bytes at @p s, which are in the input
+     */
+    JSON_VALUE string(const char *s, size_t len)
+    {
+        return JSON_VALUE(in_situ ? s : arena->copy(s, len), len);
+    }
+
+    /**
+     * @brief String value for decoded bytes (m_b.text), always copied
+     */
+    JSON_VALUE decoded(const std::string &s)
+    {
+        return JSON_VALUE(arena->copy(s.data(), s.size()), s.size());
+    }
+
+    /**
+     * @brief Close the array whose first item is items[@p base]
+     */
+    JSON_VALUE array(size_t base)
     {
-        if (s[i] == '[' || s[i] == '{')
+        size_t n = items.size() - base;
+        JSON_VALUE *p = NULL;
+        if (n)
         {
-            stack.push_back(i);
+            p = (JSON_VALUE *)arena->alloc(n * sizeof(JSON_VALUE));
+            memcpy((void *)p, items.data() + base, n * sizeof(JSON_VALUE));
+            items.resize(base);
         }
-        else if (s[i] == ']' || s[i] == '}')
+        return JSON_VALUE(p, n);
+    }
+
+    /**
+     * @brief Close the object whose first member is members[@p base]
+     */
+    JSON_VALUE object(size_t base)
+    {
+        size_t n = members.size() - base;
+        JSON_MEMBER *p = NULL;
+        if (n)
         {
-            bracePairs[stack.back()] = i;
-            stack.pop_back();
+            p = (JSON_MEMBER *)arena->alloc(n * sizeof(JSON_MEMBER));
+            memcpy((void *)p, members.data() + base, n * sizeof(JSON_MEMBER));
+            members.resize(base);
         }
+        return JSON_VALUE(p, n);
     }
-}
+};
 
 /**
- * @brief Checks if a given character is a whitespace character.
+ * @class JSON_PARSER
+ * @brief Single-pass recursive-descent parser behind JSON_DOCUMENT::parse
  *
- * @param c The character to check.
- * @return true if c is a whitespace character, false otherwise.
- */
-bool isWhiteSpace(char c)
-{
-    return c == ' ' || c == '\n';
-}
-
-/**
- * @brief Checks if a given string represents a valid floating-point number (double).
+ * Each byte is looked at once: values are recognized by their first character, strings are
+ * scanned up to the next quote/backslash and copied as one run, numbers are validated
+ * against the JSON grammar and converted where they lie.
  *
- * @param s The input string to check.
- * @return true if the string represents a valid double, false otherwise.
+ * @tparam BUILD false only validates (JSON_LAZY::parse): same grammar and errors, but no
+ *         value is converted, copied or stored (only strings with escapes use m_b.text)
  */
-bool isDouble(const std::string &s)
+template <bool BUILD>
+class JSON_PARSER
 {
-    int i = 0;
-    if (s[0] == '+' || s[0] == '-')
-        i++;
+private:
+    const char *m_begin; ///< Start of the input, for error offsets
+    const char *m_p;     ///< Next byte
+    const char *m_end;   ///< End of the input
+    int m_depth;         ///< Current nesting
+    JSON_BUILDER &m_b;   ///< Output
+
+    [[noreturn]] void fail(const char *what) const
+    {
+        throw std::runtime_error("JSON parse error at offset " + std::to_string(m_p - m_begin) + ": " + what);
+    }
 
-    bool dotseen = 0;
+    void skip_whitespace()
+    {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\n' || *m_p == '\r' || *m_p == '\t'))
+            m_p++;
+    }
 
-    while (i < s.length())
+    void expect(char c, const char *what)
     {
-        // if charctot is not number and not . then return false
-        if (!std::isdigit(s[i]) && s[i] != '.')
-            return false;
+        if (m_p >= m_end || *m_p != c)
+            fail(what);
+        m_p++;
+    }
 
-        if (s[i] == '.')
-        {
-            // if dot is already seen return false
-            if (dotseen)
-                return false;
-            dotseen = true;
-        }
-        i++;
+    void literal(const char *word, size_t len)
+    {
+        if ((size_t)(m_end - m_p) < len || memcmp(m_p, word, len) != 0)
+            fail("invalid literal");
+        m_p += len;
     }
-    return true;
-}
 
-bool isInteger(const std::string &s)
-{
-    int i = 0;
-    if (s[0] == '+' || s[0] == '-')
-        i++;
+    void enter()
+    {
+        if (++m_depth > JSON_MAX_DEPTH)
+            fail("nesting too deep");
+    }
 
-    while (i < s.length())
+    unsigned hex4()
     {
-        if (!std::isdigit(s[i]))
-            return false;
-        i++;
+        if (m_end - m_p < 4)
+            fail("truncated \\u escape");
+        unsigned cp = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = *m_p++;
+            cp <<= 4;
+            if (c >= '0' && c <= '9')
+                cp |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                cp |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                cp |= c - 'A' + 10;
+            else
+                fail("invalid \\u escape");
+        }
+        return cp;
     }
-    return true;
-}
 
-JSONNode getValue(const std::string &s)
-{
-    int i = 0, j = s.length() - 1;
+    /**
+     * @brief Decode the code point of a \\u escape (m_p after the 'u') and append it as UTF-8
+     */
+    void unicode(std::string &out)
+    {
+        unsigned cp = hex4();
+        if (cp >= 0xD800 && cp <= 0xDBFF) // high surrogate, a low one must follow
+        {
+            if (m_end - m_p < 2 || m_p[0] != '\\' || m_p[1] != 'u')
+                fail("unpaired surrogate");
+            m_p += 2;
+            unsigned low = hex4();
+            if (low < 0xDC00 || low > 0xDFFF)
+                fail("unpaired surrogate");
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        else if (cp >= 0xDC00 && cp <= 0xDFFF)
+            fail("unpaired surrogate");
 
-    while (isWhiteSpace(s[i])) // remove whitespace from front of value string
-        i++;
-    while (isWhiteSpace(s[j])) // remove whitespace from back of value string
-        j--;
-    std::string temp = s.substr(i, j - i + 1); // find the valid string without whitespaces.
+        if (cp < 0x80)
+            out += (char)cp;
+        else if (cp < 0x800)
+        {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
 
-    if (temp[0] == '"')
-        // we ignore first position and last position "dhhd"->dhhd. here we create string constructor
-        return (JSONNode(temp.substr(1, temp.length() - 2)));
+    /**
+     * @brief Decode the rest of a string into @p out, m_p is past its opening quote
+     */
+    void unescape(std::string &out)
+    {
+        const char *run = m_p;
+        while (true)
+        {
+            // everything up to the next quote, backslash or control character is copied at once
+            while (m_p < m_end && *m_p != '"' && *m_p != '\\' && (unsigned char)*m_p >= 0x20)
+                m_p++;
+            if (m_p >= m_end)
+                fail("unterminated string");
+            out.append(run, m_p - run);
+
+            if (*m_p == '"')
+            {
+                m_p++;
+                return;
+            }
+            if (*m_p != '\\')
+                fail("control character in string");
+            if (++m_p >= m_end)
+                fail("unterminated string");
+            switch (*m_p++)
+            {
+            case '"':
+                out += '"';
+                break;
+            case '\\':
+                out += '\\';
+                break;
+            case '/':
+                out += '/';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+                unicode(out);
+                break;
+            default:
+                m_p--;
+                fail("invalid escape");
+            }
+            run = m_p;
+        }
+    }
 
-    // check if the value is boolean type use boolean constructoe
-    if (temp == "true" || temp == "false")
-        return JSONNode(temp == "true");
+    /**
+     * @brief Parse the string at m_p (on its opening quote) into the arena
+     */
+    JSON_VALUE string()
+    {
+        const char *start = ++m_p;
+        while (m_p < m_end && *m_p != '"' && *m_p != '\\' && (unsigned char)*m_p >= 0x20)
+            m_p++;
+        if (m_p < m_end && *m_p == '"') // no escape: one copy
+        {
+            m_p++;
+            if constexpr (BUILD)
+                return m_b.string(start, m_p - 1 - start);
+            return JSON_VALUE();
+        }
+        m_b.text.assign(start, m_p - start);
+        unescape(m_b.text);
+        if constexpr (BUILD)
+            return m_b.decoded(m_b.text);
+        return JSON_VALUE();
+    }
 
-    // check if the value is null type use null constructoe
-    if (temp == "null")
-        return JSONNode();
+    JSON_VALUE number()
+    {
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        const char *start = m_p;
+        bool negative = *m_p == '-';
+        if (negative)
+            m_p++;
+        const char *digits = m_p;
+        uint64_t mantissa = 0; // the integer part, exact up to 19 digits
+        if (m_p < m_end && *m_p == '0')
+            m_p++;
+        else if (m_p < m_end && *m_p >= '1' && *m_p <= '9')
+            while (m_p < m_end && isdigit((unsigned char)*m_p))
+                mantissa = mantissa * 10 + (*m_p++ - '0');
+        else
+            fail("invalid number");
+        bool integral = m_p == m_end || (*m_p != '.' && *m_p != 'e' && *m_p != 'E');
+        if constexpr (BUILD)
+        {
+            // common case, decided in this scan: up to 18 digits always fit int64_t
+            if (integral && m_p - digits <= 18 && (mantissa != 0 || !negative))
+                return JSON_VALUE(negative ? -(int64_t)mantissa : (int64_t)mantissa);
+        }
+        if (m_p < m_end && *m_p == '.')
+        {
+            m_p++;
+            if (m_p >= m_end || !isdigit((unsigned char)*m_p))
+                fail("invalid number");
+            while (m_p < m_end && isdigit((unsigned char)*m_p))
+                m_p++;
+        }
+        if (m_p < m_end && (*m_p == 'e' || *m_p == 'E'))
+        {
+            m_p++;
+            if (m_p < m_end && (*m_p == '+' || *m_p == '-'))
+                m_p++;
+            if (m_p >= m_end || !isdigit((unsigned char)*m_p))
+                fail("invalid number");
+            while (m_p < m_end && isdigit((unsigned char)*m_p))
+                m_p++;
+        }
+        if constexpr (!BUILD)
+            return JSON_VALUE();
+        // fraction, exponent or 19+ digits: from_chars reads the span in place
+        return JSON_VALUE::number(start, m_p - start);
+    }
 
-    // check if the value is double or float type use double constructor
-    if (isDouble(temp))
-        return JSONNode(std::stod(temp));
+    JSON_VALUE object()
+    {
+        enter();
+        m_p++; // '{'
+        size_t base = m_b.members.size();
+        skip_whitespace();
+        if (m_p < m_end && *m_p == '}')
+        {
+            m_p++;
+            m_depth--;
+            return m_b.object(base);
+        }
 
-    // check if the value is int type use int constructor
-    if (isInteger(temp))
-        return JSONNode(std::stoi(temp));
+        while (true)
+        {
+            skip_whitespace();
+            if (m_p >= m_end || *m_p != '"')
+                fail("expected string key");
+            JSON_VALUE key = string();
+            skip_whitespace();
+            expect(':', "expected ':' after key");
+            skip_whitespace();
+            JSON_VALUE v = value();
+            if constexpr (BUILD)
+            {
+                std::string_view k = key.get<std::string_view>();
+                m_b.members.push_back(JSON_MEMBER{k.data(), (uint32_t)k.size(), v});
+            }
+            skip_whitespace();
+            if (m_p < m_end && *m_p == ',')
+            {
+                m_p++;
+                continue;
+            }
+            expect('}', "expected ',' or '}'");
+            break;
+        }
+        m_depth--;
+        return m_b.object(base);
+    }
 
-    return JSONNode(temp);
-}
+    JSON_VALUE array()
+    {
+        enter();
+        m_p++; // '['
+        size_t base = m_b.items.size();
+        skip_whitespace();
+        if (m_p < m_end && *m_p == ']')
+        {
+            m_p++;
+            m_depth--;
+            return m_b.array(base);
+        }
 
-JSONNode JSONNode::parse(const std::string &s)
-{
-    std::unordered_map<int, int> bracePairs;
-    findBarcePairs(s, bracePairs); // find all braces { and [ from string s
+        while (true)
+        {
+            skip_whitespace();
+            JSON_VALUE v = value();
+            if constexpr (BUILD)
+                m_b.items.push_back(v);
+            skip_whitespace();
+            if (m_p < m_end && *m_p == ',')
+            {
+                m_p++;
+                continue;
+            }
+            expect(']', "expected ',' or ']'");
+            break;
+        }
+        m_depth--;
+        return m_b.array(base);
+    }
 
-    int i = 0;
+    JSON_VALUE value()
+    {
+        if (m_p >= m_end)
+            fail("expected a value");
+        switch (*m_p)
+        {
+        case '{':
+            return object();
+        case '[':
+            return array();
+        case '"':
+            return string();
+        case 't':
+            literal("true", 4);
+            return JSON_VALUE(true);
+        case 'f':
+            literal("false", 5);
+            return JSON_VALUE(false);
+        case 'n':
+            literal("null", 4);
+            return JSON_VALUE();
+        default:
+            if (*m_p == '-' || isdigit((unsigned char)*m_p))
+                return number();
+            fail("unexpected character");
+        }
+    }
 
-    while (isWhiteSpace(s[i])) // remove whitespaces
-        i++;
+public:
+    JSON_PARSER(const char *data, size_t len, JSON_BUILDER &b) : m_begin(data), m_p(data), m_end(data + len), m_depth(0), m_b(b) {}
 
-    // start will be current i and end can be find from bracePairs[i]
-    if (s[i] == '[')
-        return parseArray(s, i, bracePairs[i], bracePairs);
+    /**
+     * @brief Parser for [@p p, @p end), a slice of the document starting at @p begin
+     * @note Used by stage 2 of the indexed parser for single strings and scalars
+     */
+    JSON_PARSER(const char *begin, const char *p, const char *end, JSON_BUILDER &b) : m_begin(begin), m_p(p), m_end(end), m_depth(0), m_b(b) {}
 
-    return parseObject(s, i, bracePairs[i], bracePairs);
-}
+    /**
+     * @brief Parse the whole input as one JSON value
+     */
+    JSON_VALUE document()
+    {
+        skip_whitespace();
+        JSON_VALUE root = value();
+        skip_whitespace();
+        if (m_p != m_end)
+            fail("trailing characters after the document");
+        return root;
+    }
+};
 
-JSONNode parseObject(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair)
+/**
+ * @class JSON_INDEXED_VALIDATOR
+ * @brief Stage 2 of the indexed parser, behind JSON_LAZY::parse for large bodies: checks
+ *        the grammar from the positions of JSON_INDEX
+ *
+ * Only structural positions are visited: the contents of a string were already checked by
+ * stage 1 and are skipped at once unless they hold a backslash; a number or literal is the
+ * span up to the next position. The leaves that need a closer look go through
+ * JSON_PARSER<false> on their slice, so both paths accept exactly the same texts.
+ */
+class JSON_INDEXED_VALIDATOR
 {
-    int i = start;
-    JSONNode ans(JSONType::OBJECT);
+private:
+    const char *m_data;    ///< The document
+    size_t m_len;          ///< Its length
+    const uint32_t *m_pos; ///< Structural positions
+    size_t m_count;        ///< Number of positions
+    size_t m_i;            ///< Next position
+    int m_depth;           ///< Current nesting
+    JSON_BUILDER &m_b;     ///< Scratch for the escapes of JSON_PARSER<false>
+
+    [[noreturn]] void fail(const char *what, size_t offset) const
+    {
+        throw std::runtime_error("JSON parse error at offset " + std::to_string(offset) + ": " + what);
+    }
+
+    /**
+     * @brief Byte at the next position, '\0' past the last one
+     */
+    char peek() const
+    {
+        return m_i < m_count ? m_data[m_pos[m_i]] : '\0';
+    }
 
-    while (i < end)
+    size_t offset() const
     {
-        // Skip non-quote characters (with bounds check)
-        while (i < end && s[i] != '"')
-            i++;
-        if (i >= end)
-            break; // Exit if no more keys
+        return m_i < m_count ? m_pos[m_i] : m_len;
+    }
 
-        i++; // Move past opening '"'
+    void enter(size_t open)
+    {
+        if (++m_depth > JSON_MAX_DEPTH)
+            fail("nesting too deep", open);
+    }
+
+    /**
+     * @brief The string whose opening quote is the next position
+     */
+    void string()
+    {
+        size_t open = m_pos[m_i++];
+        size_t close = m_pos[m_i++]; // stage 1 guarantees quotes come in pairs
+        if (memchr(m_data + open + 1, '\\', close - open - 1) != NULL)
+            JSON_PARSER<false>(m_data, m_data + open, m_data + close + 1, m_b).document();
+    }
 
-        std::string key;
-        // Extract key (with bounds check)
-        while (i < end && s[i] != '"')
+    void object(size_t open)
+    {
+        enter(open);
+        if (peek() == '}')
         {
-            key += s[i];
-            i++;
+            m_i++;
+            m_depth--;
+            return;
         }
-        if (i >= end)
-            throw std::runtime_error("Unterminated key");
-        i++; // Move past closing '"'
-
-        // Find colon
-        while (i < end && s[i] != ':')
-            i++;
-        if (i >= end)
-            throw std::runtime_error("Expected ':' after key");
-        i++; // Skip ':'
-
-        // Skip whitespace after colon
-        while (i < end && isWhiteSpace(s[i]))
-            i++;
-        if (i >= end)
-            throw std::runtime_error("Expected value after ':'");
-
-        // Parse value
-        std::string value;
-        if (s[i] == '{')
+
+        while (true)
         {
-            ans[key] = parseObject(s, i, bracePair[i], bracePair);
-            i = bracePair[i] + 1;
+            if (peek() != '"')
+                fail("expected string key", offset());
+            string();
+            if (peek() != ':')
+                fail("expected ':' after key", offset());
+            m_i++;
+            value();
+            char c = peek();
+            m_i++;
+            if (c == ',')
+                continue;
+            if (c != '}')
+                fail("expected ',' or '}'", m_i - 1 < m_count ? m_pos[m_i - 1] : m_len);
+            break;
         }
-        else if (s[i] == '[')
+        m_depth--;
+    }
+
+    void array(size_t open)
+    {
+        enter(open);
+        if (peek() == ']')
         {
-            ans[key] = parseArray(s, i, bracePair[i], bracePair);
-            i = bracePair[i] + 1;
+            m_i++;
+            m_depth--;
+            return;
         }
-        else
+
+        while (true)
         {
-            while (i < end && s[i] != ',' && s[i] != '}')
-            {
-                value += s[i];
-                i++;
-            }
-            ans[key] = getValue(value);
+            value();
+            char c = peek();
+            m_i++;
+            if (c == ',')
+                continue;
+            if (c != ']')
+                fail("expected ',' or ']'", m_i - 1 < m_count ? m_pos[m_i - 1] : m_len);
+            break;
         }
-
-        // Skip comma
-        if (i < end && s[i] == ',')
-            i++;
+        m_depth--;
     }
-    return ans;
-}
 
-JSONNode parseArray(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair)
-{
-    int i = start;
-    JSONNode ans(JSONType::ARRAY); // when array automatically activate d_array
-    i++;
-
-    while (i < end)
+    void value()
     {
-        while (isWhiteSpace(s[i]))
-            i++;
-
-        std::string value = "";
-        // stop when you see a comma or reach end of the array.
-        while (i < end && s[i] != ',')
+        if (m_i >= m_count)
+            fail("expected a value", m_len);
+        size_t pos = m_pos[m_i];
+        switch (m_data[pos])
         {
-            value += s[i];
-            i++;
+        case '{':
+            m_i++;
+            return object(pos);
+        case '[':
+            m_i++;
+            return array(pos);
+        case '"':
+            return string();
+        case '}':
+        case ']':
+        case ':':
+        case ',':
+            fail("expected a value", pos);
+        default:
+            // number or literal: everything up to the next position, whitespace included
+            m_i++;
+            JSON_PARSER<false>(m_data, m_data + pos, m_data + offset(), m_b).document();
         }
-        i++;
-        ans.appendArray(getValue(value));
     }
-    return ans;
-}
 
-std::string JSONNode::stringify(const JSONNode &node)
+public:
+    JSON_INDEXED_VALIDATOR(const char *data, size_t len, const JSON_INDEX &index, JSON_BUILDER &b)
+        : m_data(data), m_len(len), m_pos(index.positions()), m_count(index.count()), m_i(0), m_depth(0), m_b(b) {}
+
+    /**
+     * @brief Check the whole input as one JSON value
+     */
+    void document()
+    {
+        value();
+        if (m_i != m_count)
+            fail("trailing characters after the document", m_pos[m_i]);
+    }
+};
+
+/**
+ * @brief Whether JSON_LAZY::parse should validate @p data through the index: a large text
+ *        whose head is sparse in structure (see JSON_INDEX_MIN_BYTES)
+ */
+static bool worth_indexing(const char *data, size_t len)
 {
-    switch (node.d_type)
+    if (len < JSON_INDEX_MIN_BYTES || len > UINT32_MAX)
+        return false;
+    size_t ops = 0;
+    for (size_t i = 0; i < JSON_INDEX_SAMPLE; i++)
     {
-    case JSONType::BOOL:
-        return node.d_value.d_bool ? "true" : "false";
+        char c = data[i];
+        ops += c == '"' || c == ':' || c == ',' || c == '{' || c == '}' || c == '[' || c == ']';
+    }
+    return ops * JSON_INDEX_SPARSE <= JSON_INDEX_SAMPLE;
+}
 
-    case JSONType::NULLT:
-        return "null";
+/**
+ * @brief The builder of this thread, set up for a new parse
+ */
+static JSON_BUILDER &local_builder(JSON_ARENA *arena, bool in_situ)
+{
+    static thread_local JSON_BUILDER builder; // scratch stacks kept between requests of a worker
+    builder.arena = arena;
+    builder.in_situ = in_situ;
+    builder.items.clear(); // a failed parse may have left entries
+    builder.members.clear();
+    return builder;
+}
 
-    case JSONType::NUMBER:
-        return std::to_string(node.d_value.d_number);
+void JSON_DOCUMENT::parse(const char *data, size_t len, bool in_situ)
+{
+    clear();
+    m_views = in_situ;
 
-    case JSONType::STRING:
+    try
     {
-        std::string ans = "\"";
-        ans += node.d_value.d_string;
-        ans += '"';
-        return ans;
+        JSON_PARSER<true> parser(data, len, local_builder(&m_arena, in_situ));
+        m_root = parser.document();
     }
-
-    case JSONType::ARRAY:
+    catch (...)
     {
-        std::string ans = "[";
-        for (auto v : node.d_array)
-        {
-            ans += stringify(v); // recusively stringify again
-            ans += ',';
-        }
-        ans[ans.length() - 1] = ']'; // add last charactor as ]
-        return ans;
+        clear();
+        throw;
     }
+}
 
-    case JSONType::OBJECT:
+void JSON_LAZY::parse(const char *data, size_t len, VALIDATOR validator, JSON_INDEX::KERNEL kernel)
+{
+    clear();
+    JSON_BUILDER &builder = local_builder(NULL, true);
+    bool indexed = validator == AUTO ? worth_indexing(data, len) : validator == INDEXED && len <= UINT32_MAX;
+    if (!indexed)
+        JSON_PARSER<false>(data, len, builder).document();
+    else
     {
-        std::string ans = "{";
-        for (auto &k : node.d_data)
-        {
-            ans += '"';
-            ans += k.first;
-            ans += '"';
-            ans += ':';
-            ans += stringify(k.second); // recursively stringify again
-            ans += ',';
-        }
-        ans[ans.length() - 1] = '}'; // add last charactor as }
-        return ans;
-    }
+        static thread_local JSON_INDEX index; // keeps its buffer too
+        if (!index.build(data, len, kernel))
+            throw std::runtime_error("JSON parse error at offset " + std::to_string(index.error_offset()) + ": " + index.error());
+        JSON_INDEXED_VALIDATOR(data, len, index, builder).document();
     }
-}
\ No newline at end of file
+
+    const char *begin = data, *end = data + len;
+    while (*begin == ' ' || *begin == '\t' || *begin == '\n' || *begin == '\r')
+        begin++;
+    while (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')
+        end--;
+    m_root = JSON_LAZY_VALUE(begin, end, &m_arena);
+}
+
+JSON_VALUE JSON_LAZY_VALUE::value() const
+{
+    // the span is valid: this only converts (and decodes escaped strings into the arena)
+    return JSON_PARSER<true>(m_begin, m_end - m_begin, local_builder(m_arena, true)).document();
+}
+
+JSONNode JSONNode::parse(const std::string &s)
+{
+    return parse(s.c_str(), s.size());
+}
+
+JSONNode JSONNode::parse(const char *data, size_t len)
+{
+    JSON_DOCUMENT doc;
+    doc.parse(data, len);
+    return doc.root().to_node();
+}
+
+std::string JSONNode::stringify(const JSONNode &node)
+{
+    std::string out;
+    JSON_WRITER(out).value(node);
+    return out;
+}
@@ -7,6 +7,13 @@
 #include <string>
 #include <new>     // For placement new
 #include <cstddef> // For nullptr_t
+#include <cstdint>
+#include <type_traits>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+
+static const int JSON_MAX_DEPTH = 512; ///< Deepest nesting accepted by JSONNode::parse
 
 /**
  * @enum JSONType
@@ -16,14 +23,48 @@
  */
 enum class JSONType : short
 {
-    NUMBER, ///< JSON number (e.g., 123, 4.56)
+    NUMBER, ///< JSON number held as a double (e.g., 4.56, 1e3)
     STRING, ///< JSON string (e.g., "hello")
     BOOL,   ///< JSON boolean (true/false)
     NULLT,  ///< JSON null value
     OBJECT, ///< JSON object (unordered key-value pairs)
-    ARRAY   ///< JSON array (ordered list of values)
+    ARRAY,  ///< JSON array (ordered list of values)
+    INTEGER ///< JSON number without fraction or exponent that fits 64 bits, held exactly (e.g., 123)
 };
 
+/* get<T>() conversions of a number: an integral T must hold the value, the cast would
+   otherwise wrap (4294967296 to 0 in an int) or be undefined (1e300 into an int) */
+template <typename T>
+T json_number_cast(int64_t i)
+{
+    using LIMITS = std::numeric_limits<T>;
+    if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+    {
+        if (i < (int64_t)LIMITS::min() || i > (int64_t)LIMITS::max())
+            throw std::runtime_error("number out of range for the requested type");
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+        if (i < 0 || (uint64_t)i > (uint64_t)LIMITS::max())
+            throw std::runtime_error("number out of range for the requested type");
+    }
+    return static_cast<T>(i); // to a floating type: rounded, always in range
+}
+
+template <typename T>
+T json_number_cast(double d)
+{
+    using LIMITS = std::numeric_limits<T>;
+    if constexpr (std::is_integral_v<T>)
+    {
+        // truncated toward zero, as before; the result must then fit T
+        double limit = std::ldexp(1.0, LIMITS::digits);
+        if (!(std::trunc(d) < limit && std::trunc(d) >= (std::is_signed_v<T> ? -limit : 0.0)))
+            throw std::runtime_error("number out of range for the requested type");
+    }
+    return static_cast<T>(d);
+}
+
 /**
  * @class JSONNode
  * @brief Represents a node in a JSON document tree
@@ -36,6 +77,8 @@ enum class JSONType : short
  */
 class JSONNode
 {
+    friend class JSON_WRITER; // serializes the tree without copies
+
     JSONType d_type; ///< Type of this JSON node
 
     /// Object storage (only used when d_type == OBJECT)
@@ -54,6 +97,7 @@ class JSONNode
     {
         std::string d_string; ///< String value (JSONType::STRING)
         double d_number;      ///< Numeric value (JSONType::NUMBER)
+        int64_t d_integer;    ///< Integer value (JSONType::INTEGER)
         bool d_bool;          ///< Boolean value (JSONType::BOOL)
 
         value() {}  ///< Default constructor
@@ -123,12 +167,21 @@ public:
     explicit JSONNode(const std::vector<JSONNode> &nodes) : d_type(JSONType::ARRAY), d_array(nodes) {}
 
     /**
-     * @brief Construct number node from int
+     * @brief Construct integer node from int
      * @param value Integer value
      */
-    explicit JSONNode(int value) : d_type(JSONType::NUMBER)
+    explicit JSONNode(int value) : d_type(JSONType::INTEGER)
     {
-        d_value.d_number = value;
+        d_value.d_integer = value;
+    }
+
+    /**
+     * @brief Construct integer node
+     * @param value Integer value, kept exact
+     */
+    explicit JSONNode(int64_t value) : d_type(JSONType::INTEGER)
+    {
+        d_value.d_integer = value;
     }
 
     /**
@@ -140,6 +193,15 @@ public:
         new (&d_value.d_string) std::string(value);
     }
 
+    /**
+     * @brief Construct string node, taking over @p value
+     * @param value String value
+     */
+    explicit JSONNode(std::string &&value) : d_type(JSONType::STRING)
+    {
+        new (&d_value.d_string) std::string(std::move(value));
+    }
+
     /**
      * @brief Construct string node
      * @param value char * value
@@ -169,6 +231,9 @@ public:
         case JSONType::NUMBER:
             d_value.d_number = other.d_value.d_number;
             break;
+        case JSONType::INTEGER:
+            d_value.d_integer = other.d_value.d_integer;
+            break;
         case JSONType::BOOL:
             d_value.d_bool = other.d_value.d_bool;
             break;
@@ -194,6 +259,9 @@ public:
         case JSONType::NUMBER:
             d_value.d_number = other.d_value.d_number;
             break;
+        case JSONType::INTEGER:
+            d_value.d_integer = other.d_value.d_integer;
+            break;
         case JSONType::BOOL:
             d_value.d_bool = other.d_value.d_bool;
             break;
@@ -232,6 +300,9 @@ public:
             case JSONType::NUMBER:
                 d_value.d_number = node.d_value.d_number;
                 break;
+            case JSONType::INTEGER:
+                d_value.d_integer = node.d_value.d_integer;
+                break;
             case JSONType::BOOL:
                 d_value.d_bool = node.d_value.d_bool;
                 break;
@@ -269,6 +340,9 @@ public:
             case JSONType::NUMBER:
                 d_value.d_number = node.d_value.d_number;
                 break;
+            case JSONType::INTEGER:
+                d_value.d_integer = node.d_value.d_integer;
+                break;
             case JSONType::BOOL:
                 d_value.d_bool = node.d_value.d_bool;
                 break;
@@ -285,7 +359,7 @@ public:
 
     /**
      * @brief Checks if node contains a primitive JSON value
-     * @return true if node is bool, number, string, or null
+     * @return true if node is bool, number (double or integer), string, or null
      * @return false if node is object or array
      *
      * @note Useful for type checking before value extraction
@@ -294,6 +368,7 @@ public:
     {
         return (d_type == JSONType::BOOL ||
                 d_type == JSONType::NUMBER ||
+                d_type == JSONType::INTEGER ||
                 d_type == JSONType::STRING ||
                 d_type == JSONType::NULLT);
     }
@@ -321,6 +396,24 @@ public:
         d_array.push_back(node);
     }
 
+    /**
+     * @brief Appends a node to JSON array, taking its content
+     * @throws std::runtime_error if node is not an array
+     */
+    void appendArray(JSONNode &&node)
+    {
+        limitToArray();
+        d_array.push_back(std::move(node));
+    }
+
+    /**
+     * @brief Type check for numbers, double or integer
+     */
+    bool isNumber() const
+    {
+        return d_type == JSONType::NUMBER || d_type == JSONType::INTEGER;
+    }
+
     /**
      * @brief Type check for array nodes
      * @return true if node is JSON array
@@ -341,9 +434,11 @@ public:
 
     /**
      * @brief Template value extractor
-     * @tparam T Target type (int, double, bool, std::string)
+     * @tparam T Target type (any integer or floating type, bool, std::string); a number
+     *         converts to any arithmetic type (an integer exactly to int64_t)
      * @return Extracted value
-     * @throws std::runtime_error if node isn't a primitive value type
+     * @throws std::runtime_error if node isn't a primitive value type, or if the number is
+     *         outside the range of an integral T (a fraction is truncated)
      *
      * @example
      * double num = node.get<double>();
@@ -367,13 +462,18 @@ public:
                 throw std::runtime_error("type mismatch: requested type is not std::string");
             }
         case JSONType::NUMBER:
-            if constexpr (std::is_same_v<T, double>)
+            if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
             {
-                return d_value.d_number;
+                return json_number_cast<T>(d_value.d_number);
             }
-            else if constexpr (std::is_same_v<T, int>)
+            else
             {
-                return static_cast<int>(d_value.d_number);
+                throw std::runtime_error("type mismatch: requested type is not a number type");
+            }
+        case JSONType::INTEGER:
+            if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+            {
+                return json_number_cast<T>(d_value.d_integer);
             }
             else
             {
@@ -470,6 +570,8 @@ public:
 
     explicit operator int() const
     {
+        if (d_type == JSONType::INTEGER)
+            return static_cast<int>(d_value.d_integer);
         if (d_type != JSONType::NUMBER)
             throw std::runtime_error("node is not a number");
         return static_cast<int>(d_value.d_number);
@@ -484,6 +586,8 @@ public:
 
     explicit operator double() const
     {
+        if (d_type == JSONType::INTEGER)
+            return static_cast<double>(d_value.d_integer);
         if (d_type != JSONType::NUMBER)
             throw std::runtime_error("node is not a number");
         return d_value.d_number;
@@ -493,15 +597,25 @@ public:
      * @brief Parses JSON string into node tree
      * @param s JSON-formatted string
      * @return Root JSONNode
-     * @throws std::runtime_error on parse errors
+     * @throws std::runtime_error on parse errors (message carries the byte offset)
+     * @note Single pass over the input: no brace map, no substr, strings are copied in runs
+     *       between escapes. Nesting is limited to JSON_MAX_DEPTH.
+     *       Parsed as a JSON_DOCUMENT (json_value.h), then copied into JSONNodes: request
+     *       bodies are read on demand instead (JSON_LAZY, json_lazy.h).
      */
     static JSONNode parse(const std::string &s);
 
+    /**
+     * @brief Parses @p len bytes at @p data, same as parse(const std::string &)
+     * @note @p data needs no terminating NUL
+     */
+    static JSONNode parse(const char *data, size_t len);
+
     /**
      * @brief Serializes JSONNode to string
      * @param node Node to serialize
      * @return JSON-formatted string
-     * @throws std::runtime_error on circular references
+     * @note Written by JSON_WRITER (json_writer.h), which responses use directly
      */
     static std::string stringify(const JSONNode &node);
 
@@ -516,9 +630,28 @@ public:
         std::string s = JSONNode::stringify(json);
         int spaces = 0;
         int tab = 4;
-        for (char c : s)
+        bool in_string = false;
+        for (size_t i = 0; i < s.size(); i++)
         {
-            if (c == '{' || c == '[')
+            char c = s[i];
+            if (in_string) // brackets and commas in strings are text
+            {
+                stream << c;
+                if (c == '\\')
+                    stream << s[++i];
+                else if (c == '"')
+                    in_string = false;
+            }
+            else if (c == '"')
+            {
+                stream << c;
+                in_string = true;
+            }
+            else if ((c == '{' || c == '[') && (s[i + 1] == '}' || s[i + 1] == ']'))
+            {
+                stream << c << s[++i]; // empty container on one line
+            }
+            else if (c == '{' || c == '[')
             {
                 stream << c;
                 stream << '\n';
@@ -547,37 +680,6 @@ public:
     }
 };
 
-/**
- * @brief Parses a JSON object from a given JSON string.
- *
- * This function extracts key-value pairs from a JSON-formatted string and
- * constructs a JSONNode object. It handles nested objects and arrays using recursion.
- *
- * @param s The input JSON string.
- * @param start The index of the opening curly brace '{' for this object.
- * @param end The index of the corresponding closing curly brace '}' for this object.
- * @param bracePair A map that maps indices of opening brackets to their corresponding closing brackets.
- *
- * @return A JSONNode object representing the parsed JSON object.
- */
-JSONNode parseObject(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair);
-
-/**
- * @brief Parses a JSON array from a given JSON string.
- *
- * This function extracts values from a JSON-formatted string and constructs
- * a JSONNode object representing an array. It processes elements sequentially
- * and handles whitespace correctly.
- *
- * @param s The input JSON string.
- * @param start The index of the opening square bracket '[' for this array.
- * @param end The index of the corresponding closing square bracket ']' for this array.
- * @param bracePair A map that maps indices of opening brackets to their corresponding closing brackets.
- *
- * @return A JSONNode object representing the parsed JSON array.
- */
-JSONNode parseArray(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair);
-
 using JSON = JSONNode;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,361 @@
+#define LOG_MODULE LOG_MOD_HTTP
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <algorithm>
+#include "multipart.h"
+
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        s.remove_suffix(1);
+    return s;
+}
+
+/**
+ * @brief Parameter @p key of a header value such as `form-data; name="a"; filename="b.txt"`
+ */
+static bool header_param(std::string_view h, std::string_view key, std::string &out)
+{
+    size_t i = 0;
+    while (i < h.size())
+    {
+        // next ';'-separated item, a ';' inside quotes does not count
+        size_t j = i;
+        bool quoted = false;
+        while (j < h.size() && (quoted || h[j] != ';'))
+        {
+            if (h[j] == '"')
+                quoted = !quoted;
+            else if (quoted && h[j] == '\\')
+                j++;
+            j++;
+        }
+        std::string_view item = trim(h.substr(i, j - i));
+        i = j + 1;
+        size_t eq = item.find('=');
+        if (eq == std::string_view::npos)
+            continue;
+        std::string_view k = trim(item.substr(0, eq)), v = trim(item.substr(eq + 1));
+        if (k.size() != key.size() || strncasecmp(k.data(), key.data(), k.size()) != 0)
+            continue;
+        out.clear();
+        if (!v.empty() && v[0] == '"')
+            for (size_t x = 1; x < v.size() && v[x] != '"'; x++)
+            {
+                if (v[x] == '\\' && x + 1 < v.size())
+                    x++;
+                out += v[x];
+            }
+        else
+            out.assign(v);
+        return true;
+    }
+    return false;
+}
+
+MULTIPART_FORM::MULTIPART_FORM(std::string_view boundary, const std::string &dir)
+    : m_dir(dir), m_delimiter("\r\n--"), m_state(S_PREAMBLE), m_buf(new char[MULTIPART_BUFFER]),
+      m_len(0), m_scan(0), m_field_bytes(0), m_files(0), m_error(NULL)
+{
+    m_delimiter.append(boundary);
+    // the first boundary opens the body without a CRLF before it: one is made up so that
+    // every boundary is found as the same delimiter
+    m_buf[m_len++] = '\r';
+    m_buf[m_len++] = '\n';
+}
+
+MULTIPART_FORM::~MULTIPART_FORM()
+{
+    for (PART &part : m_parts)
+    {
+        if (part.fd >= 0)
+            close(part.fd);
+        if (!part.tmp_path.empty()) // never saved
+            unlink(part.tmp_path.c_str());
+    }
+    delete[] m_buf;
+}
+
+MULTIPART_FORM *MULTIPART_FORM::open(const HttpRequest &req, const std::string &dir)
+{
+    const char *type = req.m_content_type;
+    if (type == NULL || strncasecmp(type, "multipart/form-data", 19) != 0)
+        return NULL;
+    const char *b = strcasestr(type, "boundary=");
+    if (b == NULL)
+        return NULL;
+    b += 9;
+    size_t len;
+    if (*b == '"')
+    {
+        const char *q = strchr(++b, '"');
+        len = q ? q - b : 0;
+    }
+    else
+        len = strcspn(b, "; \t");
+    if (len == 0 || len > 70) // RFC 2046 limit, it also keeps the window's tail small
+        return NULL;
+    return new MULTIPART_FORM(std::string_view(b, len), dir);
+}
+
+bool MULTIPART_FORM::fail(const char *what)
+{
+    m_state = S_FAILED;
+    m_error = what;
+    return false;
+}
+
+bool MULTIPART_FORM::header(const char *line, size_t len)
+{
+    std::string_view h(line, len);
+    size_t colon = h.find(':');
+    if (colon == std::string_view::npos)
+        return fail("invalid part header");
+    std::string_view name = trim(h.substr(0, colon)), value = trim(h.substr(colon + 1));
+    PART &part = m_parts.back();
+    if (name.size() == 19 && strncasecmp(name.data(), "Content-Disposition", 19) == 0)
+    {
+        header_param(value, "name", part.name);
+        part.is_file = header_param(value, "filename", part.filename);
+    }
+    else if (name.size() == 12 && strncasecmp(name.data(), "Content-Type", 12) == 0)
+        part.content_type.assign(value);
+    return true;
+}
+
+bool MULTIPART_FORM::begin_data()
+{
+    PART &part = m_parts.back();
+    if (!part.is_file)
+        return true;
+    if (++m_files > MULTIPART_MAX_FILES)
+        return fail("too many files");
+    part.fd = ::open(m_dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0644);
+    if (part.fd < 0 && (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL))
+    {
+        std::string path = m_dir + "/.upload-XXXXXX";
+        part.fd = mkostemp(&path[0], O_CLOEXEC);
+        if (part.fd >= 0)
+            part.tmp_path = path;
+    }
+    if (part.fd < 0)
+    {
+        LOG_ERROR("upload: cannot create a file in %s: %s", m_dir.c_str(), strerror(errno));
+        return fail("cannot store the file");
+    }
+    return true;
+}
+
+bool MULTIPART_FORM::data(const char *p, size_t n)
+{
+    PART &part = m_parts.back();
+    part.size += n;
+    if (part.fd < 0)
+    {
+        m_field_bytes += n;
+        if (m_field_bytes > MULTIPART_MAX_FIELDS)
+            return fail("form fields too large");
+        part.value.append(p, n);
+        return true;
+    }
+    while (n > 0)
+    {
+        ssize_t w = ::write(part.fd, p, n);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR("upload: write to %s failed: %s", m_dir.c_str(), strerror(errno));
+            return fail("cannot store the file");
+        }
+        p += w;
+        n -= w;
+    }
+    return true;
+}
+
+bool MULTIPART_FORM::process()
+{
+    const char *delim = m_delimiter.data();
+    size_t dlen = m_delimiter.size();
+    size_t p = 0; // consumed
+    bool more = true;
+    while (more)
+    {
+        switch (m_state)
+        {
+        case S_PREAMBLE:
+        {
+            const char *d = (const char *)memmem(m_buf + p, m_len - p, delim, dlen);
+            if (d)
+            {
+                p = d - m_buf + dlen;
+                m_state = S_BOUNDARY;
+            }
+            else
+            {
+                if (m_len - p > dlen - 1)
+                    p = m_len - (dlen - 1);
+                more = false;
+            }
+            break;
+        }
+        case S_BOUNDARY:
+            if (m_len - p < 2)
+                more = false;
+            else if (m_buf[p] == '-' && m_buf[p + 1] == '-')
+            {
+                m_state = S_END;
+                p = m_len;
+                more = false;
+            }
+            else if (m_buf[p] == '\r' && m_buf[p + 1] == '\n')
+            {
+                if (m_parts.size() == MULTIPART_MAX_PARTS)
+                    return fail("too many parts");
+                p += 2;
+                m_parts.emplace_back();
+                m_state = S_HEADERS;
+            }
+            else
+                return fail("invalid boundary line");
+            break;
+        case S_HEADERS:
+        {
+            const char *e = (const char *)memmem(m_buf + p, m_len - p, "\r\n", 2);
+            if (e == NULL)
+            {
+                if (p == 0 && m_len == MULTIPART_BUFFER)
+                    return fail("part header too long");
+                more = false;
+                break;
+            }
+            size_t n = e - (m_buf + p);
+            if (n == 0) // the empty line: data follows
+            {
+                p += 2;
+                if (!begin_data())
+                    return false;
+                m_state = S_DATA;
+                m_scan = p;
+            }
+            else if (!header(m_buf + p, n))
+                return false;
+            else
+                p += n + 2;
+            break;
+        }
+        case S_DATA:
+        {
+            size_t from = m_scan > p ? m_scan : p;
+            const char *d = (const char *)memmem(m_buf + from, m_len - from, delim, dlen);
+            if (d)
+            {
+                size_t at = d - m_buf;
+                if (!data(m_buf + p, at - p))
+                    return false;
+                p = at + dlen;
+                m_state = S_BOUNDARY;
+                break;
+            }
+            // the last dlen - 1 bytes may be the start of a boundary, the rest is data:
+            // written once half the window is full, so that each write() is large
+            size_t safe = m_len > dlen - 1 ? m_len - (dlen - 1) : 0;
+            if (safe > p && m_len - p >= MULTIPART_BUFFER / 2)
+            {
+                if (!data(m_buf + p, safe - p))
+                    return false;
+                p = safe;
+            }
+            m_scan = safe > p ? safe : p; // no boundary starts before
+            more = false;
+            break;
+        }
+        default: // S_END, S_FAILED
+            p = m_len;
+            more = false;
+            break;
+        }
+    }
+    memmove(m_buf, m_buf + p, m_len - p);
+    m_len -= p;
+    m_scan = m_scan > p ? m_scan - p : 0;
+    return true;
+}
+
+void MULTIPART_FORM::write(const char *data, size_t len)
+{
+    // process() always leaves room: at most half the window, or a header line being read
+    while (len > 0 && m_state != S_END && m_state != S_FAILED)
+    {
+        size_t n = std::min(len, MULTIPART_BUFFER - m_len);
+        memcpy(m_buf + m_len, data, n);
+        m_len += n;
+        data += n;
+        len -= n;
+        if (!process())
+            return;
+    }
+}
+
+void MULTIPART_FORM::finish()
+{
+    if (m_state != S_END && m_state != S_FAILED)
+        fail("body ends before the closing boundary");
+    if (m_state == S_FAILED)
+        LOG_DEBUG("multipart body: %s", m_error);
+}
+
+const MULTIPART_FORM::PART *MULTIPART_FORM::find(std::string_view name) const
+{
+    for (const PART &part : m_parts)
+        if (part.name == name)
+            return &part;
+    return NULL;
+}
+
+bool MULTIPART_FORM::save(const PART &part, const std::string &path)
+{
+    if (!part.is_file || part.fd < 0)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    PART &p = m_parts[&part - m_parts.data()];
+    if (p.tmp_path.empty())
+    {
+        // an O_TMPFILE file gets its first name through its /proc link
+        char proc[64];
+        snprintf(proc, sizeof(proc), "/proc/self/fd/%d", p.fd);
+        return linkat(AT_FDCWD, proc, AT_FDCWD, path.c_str(), AT_SYMLINK_FOLLOW) == 0;
+    }
+    // link, not rename: an existing file is not replaced
+    if (link(p.tmp_path.c_str(), path.c_str()) != 0)
+        return false;
+    unlink(p.tmp_path.c_str());
+    p.tmp_path.clear();
+    return true;
+}
+
+std::string MULTIPART_FORM::safe_name(std::string_view filename)
+{
+    size_t slash = filename.find_last_of("/\\");
+    if (slash != std::string_view::npos)
+        filename.remove_prefix(slash + 1);
+    std::string name;
+    for (char c : filename)
+    {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_';
+        name += ok ? c : '_';
+    }
+    size_t dots = name.find_first_not_of('.');
+    name.erase(0, dots == std::string::npos ? name.size() : dots);
+    return name.empty() ? "upload" : name;
+}
@@ -0,0 +1,147 @@
+/**
+ * NOTE:
+ * Streaming multipart/form-data body sink, for uploads of any size:
+ *
+ *   router.stream(POST, "/upload", [](const HttpRequest &req) { return MULTIPART_FORM::open(req, dir); });
+ *   router.post("/upload", [](const HttpRequest &req, HttpResponse &res)
+ *               { MULTIPART_FORM *form = req.sink<MULTIPART_FORM>();
+ *                 if (form && form->valid()) form->save(*form->find("file"), dir + "/a.bin"); ... });
+ *
+ * The body goes through a window of MULTIPART_BUFFER bytes whatever its size: parts are
+ * split on the boundary as bytes arrive, and the data of a file part is written out once
+ * half the window is full or its part ends (so writes are large), keeping only the bytes
+ * that could still be the start of a boundary.
+ *
+ * A file part goes to an unnamed file (O_TMPFILE) in the directory given to open(): it
+ * has no name until the handler calls save(), which links it in place (linkat), and it
+ * vanishes with the sink if the handler does not, so an aborted or rejected upload leaves
+ * nothing behind. Filesystems without O_TMPFILE get a hidden named temporary file instead,
+ * renamed by save() and unlinked otherwise. Other parts are form fields kept in memory, up
+ * to MULTIPART_MAX_FIELDS bytes in all. Each file holds a descriptor until the sink is
+ * deleted, so a form of more than MULTIPART_MAX_FILES files (or MULTIPART_MAX_PARTS parts)
+ * fails rather than let one request use up the process's descriptors.
+ */
+
+#ifndef _MULTIPART_H_
+#define _MULTIPART_H_
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "http_types.h"
+
+static const size_t MULTIPART_BUFFER = 64 * 1024;     ///< Window the body goes through
+static const size_t MULTIPART_MAX_FIELDS = 64 * 1024; ///< Bytes of non-file fields kept
+static const size_t MULTIPART_MAX_PARTS = 64;          ///< Parts of one form
+static const size_t MULTIPART_MAX_FILES = 8;           ///< File parts of one form (one fd each)
+
+/**
+ * @class MULTIPART_FORM
+ * @brief Splits a multipart/form-data body into fields and files on disk as it streams in
+ */
+class MULTIPART_FORM : public BODY_SINK
+{
+public:
+    /**
+     * @struct PART
+     * @brief One part of the form
+     */
+    struct PART
+    {
+        std::string name;         ///< Form field name
+        std::string filename;     ///< File name sent by the client (empty for a plain field)
+        std::string content_type; ///< Content-Type of the part, if given
+        std::string value;        ///< Value of a plain field
+        bool is_file;             ///< The part had a filename: its data went to fd
+        int fd;                   ///< Unnamed file holding the data, -1 for a plain field
+        std::string tmp_path;     ///< Named temporary file (no O_TMPFILE), empty otherwise
+        long size;                ///< Bytes of data
+
+        PART() : is_file(false), fd(-1), size(0) {}
+    };
+
+private:
+    /**
+     * @enum STATE
+     * @brief What the parser expects next
+     */
+    enum STATE
+    {
+        S_PREAMBLE,  ///< Anything up to the first boundary
+        S_BOUNDARY,  ///< "\r\n" (a part follows) or "--" (the end) after a boundary
+        S_HEADERS,   ///< Header lines of a part, up to an empty line
+        S_DATA,      ///< Data of a part, up to the next boundary
+        S_END,       ///< After the closing boundary: the epilogue is ignored
+        S_FAILED     ///< Invalid body or I/O error, see error()
+    };
+
+    std::string m_dir;       ///< Directory of the temporary files
+    std::string m_delimiter; ///< "\r\n--" + boundary
+    STATE m_state;
+    char *m_buf;             ///< The window, MULTIPART_BUFFER bytes
+    size_t m_len;            ///< Bytes held in it
+    size_t m_scan;           ///< In S_DATA, where the boundary search resumes
+    size_t m_field_bytes;    ///< Bytes of plain field values so far
+    size_t m_files;          ///< File parts so far
+    std::vector<PART> m_parts;
+    const char *m_error;
+
+    bool fail(const char *what);
+    bool process();
+    bool header(const char *line, size_t len);
+    bool begin_data();
+    bool data(const char *p, size_t n);
+
+public:
+    /**
+     * @param boundary Boundary from the Content-Type header
+     * @param dir Directory where file parts are written (then saved, on the same filesystem)
+     */
+    MULTIPART_FORM(std::string_view boundary, const std::string &dir);
+    ~MULTIPART_FORM();
+    MULTIPART_FORM(const MULTIPART_FORM &) = delete;
+    MULTIPART_FORM &operator=(const MULTIPART_FORM &) = delete;
+
+    /**
+     * @brief Sink for @p req if it is multipart/form-data with a boundary, to give to
+     *        ROUTER::stream()
+     * @return NULL otherwise (the body is then buffered as usual)
+     */
+    static MULTIPART_FORM *open(const HttpRequest &req, const std::string &dir);
+
+    /* BODY_SINK */
+    void write(const char *data, size_t len) override;
+    void finish() override;
+
+    /**
+     * @brief The body was complete and well formed, every file part is on disk
+     */
+    bool valid() const { return m_state == S_END; }
+    const char *error() const { return m_error; }
+
+    size_t size() const { return m_parts.size(); }
+    const PART &operator[](size_t i) const { return m_parts[i]; }
+
+    /**
+     * @brief First part named @p name
+     * @return NULL if there is none
+     */
+    const PART *find(std::string_view name) const;
+
+    /**
+     * @brief Give the data of file part @p part the name @p path (never replacing a file)
+     * @return false if it is not a file part or the link fails (errno tells why, EEXIST
+     *         if @p path exists)
+     */
+    bool save(const PART &part, const std::string &path);
+
+    /**
+     * @brief @p filename reduced to a safe base name: no directory, only [A-Za-z0-9._-],
+     *        no leading '.', "upload" if nothing is left
+     */
+    static std::string safe_name(std::string_view filename);
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdexcept>
+#include "route_tree.h"
+
+std::vector<std::string> ROUTE_TREE::parse(std::string_view pattern)
+{
+    if (pattern.empty() || pattern[0] != '/')
+        throw std::invalid_argument("route pattern must start with '/': " + std::string(pattern));
+    std::vector<std::string> names;
+    size_t i = 0;
+    while ((i = pattern.find_first_of(":*", i)) != std::string_view::npos)
+    {
+        size_t end = pattern.find('/', i);
+        if (end == std::string_view::npos)
+            end = pattern.size();
+        if (end == i + 1)
+            throw std::invalid_argument("route parameter without a name: " + std::string(pattern));
+        if (pattern[i - 1] != '/')
+            throw std::invalid_argument("route parameter must be a whole segment: " + std::string(pattern));
+        if (pattern[i] == '*' && end != pattern.size())
+            throw std::invalid_argument("route wildcard must end the pattern: " + std::string(pattern));
+        if (names.size() == ROUTE_MAX_PARAMS)
+            throw std::invalid_argument("route has too many parameters: " + std::string(pattern));
+        names.emplace_back(pattern.substr(i + 1, end - i - 1));
+        i = end;
+    }
+    return names;
+}
+
+ROUTE_TREE::NODE *ROUTE_TREE::insert_static(NODE *n, std::string_view s)
+{
+    while (!s.empty())
+    {
+        size_t k = n->first.find(s[0]);
+        if (k == std::string::npos)
+        {
+            NODE *child = new NODE();
+            child->prefix.assign(s);
+            n->first += s[0];
+            n->children.emplace_back(child);
+            return child;
+        }
+        NODE *child = n->children[k].get();
+        size_t common = 0;
+        while (common < child->prefix.size() && common < s.size() && child->prefix[common] == s[common])
+            common++;
+        if (common < child->prefix.size())
+        {
+            // split the edge: the shared part becomes a node above the old child
+            NODE *mid = new NODE();
+            mid->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            mid->first += child->prefix[0];
+            mid->children.emplace_back(n->children[k].release());
+            n->children[k].reset(mid);
+            child = mid;
+        }
+        s.remove_prefix(common);
+        n = child;
+    }
+    return n;
+}
+
+void ROUTE_TREE::insert(std::string_view pattern, int route)
+{
+    parse(pattern); // validates
+    NODE *n = &m_root;
+    size_t i = 0;
+    while (true)
+    {
+        size_t p = pattern.find_first_of(":*", i);
+        n = insert_static(n, pattern.substr(i, p == std::string_view::npos ? std::string_view::npos : p - i));
+        if (p == std::string_view::npos)
+            break;
+        std::unique_ptr<NODE> &slot = pattern[p] == ':' ? n->param : n->wildcard;
+        if (!slot)
+            slot.reset(new NODE());
+        n = slot.get();
+        i = pattern.find('/', p);
+        if (i == std::string_view::npos)
+            break;
+    }
+    n->route = route;
+}
+
+int ROUTE_TREE::match(const NODE *n, std::string_view path, std::string_view *values, int &count)
+{
+    if (path.empty() && n->route >= 0)
+        return n->route;
+    if (!path.empty())
+    {
+        size_t k = n->first.find(path[0]);
+        if (k != std::string::npos)
+        {
+            const NODE *child = n->children[k].get();
+            if (path.compare(0, child->prefix.size(), child->prefix) == 0)
+            {
+                int r = match(child, path.substr(child->prefix.size()), values, count);
+                if (r >= 0)
+                    return r;
+            }
+        }
+        if (n->param && path[0] != '/')
+        {
+            size_t end = path.find('/');
+            if (end == std::string_view::npos)
+                end = path.size();
+            values[count++] = path.substr(0, end);
+            int r = match(n->param.get(), path.substr(end), values, count);
+            if (r >= 0)
+                return r;
+            count--;
+        }
+    }
+    if (n->wildcard && n->wildcard->route >= 0)
+    {
+        values[count++] = path;
+        return n->wildcard->route;
+    }
+    return -1;
+}
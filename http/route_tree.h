@@ -0,0 +1,86 @@
+/**
+ * NOTE:
+ * Compressed radix tree of URL patterns, one per method in ROUTER. A pattern is made of
+ * - static text: "/users/", matched byte for byte
+ * - ":name": one path segment (up to the next '/', not empty)
+ * - "*name": the rest of the path, possibly empty; only at the end of a pattern
+ * e.g. "/users/:id/posts", or "/static/" followed by "*file". Static edges share their
+ * common prefixes, so a lookup reads each byte of the path about once. Where several
+ * patterns could match, a static edge is tried before a parameter and a parameter before a
+ * wildcard, backtracking if the more specific one leads nowhere.
+ *
+ * Lookups do not allocate: parameter values are views into the path, written to the
+ * caller's array in pattern order. Their names are not kept in the tree: they belong to
+ * the route (see ROUTE_TREE::parse), so "/a/:id" and "/a/:name/b" can share a node.
+ */
+
+#ifndef _ROUTE_TREE_H_
+#define _ROUTE_TREE_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static const int ROUTE_MAX_PARAMS = 8; ///< Parameters (and wildcard) in one pattern
+
+/**
+ * @class ROUTE_TREE
+ * @brief Maps URL patterns to route indices
+ */
+class ROUTE_TREE
+{
+private:
+    /**
+     * @struct NODE
+     * @brief One edge of the tree and what hangs below it
+     */
+    struct NODE
+    {
+        std::string prefix;                          ///< Static bytes of the edge (empty for parameter nodes)
+        std::string first;                           ///< First byte of each static child, same order
+        std::vector<std::unique_ptr<NODE>> children; ///< Static children
+        std::unique_ptr<NODE> param;                 ///< ":name" child
+        std::unique_ptr<NODE> wildcard;              ///< "*name" child, always a leaf
+        int route;                                   ///< Route ending here, -1 if none
+
+        NODE() : route(-1) {}
+    };
+
+    NODE m_root;
+
+    static NODE *insert_static(NODE *n, std::string_view s);
+    static int match(const NODE *n, std::string_view path, std::string_view *values, int &count);
+
+public:
+    ROUTE_TREE() = default;
+    ROUTE_TREE(const ROUTE_TREE &) = delete;
+    ROUTE_TREE &operator=(const ROUTE_TREE &) = delete;
+
+    /**
+     * @brief Names of the parameters of @p pattern, in order
+     * @throws std::invalid_argument if the pattern is malformed (no leading '/', an empty
+     *         name, a wildcard before the end, more than ROUTE_MAX_PARAMS parameters)
+     */
+    static std::vector<std::string> parse(std::string_view pattern);
+
+    /**
+     * @brief Map @p pattern to @p route (replacing the route it had)
+     * @throws std::invalid_argument as parse()
+     */
+    void insert(std::string_view pattern, int route);
+
+    /**
+     * @brief Route matching @p path
+     * @param values Receives the parameter values (ROUTE_MAX_PARAMS of room), views into @p path
+     * @param count Receives their number
+     * @return The route, -1 if none matches
+     */
+    int find(std::string_view path, std::string_view *values, int &count) const
+    {
+        count = 0;
+        return match(&m_root, path, values, count);
+    }
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include <string.h>
+#include "url_params.h"
+
+static inline int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+size_t URL_PARAMS::decode(char *s, size_t len)
+{
+    // nothing to do for most names and values: look before writing
+    char *w = s;
+    const char *r = s, *end = s + len;
+    while (r < end && *r != '%' && *r != '+')
+        r++;
+    w += r - s;
+    while (r < end)
+    {
+        int hi, lo;
+        if (*r == '+')
+        {
+            *w++ = ' ';
+            r++;
+        }
+        else if (*r == '%' && end - r >= 3 && (hi = hex_value(r[1])) >= 0 && (lo = hex_value(r[2])) >= 0)
+        {
+            *w++ = (char)(hi << 4 | lo);
+            r += 3;
+        }
+        else
+            *w++ = *r++;
+    }
+    return w - s;
+}
+
+void URL_PARAMS::parse() const
+{
+    m_parsed = true;
+    char *p = m_text, *end = m_text + m_len;
+    while (p < end)
+    {
+        char *amp = (char *)memchr(p, '&', end - p);
+        if (amp == NULL)
+            amp = end;
+        if (amp > p) // "a&&b": no empty params
+        {
+            char *eq = (char *)memchr(p, '=', amp - p);
+            char *name_end = eq ? eq : amp;
+            PARAM param;
+            param.name = std::string_view(p, decode(p, name_end - p));
+            if (eq)
+                param.value = std::string_view(eq + 1, decode(eq + 1, amp - eq - 1));
+            if (m_count < INLINE_PARAMS)
+                m_inline[m_count] = param;
+            else
+                m_more.push_back(param);
+            m_count++;
+        }
+        p = amp + 1;
+    }
+}
+
+const URL_PARAMS::PARAM *URL_PARAMS::find(std::string_view name) const
+{
+    ensure();
+    for (size_t i = 0; i < m_count; i++)
+    {
+        const PARAM &p = i < INLINE_PARAMS ? m_inline[i] : m_more[i - INLINE_PARAMS];
+        if (p.name == name)
+            return &p;
+    }
+    return NULL;
+}
@@ -0,0 +1,138 @@
+/**
+ * NOTE:
+ * Parameters of a query string (req.m_query) or of an application/x-www-form-urlencoded
+ * body (req.m_form), read on demand:
+ * - assign() only records where the text is; it is split and decoded the first time a
+ *   parameter is asked for, so a request whose handler never looks pays nothing
+ * - names and values are decoded in place ('+' is a space, %XX a byte): each one shrinks
+ *   inside its own span of the read buffer, and the params are string_views into it, no
+ *   copy and no allocation for the first INLINE_PARAMS of them
+ * - the first occurrence of a repeated name is the one found by name; at() sees them all
+ * The views are valid until HTTP_CONN::init() resets the request.
+ */
+
+#ifndef _URL_PARAMS_H_
+#define _URL_PARAMS_H_
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @class URL_PARAMS
+ * @brief Small map of name=value pairs viewing the text they were parsed from
+ */
+class URL_PARAMS
+{
+public:
+    /**
+     * @struct PARAM
+     * @brief One decoded name=value pair
+     */
+    struct PARAM
+    {
+        std::string_view name;
+        std::string_view value; ///< Empty for "name" and "name="
+    };
+
+private:
+    static const size_t INLINE_PARAMS = 8; ///< Params held without allocating
+
+    char *m_text;          ///< Undecoded text (read buffer), NULL if none
+    size_t m_len;          ///< Its length
+    mutable bool m_parsed; ///< m_params are filled and the text decoded
+    mutable PARAM m_inline[INLINE_PARAMS];
+    mutable std::vector<PARAM> m_more; ///< Params past INLINE_PARAMS
+    mutable size_t m_count;            ///< Params in all
+
+    void parse() const;
+
+    void ensure() const
+    {
+        if (!m_parsed)
+            parse();
+    }
+
+public:
+    URL_PARAMS() : m_text(NULL), m_len(0), m_parsed(true), m_count(0) {}
+    URL_PARAMS(const URL_PARAMS &) = delete;
+    URL_PARAMS &operator=(const URL_PARAMS &) = delete;
+
+    /**
+     * @brief Use the @p len bytes at @p text, to be decoded in place when first read
+     */
+    void assign(char *text, size_t len)
+    {
+        clear();
+        m_text = text;
+        m_len = len;
+        m_parsed = false;
+    }
+
+    void clear()
+    {
+        m_text = NULL;
+        m_len = 0;
+        m_parsed = true;
+        m_count = 0;
+        m_more.clear();
+    }
+
+    size_t size() const
+    {
+        ensure();
+        return m_count;
+    }
+
+    /**
+     * @brief Param @p i, in text order
+     * @throws std::out_of_range if @p i >= size()
+     */
+    const PARAM &at(size_t i) const
+    {
+        ensure();
+        if (i >= m_count)
+            throw std::out_of_range("parameter index out of range");
+        return i < INLINE_PARAMS ? m_inline[i] : m_more[i - INLINE_PARAMS];
+    }
+
+    /**
+     * @brief First param named @p name
+     * @return NULL if there is none
+     */
+    const PARAM *find(std::string_view name) const;
+
+    bool has(std::string_view name) const { return find(name) != NULL; }
+
+    /**
+     * @brief Value of @p name
+     * @throws std::out_of_range if there is no such param (as a missing member of req.m_body)
+     */
+    std::string_view operator[](std::string_view name) const
+    {
+        const PARAM *p = find(name);
+        if (p == NULL)
+            throw std::out_of_range("no parameter named " + std::string(name));
+        return p->value;
+    }
+
+    /**
+     * @brief Value of @p name, @p fallback if there is no such param
+     */
+    std::string_view get(std::string_view name, std::string_view fallback = std::string_view()) const
+    {
+        const PARAM *p = find(name);
+        return p ? p->value : fallback;
+    }
+
+    /**
+     * @brief Percent-decode the @p len bytes at @p s in place ('+' becomes a space, a '%' not
+     *        followed by two hex digits is kept as is)
+     * @return The decoded length
+     */
+    static size_t decode(char *s, size_t len);
+};
+
+#endif
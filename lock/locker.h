@@ -4,6 +4,8 @@
 #include <exception>
 #include <pthread.h>
 #include <semaphore.h>
+#include <errno.h>
+#include <time.h>
 
 /**
  * @class SEM
@@ -49,6 +51,36 @@ public:
     {
         return sem_wait(&m_sem) == 0;
     }
+    /**
+     * @brief Decrements the semaphore only if it can be done without blocking.
+     * @return true if the count was decremented, false if it was already 0.
+     */
+    bool trywait()
+    {
+        return sem_trywait(&m_sem) == 0;
+    }
+    /**
+     * @brief Decrements the semaphore, giving up after a deadline.
+     * @param ms_timeout Maximum time to wait (in milliseconds).
+     * @return true if the count was decremented, false on timeout or error.
+     * @note Retries transparently when interrupted by a signal (SIGALRM is used by the timer).
+     */
+    bool timedwait(int ms_timeout)
+    {
+        struct timespec t;
+        clock_gettime(CLOCK_REALTIME, &t);
+        t.tv_sec += ms_timeout / 1000;
+        t.tv_nsec += (ms_timeout % 1000) * 1000000L;
+        if (t.tv_nsec >= 1000000000L)
+        {
+            t.tv_sec++;
+            t.tv_nsec -= 1000000000L;
+        }
+        int ret;
+        while ((ret = sem_timedwait(&m_sem, &t)) != 0 && errno == EINTR)
+            ;
+        return ret == 0;
+    }
     /**
      * @brief Increments (unlocks) the semaphore.
      * @return true if successful, false on error.
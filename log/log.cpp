@@ -4,42 +4,89 @@
  * - "%08ld" will append preceding 0’s up to 8 digits.
  * - "snprintf" this function return how much character it has return in buffer
  * - "vsnprintf" this function return how much character it has return in buffer but it has variable  argument
+ * - Asynchronous mode never locks on the logging path: the line is formatted into a
+ *   thread-local buffer and copied into the thread's own LOG_RING. m_mutex is only taken
+ *   once per thread, to register its ring. A thread that exits retires its ring (RING_OWNER),
+ *   the writer frees it once drained: connect threads and the like come and go.
+ * - Binary mode shares that path (commit()); only the record differs. m_mutex is also taken
+ *   once per call site, to register its format.
  */
 
 #include <time.h>
 #include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <algorithm>
 #include "log.h"
 
 using namespace std;
 
+static const int FLUSH_INTERVAL_MS = 200; ///< Longest time a line waits in a ring
+static const int AVG_LINE_BYTES = 128;    ///< Sizing hint turning max_queue_size into ring bytes
+
+thread_local LOG::RING_OWNER LOG::t_ring;
+std::atomic<int> LOG::s_level[LOG_MOD_COUNT];
+
+static const char *module_names[LOG_MOD_COUNT] = {"core", "http", "sql", "access"};
+static const char *level_names[] = {"debug", "info", "warn", "error", "off"};
+
 LOG::LOG()
 {
     m_count = 0;
     m_is_async = false;
+    m_fd = -1;
+    memset(dir_name, '\0', sizeof(dir_name));
+    memset(log_name, '\0', sizeof(log_name));
+    m_ring_size = 0;
+    m_wake = false;
+    m_stop = false;
+    m_writing = false;
+    m_dropped = 0;
+    m_binary = false;
+    m_formats_written = 0;
+    m_part = 0;
+    m_day_end = 0;
+    memset(m_path, '\0', sizeof(m_path));
 }
 
 LOG::~LOG()
 {
-    if (m_fp != NULL)
-        fclose(m_fp);
-}
-bool LOG::init(const char *file_name, int close_log, int log_buf_size, int split_lines, int max_queue_size)
-{
-    // Asynchronous mode require setting the length of blocking queue and synchronous mode does not
-    // if max_queue_size is greater than 1 we need asynchronoes writing method
-    if (max_queue_size >= 1)
+    if (m_writing)
     {
-        m_is_async = true;
-        m_log_queue = new block_queue<string>(max_queue_size);
-        pthread_t tid;
-        // create a thread to process(consumer) asynchronous log  
-        pthread_create(&tid, NULL, flush_log_thread, NULL);
+        m_mutex.lock();
+        m_stop = true;
+        m_cond.broadcast();
+        m_mutex.unlock();
+        pthread_join(m_writer, NULL);
     }
+    m_archiver.stop();
+    for (LOG_RING *r : m_rings)
+        delete r;
+    if (m_fd != -1)
+        close(m_fd);
+}
+/**
+ * @brief Local midnight following @p t
+ */
+static time_t day_end(time_t t)
+{
+    struct tm my_tm;
+    localtime_r(&t, &my_tm);
+    my_tm.tm_hour = my_tm.tm_min = my_tm.tm_sec = 0;
+    my_tm.tm_mday++;
+    my_tm.tm_isdst = -1;
+    return mktime(&my_tm);
+}
+
+bool LOG::init(const char *file_name, int close_log, int log_buf_size, int split_lines, int max_queue_size, bool binary,
+               bool compress, int keep_files, long long keep_bytes)
+{
     m_close_log = close_log;
     m_log_buf_size = log_buf_size;
-    m_buf = new char[m_log_buf_size];
-    memset(m_buf, '\0', m_log_buf_size);
     m_split_line = split_lines;
+    m_binary = binary;
 
     time_t t = time(NULL);
     struct tm *sys_tm = localtime(&t);
@@ -49,111 +96,397 @@ bool LOG::init(const char *file_name, int close_log, int log_buf_size, int split
     char log_full_name[256] = {0};
 
     if (p == NULL)
+    {
         // year is stored as eg.2025-1900 as 125 so we need to add 1900 back also months are 0 index based we need to add 1
-        snprintf(log_full_name, 255, "%d_%02d_%02d_%s", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, file_name);
+        strcpy(log_name, file_name);
+    }
     else
     {
         strcpy(log_name, p + 1);
         strncpy(dir_name, file_name, p - file_name + 1); // copy dir_name from file name if it contain dir name
-        snprintf(log_full_name, 255, "%s%d_%02d_%02d_%s", dir_name, my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, log_name);
     }
-    m_today = my_tm.tm_mday;
+    if (m_binary)
+        strcat(log_name, ".bin"); // never mixed up with (or appended to) a text log
+    snprintf(log_full_name, 255, "%s%d_%02d_%02d_%s", dir_name, my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, log_name);
+    m_day_end = day_end(t);
 
-    m_fp = fopen(log_full_name, "a");
-    if (m_fp == NULL)
+    m_fd = open_file(log_full_name);
+    if (m_fd == -1)
         return false;
+    strcpy(m_path, log_full_name);
+
+    // Asynchronous mode require setting the size of the per-thread rings and synchronous mode does not
+    if (max_queue_size >= 1)
+    {
+        m_is_async = true;
+        m_ring_size = (size_t)max_queue_size * AVG_LINE_BYTES;
+        if (m_ring_size < (size_t)m_log_buf_size * 2)
+            m_ring_size = (size_t)m_log_buf_size * 2;
+        // create a thread to process(consumer) asynchronous log
+        m_writing = pthread_create(&m_writer, NULL, flush_log_thread, NULL) == 0;
+        if (!m_writing)
+            m_is_async = false;
+    }
+
+    // the writer rotates by itself in async mode, the archiver does it for sync mode
+    function<void()> tick;
+    if (!m_is_async)
+        tick = [this]()
+        { rotate(0); };
+    m_archiver.start(dir_name, log_name, m_path, compress, keep_files, keep_bytes, tick);
     return true;
 }
 
+LOG::RING_OWNER::~RING_OWNER()
+{
+    // the thread pushes nothing after this, the writer may free the ring once it is empty
+    if (ring)
+        ring->retire();
+}
+
+LOG_RING *LOG::ring()
+{
+    if (t_ring.ring == NULL)
+    {
+        t_ring.ring = new LOG_RING(m_ring_size);
+        m_mutex.lock();
+        m_rings.push_back(t_ring.ring); // owned by LOG, retired by the thread on exit
+        m_mutex.unlock();
+    }
+    return t_ring.ring;
+}
+
+void LOG::wake()
+{
+    if (!m_wake.exchange(true))
+        m_cond.signal();
+}
+
+int LOG::open_file(const char *path)
+{
+    // O_APPEND: every write() lands at the end, even with several writers in sync mode
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1 || !m_binary)
+        return fd;
+
+    // a new session: the decoder forgets earlier ids, every format is described again
+    char magic[1 + sizeof(BINLOG_MAGIC) - 1];
+    magic[0] = 'M';
+    memcpy(magic + 1, BINLOG_MAGIC, sizeof(BINLOG_MAGIC) - 1);
+    if (write(fd, magic, sizeof(magic)) != (ssize_t)sizeof(magic))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void LOG::write_formats()
+{
+    for (; m_formats_written < m_formats.size(); m_formats_written++)
+    {
+        const string &format = m_formats[m_formats_written].second;
+        char head[1 + 4 + 1 + 4];
+        uint32_t id = m_formats_written;
+        uint8_t level = m_formats[m_formats_written].first;
+        uint32_t len = format.size();
+        head[0] = 'F';
+        memcpy(head + 1, &id, sizeof(id));
+        memcpy(head + 5, &level, sizeof(level));
+        memcpy(head + 6, &len, sizeof(len));
+        struct iovec v[2] = {{head, sizeof(head)}, {(void *)format.data(), len}};
+        write_all(v, 2);
+    }
+}
+
+int LOG::register_format(int level, const char *format)
+{
+    LOG *log = get_instance();
+    log->m_mutex.lock();
+    log->m_formats.push_back(make_pair(level, string(format)));
+    int id = log->m_formats.size() - 1;
+    log->m_mutex.unlock();
+    return id;
+}
+
+char *LOG::line_buffer()
+{
+    thread_local vector<char> t_buf;
+    if ((int)t_buf.size() < m_log_buf_size)
+        t_buf.resize(m_log_buf_size);
+    return t_buf.data();
+}
+
 void LOG::write_log(int level, const char *format, ...)
 {
+    if (m_fd == -1)
+        return;
+
     struct timeval now = {0, 0};
     gettimeofday(&now, NULL);
-    time_t t = now.tv_sec;
-    struct tm *sys_tm = localtime(&t);
-    struct tm my_tm = *sys_tm;
-    char s[16] = {0};
+
+    // the date part only changes once a second, keep it per thread instead of calling localtime() per line
+    thread_local time_t t_sec = 0;
+    thread_local char t_date[32];
+    thread_local int t_date_len = 0;
+    if (now.tv_sec != t_sec)
+    {
+        struct tm my_tm;
+        localtime_r(&now.tv_sec, &my_tm);
+        t_date_len = snprintf(t_date, sizeof(t_date), "%d-%02d-%02d %02d:%02d:%02d", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec);
+        t_sec = now.tv_sec;
+    }
+
+    const char *s;
     switch (level)
     {
     case 0:
-        strcpy(s, "[debug]:");
+        s = "[debug]:";
         break;
     case 1:
-        strcpy(s, "[info]:");
+        s = "[info]:";
         break;
     case 2:
-        strcpy(s, "[warn]:");
+        s = "[warn]:";
         break;
     case 3:
-        strcpy(s, "[error]:");
+        s = "[error]:";
         break;
     default:
-        strcpy(s, "[info]:");
+        s = "[info]:";
         break;
     }
-    // Write a log, for m_count+,m_split_lines maximum number of lines
-    m_mutex.lock();
-    m_count++;
 
-    // first conditon is to chacke if today is not the same day
-    // second condion is to check if file is filled completely as we have to make a new one
-    if (m_today != my_tm.tm_mday || m_count % m_split_line == 0)
-    {
-        char new_log[255] = {0};
-        fflush(m_fp); // flush the today fp stream
-        fclose(m_fp); // close the today file
-        char tail[16] = {0};
+    char *buf = line_buffer();
+
+    // it adds current time and other info and level
+    int n = snprintf(buf, 64, "%.*s.%06ld %s", t_date_len, t_date, now.tv_usec, s);
 
-        snprintf(tail, 16, "%d_%02d_%02d_", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday);
+    // va_list is a type used for handling variable arguments
+    va_list valst;
+    va_start(valst, format); // Means that all arguments after format are stored in valst.
+    // add the user message
+    int m = vsnprintf(buf + n, m_log_buf_size - n - 1, format, valst);
+    va_end(valst); // clear the args list
+    if (m < 0)
+        m = 0;
+    if (m > m_log_buf_size - n - 2)
+        m = m_log_buf_size - n - 2; // truncated line
+    buf[n + m] = '\n'; // add new line charactor
+    commit(level, buf, n + m + 1);
+}
 
-        // first condion
-        if (m_today != my_tm.tm_mday)
+void LOG::commit(int level, const char *buf, size_t len)
+{
+    if (m_is_async) // this check if we have to write asynchronisoly
+    {
+        LOG_RING *r = ring();
+        if (!r->push(buf, len))
         {
-            snprintf(new_log, 255, "%s%s%s", dir_name, tail, log_name);
-            m_today = my_tm.tm_mday;
-            m_count = 0;
+            ++m_dropped;
+            wake();
         }
-        else // 2nd condition
-            snprintf(new_log, 255, "%s%s%s.%lld", dir_name, tail, log_name, m_count / m_split_line);
-        m_fp = fopen(new_log, "a");
+        // errors go out at once, and a filling ring is drained before it overflows
+        else if (level >= 3 || r->used() > r->size() / 2)
+            wake();
     }
-    m_mutex.unlock();
+    else // just directly write to file i.e synchronously
+    {
+        m_mutex.lock();
+        // never rotate here: the archiver thread swaps the file, this line may still go to the old one
+        if (++m_count / m_split_line != m_part || time(NULL) >= m_day_end)
+            m_archiver.request();
+        write_formats();
+        struct iovec iov = {(void *)buf, len};
+        write_all(&iov, 1);
+        m_mutex.unlock();
+    }
+}
 
-    // va_list is a type used for handling variable arguments
-    va_list valst;
-    va_start(valst, format); // Means that all arguments after format are stored in valst.
+void LOG::rotate(int lines)
+{
+    time_t t = time(NULL);
 
-    string log_str;
+    // first conditon is to chacke if today is not the same day
+    // second condion is to check if file is filled completely as we have to make a new one
     m_mutex.lock();
+    m_count += lines;
+    bool new_day = t >= m_day_end;
+    if (new_day)
+        m_count = lines;
+    long long part = m_count / m_split_line;
+    bool due = new_day || part != m_part;
+    m_mutex.unlock();
+    if (!due)
+        return;
 
-    // it adds current time and other info and level
-    int n = snprintf(m_buf, 48, "%d-%02d-%02d %02d:%02d:%02d.%06ld %s", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec, now.tv_usec, s);
+    struct tm my_tm;
+    localtime_r(&t, &my_tm);
+    char new_log[256] = {0};
+    char tail[16] = {0};
+    snprintf(tail, 16, "%d_%02d_%02d_", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday);
+    if (part == 0)
+        snprintf(new_log, 255, "%s%s%s", dir_name, tail, log_name);
+    else
+        snprintf(new_log, 255, "%s%s%s.%lld", dir_name, tail, log_name, part);
 
-    // add the user message
-    int m = vsnprintf(m_buf + n, m_log_buf_size - n - 1, format, valst);
+    // the slow part (open, and the binary session header) happens before taking the lock
+    int fd = open_file(new_log);
+    if (fd == -1)
+        return; // keep writing to the old file rather than losing lines
 
-    m_buf[n + m] = '\n';     // add new line charactor
-    m_buf[n + m + 1] = '\0'; // add end charactor
-    log_str = m_buf;
+    m_mutex.lock();
+    int old_fd = m_fd;
+    string old_path = m_path;
+    m_fd = fd;
+    strcpy(m_path, new_log);
+    m_part = part;
+    m_day_end = day_end(t);
+    m_formats_written = 0; // the new file describes every format again
+    m_mutex.unlock();
+
+    m_archiver.retire(old_fd, old_path, new_log);
+}
+
+void LOG::write_all(struct iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t n = writev(m_fd, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return; // disk full or similar, nothing sensible to do but drop
+        }
+        // skip what was written, resume in the middle of a partially written slice
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
 
+void LOG::drain()
+{
+    m_mutex.lock();
+    vector<LOG_RING *> rings = m_rings;
     m_mutex.unlock();
 
-    if (m_is_async && !m_log_queue->full()) // this check if we have to write asynchronisoly
+    vector<struct iovec> iov(rings.size() * 2);
+    vector<size_t> taken(rings.size());
+    vector<size_t> records(rings.size());
+    vector<LOG_RING *> retired;
+    int count = 0;
+    size_t lines = 0;
+    for (size_t i = 0; i < rings.size(); i++)
     {
-        m_log_queue->push(log_str); // add to buffer as a producer
+        // checked before peek(): a ring retired by then is fully drained by this pass
+        if (rings[i]->retired())
+            retired.push_back(rings[i]);
+        int slices;
+        taken[i] = rings[i]->peek(&iov[count], slices, records[i]);
+        lines += records[i];
+        count += slices;
     }
-    else // just directly write to file i.e synchronously
+
+    if (count > 0)
     {
+        rotate(lines);
+        // every format used by the peeked records was registered before they were pushed
         m_mutex.lock();
-        fputs(log_str.c_str(), m_fp);
+        write_formats();
         m_mutex.unlock();
+        write_all(iov.data(), count);
+        for (size_t i = 0; i < rings.size(); i++)
+            rings[i]->consume(taken[i], records[i]);
     }
-    va_end(valst); // clear the args list
+
+    if (!retired.empty())
+    {
+        m_mutex.lock();
+        for (LOG_RING *r : retired)
+            m_rings.erase(find(m_rings.begin(), m_rings.end(), r));
+        m_mutex.unlock();
+        for (LOG_RING *r : retired)
+            delete r;
+    }
+
+    long long dropped = m_dropped.exchange(0);
+    if (dropped > 0)
+        LOG_WARN("log rings full, %lld line(s) dropped", dropped); // written on the next pass
 }
 
-void LOG::flush(void)
+void *LOG::async_write_log()
 {
     m_mutex.lock();
-    fflush(m_fp);
+    while (!m_stop)
+    {
+        if (!m_wake.exchange(false))
+        {
+            struct timespec t;
+            clock_gettime(CLOCK_REALTIME, &t);
+            t.tv_nsec += FLUSH_INTERVAL_MS * 1000000L;
+            t.tv_sec += t.tv_nsec / 1000000000L;
+            t.tv_nsec %= 1000000000L;
+            m_cond.timewait(m_mutex.get(), t);
+            m_wake = false;
+        }
+        m_mutex.unlock();
+        drain();
+        m_mutex.lock();
+    }
     m_mutex.unlock();
-}
\ No newline at end of file
+    drain(); // whatever was logged before the stop request
+    return NULL;
+}
+
+void LOG::flush(void)
+{
+    if (m_is_async)
+        wake();
+}
+
+void LOG::set_level(int module, int level)
+{
+    for (int i = 0; i < LOG_MOD_COUNT; i++)
+    {
+        if (module == -1 || module == i)
+            s_level[i].store(level, std::memory_order_relaxed);
+    }
+}
+
+int LOG::module_id(const string &name)
+{
+    for (int i = 0; i < LOG_MOD_COUNT; i++)
+    {
+        if (name == module_names[i])
+            return i;
+    }
+    return -1;
+}
+
+int LOG::level_id(const string &name)
+{
+    for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_OFF; i++)
+    {
+        if (name == level_names[i])
+            return i;
+    }
+    return -1;
+}
+
+string LOG::levels()
+{
+    string out;
+    for (int i = 0; i < LOG_MOD_COUNT; i++)
+        out += string(module_names[i]) + "=" + level_names[get_level(i)] + "\n";
+    return out;
+}
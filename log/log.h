@@ -7,13 +7,75 @@
 #include <cstring>
 #include <stdarg.h>
 #include <pthread.h>
-#include "./block_queue.h"
+#include <atomic>
+#include <vector>
+#include "../lock/locker.h"
+#include "./log_ring.h"
+#include "./log_binary.h"
+#include "./log_archiver.h"
 
 using namespace std;
 
+/**
+ * @enum LOG_LEVEL
+ * @brief Severity of a log line
+ */
+enum LOG_LEVEL
+{
+    LOG_LEVEL_DEBUG = 0, ///< Per-request/per-event detail
+    LOG_LEVEL_INFO,      ///< Lifecycle events
+    LOG_LEVEL_WARN,      ///< Recoverable problems
+    LOG_LEVEL_ERROR,     ///< Failures
+    LOG_LEVEL_OFF        ///< Runtime level that silences a module
+};
+
+/**
+ * @enum LOG_MODULE_ID
+ * @brief Subsystems with their own runtime level
+ * @note A translation unit picks its module by defining LOG_MODULE before its first include
+ */
+enum LOG_MODULE_ID
+{
+    LOG_MOD_CORE = 0, ///< Server, event loop, timers
+    LOG_MOD_HTTP,     ///< Request parsing and responses
+    LOG_MOD_SQL,      ///< Database pool, async client, user store
+    LOG_MOD_ACCESS,   ///< Per-request access records (ACCESS_LOG)
+    LOG_MOD_COUNT
+};
+
+/**
+ * @def LOG_MIN_LEVEL
+ * @brief Compile-time floor: calls below it are compiled away, arguments included
+ * @note Set with `make LOG_MIN_LEVEL=1`
+ */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MOD_CORE
+#endif
+
 /**
  * @class LOG
- * @brief Thread-safe logging system with asynchronous/synchronous modes and log rotation
+ * @brief Logging system with asynchronous/synchronous modes and log rotation
+ *
+ * Asynchronous mode: every logging thread formats into its own LOG_RING without any lock and
+ * a single writer thread drains all rings with one writev() per pass. The writer runs on a
+ * timer (FLUSH_INTERVAL_MS) and is woken early by ERROR lines and by rings filling up, so
+ * error lines reach the file at once. Lines that do not fit a full ring are dropped and
+ * counted rather than blocking the caller.
+ *
+ * Synchronous mode: the line is written with a single write() to the file descriptor.
+ *
+ * Rotation (new day, or m_split_line lines) is a file swap: the next file is opened off the
+ * logging path (writer thread in async mode, LOG_ARCHIVER thread in sync mode, where a file
+ * may then run a few lines over m_split_line) and replaces m_fd under m_mutex. The old file
+ * goes to LOG_ARCHIVER for closing, compression and retention.
+ *
+ * Binary mode (either of the above): the LOG_* macros skip formatting altogether and store a
+ * format id, the raw clock and the raw arguments (see log_binary.h); `make log_decoder`
+ * builds the tool turning such files back into text.
  */
 class LOG
 {
@@ -23,13 +85,42 @@ private:
     int m_split_line;   // maximum number of log lines
     int m_log_buf_size; // log buffer size
     long long m_count;  // log line count
-    int m_today;        // Because it is calssified by day the current time is recorded on that day
-    FILE *m_fp;         // Open the log file pointer
-    char *m_buf;
-    block_queue<string> *m_log_queue; // Blocking Queue
-    bool m_is_async;                  // wherether syncronous or asynchronous
-    LOCKER m_mutex;                   // locker
-    int m_close_log;                  // close logging
+    long long m_part;   // m_count / m_split_line when the current file was opened (its ".N" suffix)
+    time_t m_day_end;   // Local midnight ending the current file's day
+    char m_path[256];   // Current file name
+    int m_fd;           // Open log file descriptor
+    bool m_is_async;    // wherether syncronous or asynchronous
+    LOCKER m_mutex;     // guards m_rings, the file (sync mode) and m_cond
+    int m_close_log;    // close logging
+
+    size_t m_ring_size;                ///< Capacity of each per-thread ring (bytes)
+    vector<LOG_RING *> m_rings;        ///< One ring per live thread that has logged, plus retired ones not drained yet
+
+    /**
+     * @struct RING_OWNER
+     * @brief Holds a thread's ring and retires it when the thread exits; the writer then
+     *        drains the last lines and frees it (short-lived threads would leak one each)
+     */
+    struct RING_OWNER
+    {
+        LOG_RING *ring = NULL;
+        ~RING_OWNER();
+    };
+    static thread_local RING_OWNER t_ring; ///< The calling thread's ring
+    pthread_t m_writer;                ///< Writer thread draining the rings
+    CONDITION m_cond;                  ///< Wakes the writer before its timer
+    std::atomic<bool> m_wake;          ///< A flush was requested since the last pass
+    bool m_stop;                       ///< Tells the writer to drain and exit
+    bool m_writing;                    ///< The writer thread is running
+    std::atomic<long long> m_dropped;  ///< Lines lost to full rings
+
+    bool m_binary;                       ///< Binary records instead of text lines
+    vector<pair<int, string>> m_formats; ///< Registered (level, format), index is the id; m_mutex
+    size_t m_formats_written;            ///< Formats already described in the current file
+
+    LOG_ARCHIVER m_archiver; ///< Closes, compresses and expires rotated files
+
+    static std::atomic<int> s_level[LOG_MOD_COUNT]; ///< Runtime level of each module
 
 private:
     /**
@@ -37,29 +128,58 @@ private:
      */
     LOG();
     /**
-     * @brief Destructor - releases resources
+     * @brief Destructor - drains the rings and releases resources
      */
     virtual ~LOG();
     /**
      * @brief Asynchronous log writer (consumer thread)
      * @return void* (pthread-compatible)
      * @details
-     * - Continuously pops messages from m_log_queue
-     * - Writes to file with mutex protection
-     * - Terminates when queue is empty and closed
+     * - Sleeps until the flush timer expires or a flush is requested
+     * - Gathers the pending bytes of every ring into one writev()
+     * - Terminates after a final drain once m_stop is set
      */
-    void *async_write_log()
-    {
-        string single_log;
-
-        while (m_log_queue->pop(single_log))
-        {
-            m_mutex.lock();
-            fputs(single_log.c_str(), m_fp); // write the string poped from blocking queue to the file using file pointer
-            m_mutex.unlock();
-        }
-        return NULL;
-    }
+    void *async_write_log();
+    /**
+     * @brief Write every byte queued in the rings, then free the retired ones
+     */
+    void drain();
+    /**
+     * @brief Write a buffer/iovec list completely, retrying partial writes
+     */
+    void write_all(struct iovec *iov, int count);
+    /**
+     * @brief Swap files when the day changed or m_split_line lines were written
+     * @param lines Lines about to be written (0 when only checking)
+     * @note Called without m_mutex by the writer thread (async) or the archiver thread (sync)
+     */
+    void rotate(int lines);
+    /**
+     * @brief The calling thread's ring, created and registered on first use
+     */
+    LOG_RING *ring();
+    /**
+     * @brief Ask the writer for an early pass
+     */
+    void wake();
+    /**
+     * @brief Open (append) a log file, starting a binary session in it if needed
+     * @return File descriptor, -1 on failure
+     */
+    int open_file(const char *path);
+    /**
+     * @brief Write the 'F' records of formats registered since the last call
+     * @note Called with m_mutex held by whoever owns the file
+     */
+    void write_formats();
+    /**
+     * @brief The calling thread's scratch buffer, m_log_buf_size bytes
+     */
+    char *line_buffer();
+    /**
+     * @brief Queue (async) or write (sync) one finished line or binary record
+     */
+    void commit(int level, const char *buf, size_t len);
 
 public:
     /**
@@ -85,12 +205,18 @@ public:
      * @brief Initialize logging system
      * @param filename Base path/filename for logs
      * @param close_log 0=enable, 1=disable
-     * @param log_buf_size Format buffer size (default: 8192)
+     * @param log_buf_size Longest line in bytes (default: 8192)
      * @param split_lines Max lines per file (default: 5M)
-     * @param max_queue_size Async mode if >0 (0=sync)
+     * @param max_queue_size Async mode if >0 (0=sync), each thread's ring then holds about
+     *        this many lines
+     * @param binary Write binary records to "<filename>.bin" instead of text
+     * @param compress gzip rotated files
+     * @param keep_files Rotated files kept, oldest deleted first (0: unlimited)
+     * @param keep_bytes Total size of rotated files kept (0: unlimited)
      * @return bool True if initialization succeeded
      */
-    bool init(const char *filename, int close_log, int log_buf_size = 8192, int split_lines = 5000000, int max_queue_size = 0);
+    bool init(const char *filename, int close_log, int log_buf_size = 8192, int split_lines = 5000000, int max_queue_size = 0, bool binary = false,
+              bool compress = false, int keep_files = 0, long long keep_bytes = 0);
 
     /**
      * @brief Write formatted log message
@@ -99,64 +225,156 @@ public:
      * @param ... Variable arguments for format
      * @details
      * - Adds timestamp and log level prefix
-     * - For async: Enqueues message
+     * - For async: Appends to the calling thread's ring, lock-free
      * - For sync: Direct write with mutex
      * - Handles log file rotation
      */
     void write_log(int level, const char *format, ...);
 
     /**
-     * @brief Flush buffers to disk
-     * @note Thread-safe forced flush
+     * @brief Whether the LOG_* macros must use write_binary()
+     */
+    bool is_binary() const
+    {
+        return m_binary;
+    }
+
+    /**
+     * @brief Assign an id to a format string (once per call site, see the LOG_* macros)
+     * @return Id to pass to write_binary()
+     */
+    static int register_format(int level, const char *format);
+
+    /**
+     * @brief Write one binary record: format id, raw clock and raw arguments
+     * @param level Log level, only used to wake the writer on errors
+     * @param id Id from register_format()
+     * @details Arguments are encoded by their static type, strings are copied; the record is
+     *          cut at m_log_buf_size like a text line
+     */
+    template <typename... Args>
+    void write_binary(int level, int id, Args... args)
+    {
+        if (m_fd == -1)
+            return;
+
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        uint32_t fmt_id = id;
+        uint64_t ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+        char *rec = line_buffer();
+        rec[0] = 'L';
+        memcpy(rec + 1, &fmt_id, sizeof(fmt_id));
+        memcpy(rec + 5, &ns, sizeof(ns));
+        BINLOG_WRITER w(rec + BINLOG_HEADER, m_log_buf_size - BINLOG_HEADER);
+        (w.arg(args), ...);
+        uint32_t len = w.pos() - (rec + BINLOG_HEADER);
+        memcpy(rec + 13, &len, sizeof(len));
+
+        commit(level, rec, BINLOG_HEADER + len);
+    }
+
+    /**
+     * @brief Runtime filter used by the LOG_* macros before any formatting happens
+     * @return true if @p level passes the current level of @p module
+     */
+    static bool enabled(int level, int module)
+    {
+        return level >= s_level[module].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Change the runtime level of a module, takes effect immediately on every thread
+     * @param module LOG_MODULE_ID, or -1 for every module
+     * @param level LOG_LEVEL
+     */
+    static void set_level(int module, int level);
+
+    /**
+     * @brief Current runtime level of a module
+     */
+    static int get_level(int module)
+    {
+        return s_level[module].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Module id from its name ("core", "http", "sql", "access"), -1 if unknown
+     */
+    static int module_id(const string &name);
+
+    /**
+     * @brief Level from its name ("debug", "info", "warn", "error", "off"), -1 if unknown
+     */
+    static int level_id(const string &name);
+
+    /**
+     * @brief Render every module's level as "module=level" lines
+     */
+    static string levels();
+
+    /**
+     * @brief Have the writer thread write out everything queued so far
+     * @note Does not wait; no-op in synchronous mode, where nothing is buffered
      */
     void flush(void);
 };
 
+/**
+ * @def LOG_ENABLED(level)
+ * @brief Whether a line of @p level from the current LOG_MODULE would be written
+ * @note The first test is a compile-time constant, so calls below LOG_MIN_LEVEL vanish
+ */
+#define LOG_ENABLED(level) \
+    ((level) >= LOG_MIN_LEVEL && 0 == m_close_log && LOG::enabled(level, LOG_MODULE))
+
+/**
+ * @def LOG_WRITE(level, format, ...)
+ * @brief Filter, then write a text line or a binary record
+ * @note In binary mode the format is registered once per call site (function-local static)
+ */
+#define LOG_WRITE(level, format, ...)                                               \
+    if (LOG_ENABLED(level))                                                         \
+    {                                                                               \
+        if (LOG::get_instance()->is_binary())                                       \
+        {                                                                           \
+            static const int log_format_id = LOG::register_format(level, format);   \
+            LOG::get_instance()->write_binary(level, log_format_id, ##__VA_ARGS__); \
+        }                                                                           \
+        else                                                                        \
+            LOG::get_instance()->write_log(level, format, ##__VA_ARGS__);           \
+    }
+
 /**
  * @def LOG_DEBUG(format, ...)
  * @brief Debug-level log (level 0)
- * @note Disabled if m_close_log != 0
+ * @note Disabled if m_close_log != 0 or below the module's level; arguments are not evaluated then
  */
-#define LOG_DEBUG(format, ...)                                    \
-    if (0 == m_close_log)                                         \
-    {                                                             \
-        LOG::get_instance()->write_log(0, format, ##__VA_ARGS__); \
-        LOG::get_instance()->flush();                             \
-    }
+#define LOG_DEBUG(format, ...) \
+    LOG_WRITE(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
 
 /**
  * @def LOG_INFO(format, ...)
- * @brief Debug-level log (level 0)
- * @note Disabled if m_close_log != 0
+ * @brief Info-level log (level 1)
+ * @note Disabled if m_close_log != 0 or below the module's level
  */
-#define LOG_INFO(format, ...)                                     \
-    if (0 == m_close_log)                                         \
-    {                                                             \
-        LOG::get_instance()->write_log(1, format, ##__VA_ARGS__); \
-        LOG::get_instance()->flush();                             \
-    }
+#define LOG_INFO(format, ...) \
+    LOG_WRITE(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
 
 /**
  * @def LOG_WARN(format, ...)
- * @brief Debug-level log (level 0)
- * @note Disabled if m_close_log != 0
+ * @brief Warn-level log (level 2)
+ * @note Disabled if m_close_log != 0 or below the module's level
  */
-#define LOG_WARN(format, ...)                                     \
-    if (0 == m_close_log)                                         \
-    {                                                             \
-        LOG::get_instance()->write_log(2, format, ##__VA_ARGS__); \
-        LOG::get_instance()->flush();                             \
-    }
+#define LOG_WARN(format, ...) \
+    LOG_WRITE(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
 /**
  * @def LOG_ERROR(format, ...)
  * @brief Error-level log (level 3)
- * @note Always flushes immediately
+ * @note Wakes the writer thread so the line reaches the file at once
  */
-#define LOG_ERROR(format, ...)                                    \
-    if (0 == m_close_log)                                         \
-    {                                                             \
-        LOG::get_instance()->write_log(3, format, ##__VA_ARGS__); \
-        LOG::get_instance()->flush();                             \
-    }
+#define LOG_ERROR(format, ...) \
+    LOG_WRITE(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
 
 #endif
\ No newline at end of file
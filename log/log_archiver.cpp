@@ -0,0 +1,254 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <zlib.h>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include "log_archiver.h"
+
+static const int TICK_MS = 1000;          ///< Period of tick() and of the retention scan
+static const size_t GZIP_CHUNK = 1 << 16; ///< Read size while compressing
+static const int MAX_ARCHIVE_SUFFIX = 999;  ///< Last N tried for "<file>.N.gz"
+
+bool LOG_ARCHIVER::start(const string &dir, const string &name, const string &current, bool compress, int keep_files, long long keep_bytes, function<void()> tick)
+{
+    m_dir = dir;
+    m_name = name;
+    m_current = current;
+    m_compress = compress;
+    m_keep_files = keep_files;
+    m_keep_bytes = keep_bytes;
+    m_tick = tick;
+    m_running = pthread_create(&m_thread, NULL, worker, this) == 0;
+    return m_running;
+}
+
+void LOG_ARCHIVER::retire(int fd, const string &path, const string &current)
+{
+    if (!m_running)
+    {
+        close(fd); // no thread (start() failed): at least do not leak the descriptor
+        return;
+    }
+    m_lock.lock();
+    m_jobs.push_back(RETIRED{fd, path});
+    m_current = current;
+    m_cond.signal();
+    m_lock.unlock();
+}
+
+void LOG_ARCHIVER::request()
+{
+    m_lock.lock();
+    m_wake = true;
+    m_cond.signal();
+    m_lock.unlock();
+}
+
+void LOG_ARCHIVER::stop()
+{
+    if (!m_running)
+        return;
+    m_lock.lock();
+    m_stop = true;
+    m_cond.signal();
+    m_lock.unlock();
+    pthread_join(m_thread, NULL);
+    m_running = false;
+}
+
+void *LOG_ARCHIVER::worker(void *arg)
+{
+    // only this thread: on Linux a tid is a valid PRIO_PROCESS target
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#ifdef SCHED_IDLE
+    struct sched_param param = {0};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    ((LOG_ARCHIVER *)arg)->run();
+    return NULL;
+}
+
+void LOG_ARCHIVER::run()
+{
+    m_lock.lock();
+    string current = m_current;
+    m_lock.unlock();
+    expire(current); // leftovers of earlier runs
+
+    m_lock.lock();
+    while (true)
+    {
+        if (m_jobs.empty() && !m_wake && !m_stop)
+        {
+            struct timespec t;
+            clock_gettime(CLOCK_REALTIME, &t);
+            t.tv_sec += TICK_MS / 1000;
+            m_cond.timewait(m_lock.get(), t);
+        }
+        bool stop = m_stop && m_jobs.empty();
+        m_wake = false;
+        deque<RETIRED> jobs;
+        jobs.swap(m_jobs);
+        current = m_current;
+        m_lock.unlock();
+
+        if (m_tick && !stop)
+            m_tick();
+        for (RETIRED &job : jobs)
+        {
+            close(job.fd);
+            if (m_compress)
+                compress(job.path);
+        }
+        if (!jobs.empty())
+            expire(current);
+
+        if (stop)
+            return;
+        m_lock.lock();
+    }
+}
+
+bool LOG_ARCHIVER::compress(const string &path)
+{
+    int in = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1)
+        return false;
+    string tmp = path + ".gz.tmp";
+    gzFile out = gzopen(tmp.c_str(), "wb6");
+    if (out == NULL)
+    {
+        close(in);
+        return false;
+    }
+
+    vector<char> buf(GZIP_CHUNK);
+    bool ok = true;
+    ssize_t n;
+    while ((n = read(in, buf.data(), buf.size())) > 0)
+    {
+        if (gzwrite(out, buf.data(), n) != n)
+        {
+            ok = false;
+            break;
+        }
+    }
+    ok = ok && n == 0;
+    close(in);
+    ok = gzclose(out) == Z_OK && ok;
+
+    // the plain file is only removed once the archive is complete
+    if (ok && publish(tmp, path))
+        return unlink(path.c_str()) == 0;
+    unlink(tmp.c_str());
+    return false;
+}
+
+bool LOG_ARCHIVER::publish(const string &tmp, const string &path)
+{
+    // link() fails with EEXIST where rename() would replace: an archive left by an earlier
+    // run (a restart the same day, a day whose file was reopened) is kept
+    if (link(tmp.c_str(), (path + ".gz").c_str()) == 0)
+    {
+        unlink(tmp.c_str());
+        return true;
+    }
+    if (errno != EEXIST)
+        return false;
+
+    // "<base>.N.gz" with a free N, <base> being the path without its own ".N" so that the
+    // name stays one that expire() recognises
+    string base = path;
+    size_t dot = base.find_last_of("./");
+    if (dot != string::npos && base[dot] == '.' && dot + 1 < base.size() &&
+        base.find_first_not_of("0123456789", dot + 1) == string::npos)
+        base.erase(dot);
+    for (int n = 1; n <= MAX_ARCHIVE_SUFFIX; n++)
+    {
+        string name = base + "." + std::to_string(n) + ".gz";
+        if (link(tmp.c_str(), name.c_str()) == 0)
+        {
+            unlink(tmp.c_str());
+            return true;
+        }
+        if (errno != EEXIST)
+            return false;
+    }
+    errno = EEXIST;
+    return false;
+}
+
+/**
+ * @brief Whether @p file is "YYYY_MM_DD_<name>" optionally followed by ".N" and/or ".gz"
+ */
+static bool is_rotated(const char *file, const string &name)
+{
+    if (strlen(file) < 11 || file[4] != '_' || file[7] != '_' || file[10] != '_')
+        return false;
+    const char *p = file + 11;
+    if (strncmp(p, name.c_str(), name.size()) != 0)
+        return false;
+    p += name.size();
+    if (p[0] == '.' && isdigit((unsigned char)p[1]))
+    {
+        p++;
+        while (isdigit((unsigned char)*p))
+            p++;
+    }
+    return strcmp(p, "") == 0 || strcmp(p, ".gz") == 0;
+}
+
+void LOG_ARCHIVER::expire(const string &current)
+{
+    if (m_keep_files <= 0 && m_keep_bytes <= 0)
+        return;
+
+    DIR *dir = opendir(m_dir.empty() ? "." : m_dir.c_str());
+    if (dir == NULL)
+        return;
+    struct FILE_INFO
+    {
+        string path;
+        time_t mtime;
+        long long size;
+    };
+    vector<FILE_INFO> files;
+    long long total = 0;
+    while (struct dirent *e = readdir(dir))
+    {
+        if (!is_rotated(e->d_name, m_name))
+            continue;
+        string path = m_dir + e->d_name;
+        struct stat st;
+        if (path == current || stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        files.push_back(FILE_INFO{path, st.st_mtime, (long long)st.st_size});
+        total += st.st_size;
+    }
+    closedir(dir);
+
+    // oldest first
+    sort(files.begin(), files.end(), [](const FILE_INFO &a, const FILE_INFO &b)
+         { return a.mtime < b.mtime || (a.mtime == b.mtime && a.path < b.path); });
+    size_t count = files.size();
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        bool too_many = m_keep_files > 0 && count > (size_t)m_keep_files;
+        bool too_big = m_keep_bytes > 0 && total > m_keep_bytes;
+        if (!too_many && !too_big)
+            break;
+        if (unlink(files[i].path.c_str()) == 0)
+        {
+            count--;
+            total -= files[i].size;
+        }
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ * NOTE:
+ * Everything slow about rotation happens on this thread, never on a logging thread:
+ * - close() of the file LOG swapped out (can block on some file systems)
+ * - gzip compression of it ("<file>.gz", written to "<file>.gz.tmp" and linked in place;
+ *   an archive of that name is never replaced, the next free "<file>.N.gz" is taken)
+ * - retention: the oldest rotated files are deleted until at most keep_files of them and
+ *   keep_bytes bytes remain (the file being written never counts and is never touched)
+ * - in synchronous mode, the rotation itself (LOG asks through tick())
+ *
+ * The thread runs at the lowest priority (nice 19 and SCHED_IDLE where allowed) so gzip
+ * only uses otherwise idle CPU.
+ */
+
+#ifndef LOG_ARCHIVER_H
+#define LOG_ARCHIVER_H
+
+#include <string>
+#include <deque>
+#include <functional>
+#include <pthread.h>
+#include "../lock/locker.h"
+
+using namespace std;
+
+/**
+ * @class LOG_ARCHIVER
+ * @brief Low-priority thread closing, compressing and expiring rotated log files
+ */
+class LOG_ARCHIVER
+{
+private:
+    /**
+     * @struct RETIRED
+     * @brief A file LOG no longer writes to
+     */
+    struct RETIRED
+    {
+        int fd;      ///< Still open, closed by the archiver
+        string path; ///< Its name
+    };
+
+    string m_dir;           ///< Directory of the log files ("" for the working directory)
+    string m_name;          ///< Base name, files are "YYYY_MM_DD_<name>[.N][.gz]"
+    bool m_compress;        ///< gzip retired files
+    int m_keep_files;       ///< Rotated files kept (0: unlimited)
+    long long m_keep_bytes; ///< Bytes of rotated files kept (0: unlimited)
+    function<void()> m_tick; ///< Called about once a second and on request()
+
+    deque<RETIRED> m_jobs; ///< Retired files waiting
+    string m_current;      ///< Newest file, excluded from retention
+    LOCKER m_lock;         ///< Guards m_jobs, m_current, m_wake, m_stop
+    CONDITION m_cond;      ///< Wakes the thread
+    bool m_wake;           ///< tick() was requested
+    bool m_stop;           ///< Finish the queue and exit
+    bool m_running;        ///< The thread was started
+    pthread_t m_thread;
+
+    static void *worker(void *arg);
+    void run();
+    /**
+     * @brief gzip @p path next to itself and remove it
+     * @return false if it stays as it was (the plain file is kept)
+     */
+    bool compress(const string &path);
+    /**
+     * @brief Give the finished archive @p tmp of @p path its name, never replacing a file
+     */
+    bool publish(const string &tmp, const string &path);
+    /**
+     * @brief Delete the oldest rotated files beyond the retention limits
+     * @param current File being written, excluded
+     */
+    void expire(const string &current);
+
+public:
+    LOG_ARCHIVER() : m_compress(false), m_keep_files(0), m_keep_bytes(0), m_wake(false), m_stop(false), m_running(false) {}
+    ~LOG_ARCHIVER() { stop(); }
+
+    /**
+     * @brief Start the thread
+     * @param dir Log directory, with its trailing '/' ("" for the working directory)
+     * @param name Base file name
+     * @param current File being written, excluded from retention
+     * @param compress gzip rotated files
+     * @param keep_files Rotated files kept (0: unlimited)
+     * @param keep_bytes Bytes of rotated files kept (0: unlimited)
+     * @param tick Periodic callback (about once a second, and on request())
+     */
+    bool start(const string &dir, const string &name, const string &current, bool compress, int keep_files, long long keep_bytes, function<void()> tick);
+
+    /**
+     * @brief Hand over a file that was just swapped out
+     * @param current Its successor, excluded from retention
+     */
+    void retire(int fd, const string &path, const string &current);
+
+    /**
+     * @brief Run tick() as soon as possible
+     */
+    void request();
+
+    /**
+     * @brief Finish pending work and join the thread
+     */
+    void stop();
+};
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * NOTE:
+ * Binary log format (native byte order, read back with `make log_decoder`):
+ *
+ *   'M' "CSBLOG1"                                   session start: forget every format id
+ *   'F' u32 id, u8 level, u32 len, char[len]         format string registered under id
+ *   'L' u32 id, u64 unix time ns, u32 len, args[len] one log call
+ *
+ * Each argument is a tag byte followed by its raw value:
+ *   'i' i64, 'u' u64, 'd' double, 'p' u64 address, 's' u32 len + char[len]
+ *
+ * A log call therefore costs a clock read and a few memcpy: no localtime, no snprintf of the
+ * timestamp and no vsnprintf. The decoder replays the printf formatting offline. 'F' records
+ * are written by the file owner ahead of any record using them and again at the start of
+ * every file, so each file decodes on its own.
+ */
+
+#ifndef LOG_BINARY_H
+#define LOG_BINARY_H
+
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+
+static const char BINLOG_MAGIC[] = "CSBLOG1";       ///< Payload of the 'M' record
+static const size_t BINLOG_HEADER = 1 + 4 + 8 + 4; ///< Size of an 'L' record header
+
+/**
+ * @class BINLOG_WRITER
+ * @brief Appends tagged arguments to a fixed buffer, silently truncating at its end
+ */
+class BINLOG_WRITER
+{
+private:
+    char *m_p;   ///< Next free byte
+    char *m_end; ///< End of the buffer
+    bool m_full; ///< An argument did not fit, the remaining ones are dropped
+
+    bool put(char tag, const void *value, size_t len)
+    {
+        if (m_full || (size_t)(m_end - m_p) < 1 + len)
+        {
+            m_full = true;
+            return false;
+        }
+        *m_p++ = tag;
+        memcpy(m_p, value, len);
+        m_p += len;
+        return true;
+    }
+
+public:
+    BINLOG_WRITER(char *buf, size_t size) : m_p(buf), m_end(buf + size), m_full(false) {}
+
+    /**
+     * @brief Current write position
+     */
+    char *pos() const
+    {
+        return m_p;
+    }
+
+    /**
+     * @brief Encode one argument according to its static type
+     */
+    template <typename T>
+    void arg(T value)
+    {
+        if constexpr (std::is_integral<T>::value || std::is_enum<T>::value)
+        {
+            if constexpr (std::is_enum<T>::value || std::is_signed<T>::value)
+            {
+                int64_t v = (int64_t)value;
+                put('i', &v, sizeof(v));
+            }
+            else
+            {
+                uint64_t v = (uint64_t)value;
+                put('u', &v, sizeof(v));
+            }
+        }
+        else if constexpr (std::is_floating_point<T>::value)
+        {
+            double v = value;
+            put('d', &v, sizeof(v));
+        }
+        else if constexpr (std::is_convertible<T, const char *>::value)
+        {
+            const char *s = value ? (const char *)value : "(null)";
+            uint32_t len = strlen(s);
+            size_t room = m_end - m_p;
+            if (room < 1 + sizeof(len) + len)
+                len = room > 1 + sizeof(len) ? room - 1 - sizeof(len) : 0; // truncate long strings
+            if (put('s', &len, sizeof(len)))
+            {
+                memcpy(m_p, s, len);
+                m_p += len;
+            }
+        }
+        else
+        {
+            static_assert(std::is_pointer<T>::value, "unsupported log argument type");
+            uint64_t v = (uint64_t)(uintptr_t)value;
+            put('p', &v, sizeof(v));
+        }
+    }
+};
+
+#endif
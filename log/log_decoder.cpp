@@ -0,0 +1,289 @@
+/**
+ * NOTE:
+ * Offline decoder of the binary log (see log_binary.h), built with `make log_decoder`:
+ *
+ *   ./log_decoder 2025_01_31_ServerLog.bin > ServerLog.txt
+ *   cat *_ServerLog.bin* | ./log_decoder
+ *
+ * Every record is printed the way text mode would have written it. The format string is
+ * replayed conversion by conversion with snprintf; integer conversions are widened to
+ * long long because arguments are stored as 64-bit values whatever their C type was.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "log_binary.h"
+
+using namespace std;
+
+/**
+ * @struct ARG
+ * @brief One decoded argument
+ */
+struct ARG
+{
+    char tag;  ///< 'i', 'u', 'd', 'p' or 's'
+    int64_t i; ///< 'i'
+    uint64_t u; ///< 'u' and 'p'
+    double d;  ///< 'd'
+    string s;  ///< 's'
+
+    long long as_int() const
+    {
+        return tag == 'd' ? (long long)d : tag == 'i' ? (long long)i : (long long)u;
+    }
+    double as_double() const
+    {
+        return tag == 'd' ? d : tag == 'i' ? (double)i : (double)u;
+    }
+};
+
+static const char *level_names[] = {"[debug]:", "[info]:", "[warn]:", "[error]:"};
+
+/**
+ * @brief Read exactly @p len bytes, false at end of input or on a cut record
+ */
+static bool read_bytes(FILE *in, void *buf, size_t len)
+{
+    return fread(buf, 1, len, in) == len;
+}
+
+static bool parse_args(const string &payload, vector<ARG> &args)
+{
+    size_t pos = 0;
+    while (pos < payload.size())
+    {
+        ARG a;
+        a.tag = payload[pos++];
+        size_t need = a.tag == 's' ? 4 : 8;
+        if (payload.size() - pos < need)
+            return false;
+        switch (a.tag)
+        {
+        case 'i':
+            memcpy(&a.i, payload.data() + pos, 8);
+            break;
+        case 'u':
+        case 'p':
+            memcpy(&a.u, payload.data() + pos, 8);
+            break;
+        case 'd':
+            memcpy(&a.d, payload.data() + pos, 8);
+            break;
+        case 's':
+        {
+            uint32_t len;
+            memcpy(&len, payload.data() + pos, 4);
+            if (payload.size() - pos - 4 < len)
+                return false;
+            a.s.assign(payload.data() + pos + 4, len);
+            need += len;
+            break;
+        }
+        default:
+            return false;
+        }
+        pos += need;
+        args.push_back(a);
+    }
+    return true;
+}
+
+/**
+ * @brief printf @p format again with the recorded arguments
+ */
+static string render(const string &format, const vector<ARG> &args)
+{
+    string out;
+    size_t next = 0;
+    char buf[512];
+    const char *p = format.c_str();
+    while (*p)
+    {
+        if (*p != '%')
+        {
+            out += *p++;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            out += '%';
+            p += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion, the length is dropped and replaced
+        string spec = "%";
+        int stars[2];
+        int nstars = 0;
+        ++p;
+        while (*p && strchr("-+ #0'", *p))
+            spec += *p++;
+        for (int part = 0; part < 2; part++)
+        {
+            if (part == 1)
+            {
+                if (*p != '.')
+                    break;
+                spec += *p++;
+            }
+            if (*p == '*')
+            {
+                stars[nstars++] = next < args.size() ? (int)args[next++].as_int() : 0;
+                spec += *p++;
+            }
+            while (*p >= '0' && *p <= '9')
+                spec += *p++;
+        }
+        while (*p && strchr("hlLqjzt", *p))
+            ++p;
+        char conv = *p;
+        if (conv == '\0')
+            break;
+        ++p;
+        if (conv == 'n')
+            continue;
+        if (next >= args.size())
+        {
+            out += "<missing>";
+            continue;
+        }
+        const ARG &a = args[next++];
+
+        int n;
+        if (strchr("diouxXc", conv))
+        {
+            spec += conv == 'c' ? "c" : "ll";
+            if (conv != 'c')
+                spec += conv;
+            long long v = a.as_int();
+            if (conv == 'c')
+                n = nstars == 2 ? snprintf(buf, sizeof(buf), spec.c_str(), stars[0], stars[1], (int)v)
+                    : nstars == 1 ? snprintf(buf, sizeof(buf), spec.c_str(), stars[0], (int)v)
+                                  : snprintf(buf, sizeof(buf), spec.c_str(), (int)v);
+            else
+                n = nstars == 2 ? snprintf(buf, sizeof(buf), spec.c_str(), stars[0], stars[1], v)
+                    : nstars == 1 ? snprintf(buf, sizeof(buf), spec.c_str(), stars[0], v)
+                                  : snprintf(buf, sizeof(buf), spec.c_str(), v);
+        }
+        else if (strchr("fFeEgGaA", conv))
+        {
+            spec += conv;
+            double v = a.as_double();
+            n = nstars == 2 ? snprintf(buf, sizeof(buf), spec.c_str(), stars[0], stars[1], v)
+                : nstars == 1 ? snprintf(buf, sizeof(buf), spec.c_str(), stars[0], v)
+                              : snprintf(buf, sizeof(buf), spec.c_str(), v);
+        }
+        else if (conv == 's')
+        {
+            if (nstars == 0 && spec == "%")
+            {
+                out += a.tag == 's' ? a.s : "<bad %s>"; // fast path, no length limit
+                continue;
+            }
+            spec += 's';
+            const char *v = a.tag == 's' ? a.s.c_str() : "<bad %s>";
+            n = nstars == 2 ? snprintf(buf, sizeof(buf), spec.c_str(), stars[0], stars[1], v)
+                : nstars == 1 ? snprintf(buf, sizeof(buf), spec.c_str(), stars[0], v)
+                              : snprintf(buf, sizeof(buf), spec.c_str(), v);
+        }
+        else if (conv == 'p')
+            n = snprintf(buf, sizeof(buf), "%p", (void *)(uintptr_t)a.u);
+        else
+        {
+            out += spec + conv; // unknown conversion, keep it visible
+            continue;
+        }
+        if (n > 0)
+            out.append(buf, n < (int)sizeof(buf) ? n : sizeof(buf) - 1);
+    }
+    return out;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (in == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    vector<pair<int, string>> formats; // index is the format id of the current session
+    bool truncated = false;
+    int tag;
+    while ((tag = fgetc(in)) != EOF)
+    {
+        if (tag == 'M')
+        {
+            char magic[sizeof(BINLOG_MAGIC) - 1];
+            if (!read_bytes(in, magic, sizeof(magic)) || memcmp(magic, BINLOG_MAGIC, sizeof(magic)) != 0)
+            {
+                fprintf(stderr, "log_decoder: not a binary log (bad magic)\n");
+                return 1;
+            }
+            formats.clear();
+        }
+        else if (tag == 'F')
+        {
+            uint32_t id, len;
+            uint8_t level;
+            if (!read_bytes(in, &id, 4) || !read_bytes(in, &level, 1) || !read_bytes(in, &len, 4))
+            {
+                truncated = true;
+                break;
+            }
+            string format(len, '\0');
+            if (!read_bytes(in, &format[0], len))
+            {
+                truncated = true;
+                break;
+            }
+            if (formats.size() <= id)
+                formats.resize(id + 1);
+            formats[id] = make_pair(level, format);
+        }
+        else if (tag == 'L')
+        {
+            uint32_t id, len;
+            uint64_t ns;
+            string payload;
+            if (!read_bytes(in, &id, 4) || !read_bytes(in, &ns, 8) || !read_bytes(in, &len, 4) ||
+                !read_bytes(in, &(payload = string(len, '\0'))[0], len))
+            {
+                truncated = true; // the writer was killed mid-record
+                break;
+            }
+
+            vector<ARG> args;
+            bool ok = parse_args(payload, args);
+            time_t sec = ns / 1000000000ULL;
+            struct tm my_tm;
+            localtime_r(&sec, &my_tm);
+            int level = id < formats.size() ? formats[id].first : 1;
+            printf("%d-%02d-%02d %02d:%02d:%02d.%06ld %s",
+                   my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec,
+                   (long)(ns % 1000000000ULL / 1000), level >= 0 && level <= 3 ? level_names[level] : "[info]:");
+            if (id < formats.size())
+                fputs(render(formats[id].second, args).c_str(), stdout);
+            else
+                printf("<unknown format %u>", id);
+            puts(ok ? "" : " <corrupt arguments>");
+        }
+        else
+        {
+            fprintf(stderr, "log_decoder: unknown record '%c' at offset %ld\n", tag, ftell(in) - 1);
+            return 1;
+        }
+    }
+    if (truncated)
+        fprintf(stderr, "log_decoder: truncated record at the end of the input\n");
+
+    if (in != stdin)
+        fclose(in);
+    return 0;
+}
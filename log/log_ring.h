@@ -0,0 +1,139 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <atomic>
+#include <cstring>
+#include <sys/uio.h>
+
+/**
+ * @class LOG_RING
+ * @brief Single-producer/single-consumer byte ring holding formatted log lines
+ *
+ * One ring per logging thread (the producer) and the LOG writer thread as the only consumer,
+ * so neither side ever takes a lock. Lines are stored back to back; the consumer hands the
+ * readable bytes to writev() as at most two iovecs (before and after the wrap point) and
+ * never copies them.
+ */
+class LOG_RING
+{
+private:
+    char *m_buf;    ///< Storage, m_size bytes
+    size_t m_size;  ///< Capacity, a power of two
+    size_t m_mask;  ///< m_size - 1
+
+    alignas(64) std::atomic<size_t> m_head;    ///< Total bytes written (producer owned)
+    std::atomic<size_t> m_records;             ///< Total records written (producer owned)
+    alignas(64) std::atomic<size_t> m_tail;    ///< Total bytes consumed (consumer owned)
+    size_t m_records_read;                     ///< Total records consumed (consumer only)
+    std::atomic<bool> m_retired;               ///< The producer is gone (its thread exited)
+
+public:
+    /**
+     * @param size Capacity in bytes, rounded up to a power of two
+     */
+    explicit LOG_RING(size_t size) : m_head(0), m_records(0), m_tail(0), m_records_read(0), m_retired(false)
+    {
+        m_size = 1;
+        while (m_size < size)
+            m_size <<= 1;
+        m_mask = m_size - 1;
+        m_buf = new char[m_size];
+    }
+
+    ~LOG_RING()
+    {
+        delete[] m_buf;
+    }
+
+    /**
+     * @brief Append one line (producer side)
+     * @return false if the ring does not have room for the whole line (nothing is written)
+     */
+    bool push(const char *data, size_t len)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (m_size - (head - m_tail.load(std::memory_order_acquire)) < len)
+            return false;
+
+        size_t pos = head & m_mask;
+        size_t first = len < m_size - pos ? len : m_size - pos;
+        memcpy(m_buf + pos, data, first);
+        memcpy(m_buf, data + first, len - first);
+        m_records.store(m_records.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_head.store(head + len, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Mark the ring as having no producer anymore (producer side, its last call)
+     */
+    void retire()
+    {
+        m_retired.store(true, std::memory_order_release);
+    }
+
+    /**
+     * @brief Whether retire() was called (consumer side); once true, every line the
+     *        producer pushed is visible to peek()
+     */
+    bool retired() const
+    {
+        return m_retired.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Bytes currently queued (either side, approximate for the producer)
+     */
+    size_t used() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Capacity in bytes
+     */
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * @brief Describe the readable bytes (consumer side)
+     * @param[out] iov Filled with up to two slices
+     * @param[out] count Number of slices filled
+     * @param[out] records Records in those bytes (exact once the producer is idle, otherwise
+     *             it may run ahead by the record being written; used for file splitting only)
+     * @return Readable bytes; release them with consume() once written
+     */
+    size_t peek(struct iovec iov[2], int &count, size_t &records)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t len = m_head.load(std::memory_order_acquire) - tail;
+        records = m_records.load(std::memory_order_relaxed) - m_records_read;
+        count = 0;
+        if (len == 0)
+            return 0;
+
+        size_t pos = tail & m_mask;
+        size_t first = len < m_size - pos ? len : m_size - pos;
+        iov[count].iov_base = m_buf + pos;
+        iov[count++].iov_len = first;
+        if (len > first)
+        {
+            iov[count].iov_base = m_buf;
+            iov[count++].iov_len = len - first;
+        }
+        return len;
+    }
+
+    /**
+     * @brief Release @p len bytes and @p records records returned by peek() (consumer side)
+     */
+    void consume(size_t len, size_t records)
+    {
+        m_records_read += records;
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+};
+
+#endif
@@ -1,6 +1,66 @@
 #include "config/config.h"
 #include "http/http_routes.h"
+#include "http/json_bind.h"
+#include "http/multipart.h"
 #include <string>
+#include <arpa/inet.h>
+
+/// Body of /login and /register
+struct CREDENTIALS
+{
+    string username;
+    string password;
+};
+JSON_BIND(CREDENTIALS, username, password);
+
+/**
+ * @brief Credentials of a JSON body (streamed into a JSON_BODY) or of a urlencoded form
+ * @return false if either is missing
+ */
+static bool read_credentials(const HttpRequest &req, CREDENTIALS &cred)
+{
+    if (const JSON_BODY<CREDENTIALS> *body = req.sink<JSON_BODY<CREDENTIALS>>())
+    {
+        cred = body->value();
+        return body->complete();
+    }
+    // root/log.html and root/register.html post "user" and "password", older clients "passwd"
+    const URL_PARAMS::PARAM *user = req.m_form.find("username");
+    if (user == NULL)
+        user = req.m_form.find("user");
+    const URL_PARAMS::PARAM *password = req.m_form.find("password");
+    if (password == NULL)
+        password = req.m_form.find("passwd");
+    if (user == NULL || password == NULL)
+        return false;
+    cred.username = user->value;
+    cred.password = password->value;
+    return true;
+}
+
+/// JSON bodies of /login and /register are streamed, forms are buffered into req.m_form
+static BODY_SINK *credentials_sink(const HttpRequest &req)
+{
+    return req.is_form() ? NULL : new JSON_BODY<CREDENTIALS>();
+}
+
+/**
+ * @brief Whether the peer is on this host (127.0.0.0/8)
+ * @note The admin routes (/db_stats, /log_level) answer only such peers: they expose pool
+ *       internals or change the server's behaviour, and have no authentication of their own
+ */
+static bool from_loopback(const HttpRequest &req)
+{
+    return (ntohl(req.m_address.sin_addr.s_addr) >> 24) == 127;
+}
+
+/// Body of POST /log_level
+struct LOG_LEVEL_FORM
+{
+    string module;
+    string level;
+};
+JSON_BIND(LOG_LEVEL_FORM, module, level);
 
 int main(int argc, char *argv[])
 {
@@ -19,19 +79,165 @@ int main(int argc, char *argv[])
     router.get("/about", [](const HttpRequest &req, HttpResponse &res)
                { res.send(200, "About page"); });
 
-    router.post("/login", [](const HttpRequest &req, HttpResponse &res){
-        res.send(200,"kaisa hai bhai");
-    });
+    // credentials are checked against the in-memory user cache, no DB connection is used.
+    // A JSON body is streamed into a CREDENTIALS, reading stops once both fields are set;
+    // username=...&password=... forms work too
+    router.stream(POST, "/login", credentials_sink);
+    router.post("/login", [](const HttpRequest &req, HttpResponse &res)
+                {
+        CREDENTIALS cred;
+        if (!read_credentials(req, cred))
+        {
+            res.send(400, "username and password required");
+            return;
+        }
+        if (USER_CACHE::get_instance()->authenticate(cred.username, cred.password))
+            res.send(200, "Login successful");
+        else
+            res.send(401, "Invalid username or password"); });
+
+    // write-through: the user is inserted into MySQL, then published to the cache. The insert
+    // rides the write-behind queue and the reply is sent once it is committed.
+    router.stream(POST, "/register", credentials_sink);
+    router.post("/register", [](const HttpRequest &req, HttpResponse &res)
+                {
+        CREDENTIALS cred;
+        if (!read_credentials(req, cred) || cred.username.empty() || cred.password.empty())
+        {
+            res.send(400, "username and password required");
+            return;
+        }
+        uint64_t ticket = res.defer();
+        USER_CACHE::get_instance()->add_user_later(cred.username, cred.password, [&res, ticket](USER_CACHE::ADD_RESULT result)
+        {
+            if (!res.claim(ticket))
+                return;
+            switch (result)
+            {
+            case USER_CACHE::ADDED:
+                res.send(201, "Registered");
+                break;
+            case USER_CACHE::EXISTS:
+                res.send(409, "Username already taken");
+                break;
+            default:
+                res.send(503, "Database unavailable");
+                break;
+            }
+            res.resume();
+        }); });
+
+    // uploads: multipart/form-data is streamed to disk through a fixed window, each file is
+    // then saved under its own (sanitized) name in ./uploads, never replacing one
+    mkdir("uploads", 0755);
+    router.stream(POST, "/upload", [](const HttpRequest &req)
+                  { return MULTIPART_FORM::open(req, "uploads"); });
+    router.post("/upload", [](const HttpRequest &req, HttpResponse &res)
+                {
+        MULTIPART_FORM *form = req.sink<MULTIPART_FORM>();
+        if (form == NULL || !form->valid())
+        {
+            res.send(400, "multipart/form-data body expected");
+            return;
+        }
+        res.json(201, [form](JSON_WRITER &w)
+        {
+            w.start_array();
+            for (size_t i = 0; i < form->size(); i++)
+            {
+                const MULTIPART_FORM::PART &part = (*form)[i];
+                if (!part.is_file)
+                    continue;
+                string name = MULTIPART_FORM::safe_name(part.filename);
+                bool saved = form->save(part, "uploads/" + name);
+                w.start_object().key("field").string(part.name).key("file").string(name);
+                w.key("bytes").integer(part.size).key("saved").boolean(saved).end_object();
+            }
+            w.end_array();
+        }); });
+
+    // whether a user is registered, from the cache: /users/alice
+    router.get("/users/:name", [](const HttpRequest &req, HttpResponse &res)
+               {
+        if (USER_CACHE::get_instance()->contains(string(req.param("name"))))
+            res.send(200, "User exists");
+        else
+            res.send(404, "No such user"); });
 
     router.get("/contact", [](const HttpRequest &req, HttpResponse &res)
                { res.render(200, "/video.html"); });
 
+    // connection pool health: breaker state, timeouts and wait-time histogram (local peers only)
+    router.get("/db_stats", [](const HttpRequest &req, HttpResponse &res)
+               {
+        if (!from_loopback(req))
+        {
+            res.send(403, "Forbidden");
+            return;
+        }
+        res.send(200, DB_CONNECTION_POOL::get_instance()->stats()); });
+
+    // runtime log levels: GET lists them, POST {"module": "http", "level": "debug"} changes one
+    // ("module" may be omitted to change every module), no restart needed; local peers only
+    router.get("/log_level", [](const HttpRequest &req, HttpResponse &res)
+               {
+        if (!from_loopback(req))
+        {
+            res.send(403, "Forbidden");
+            return;
+        }
+        res.send(200, LOG::levels()); });
+
+    router.stream(POST, "/log_level", [](const HttpRequest &req) -> BODY_SINK *
+                  { return from_loopback(req) ? new JSON_BODY<LOG_LEVEL_FORM>() : NULL; });
+    router.post("/log_level", [](const HttpRequest &req, HttpResponse &res)
+                {
+        if (!from_loopback(req))
+        {
+            res.send(403, "Forbidden");
+            return;
+        }
+        const LOG_LEVEL_FORM &form = req.sink<JSON_BODY<LOG_LEVEL_FORM>>()->value();
+        const string &module_name = form.module, &level_name = form.level;
+        int level = LOG::level_id(level_name);
+        int module = module_name.empty() ? -1 : LOG::module_id(module_name);
+        if (level < 0 || (module < 0 && !module_name.empty()))
+        {
+            res.send(400, "level: debug|info|warn|error|off, module: core|http|sql");
+            return;
+        }
+        LOG::set_level(module, level);
+        res.send(200, LOG::levels()); });
+
+    // served without a worker waiting on MySQL: the reply is sent from the event loop
+    router.get("/user_count", [](const HttpRequest &req, HttpResponse &res)
+               {
+        uint64_t ticket = res.defer();
+        bool queued = ASYNC_SQL::get_instance()->query("SELECT COUNT(*) FROM user", [&res, ticket](MYSQL_RES *result, unsigned int err)
+        {
+            if (!res.claim(ticket))
+                return;
+            MYSQL_ROW row = result ? mysql_fetch_row(result) : NULL;
+            if (err || row == NULL)
+                res.send(503, "Database unavailable");
+            else
+                res.send(200, row[0] ? row[0] : "0");
+            res.resume();
+        });
+        if (!queued && res.claim(ticket))
+        {
+            res.send(503, "Database unavailable");
+            res.resume();
+        } });
+
+    router.freeze(); // every route is in: lookups are lock-free from here on
+
     CONFIG config;
     config.parse_arg(argc, argv);
 
     WEBSERVER server;
 
-    server.init(config.port, user, password, db_name, config.log_write, config.opt_linger, config.trigger_mode, config.sql_num, config.thread_num, config.close_log, config.actor_model);
+    server.init(config, user, password, db_name);
 
     server.log_write();
 
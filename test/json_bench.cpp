@@ -0,0 +1,165 @@
+/**
+ * NOTE:
+ * JSON parser throughput, built with `make json_bench`:
+ *
+ *   ./json_bench               synthetic ~1 MB document (objects, arrays, escapes, numbers)
+ *   ./json_bench body.json     any file
+ *
+ * Each measurement repeats for about a second and prints MB/s (1 MB = 10^6 bytes):
+ * - stage 1 alone (JSON_INDEX) with every kernel the CPU supports
+ * - JSON_DOCUMENT::parse (compact arena tree)
+ * - the same in situ (strings point into the text)
+ * - JSON_LAZY::parse (validation only, what a request body costs before it is read), through
+ *   the index or not as it decides (see JSON_INDEX_MIN_BYTES; the synthetic document is
+ *   too dense for it, a body of long strings is not)
+ * - JSONNode::parse (copied into a mutable JSONNode tree)
+ * - serialization: JSON_WRITER from the compact tree, and JSONNode::stringify
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "../http/jsonparser.h"
+#include "../http/json_index.h"
+#include "../http/json_value.h"
+#include "../http/json_lazy.h"
+#include "../http/json_writer.h"
+
+static double now_sec()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+ * @brief A request-like document: an array of user records with nested arrays of objects
+ */
+static std::string synthetic(size_t target)
+{
+    std::string s = "{\"users\": [\n";
+    for (int i = 0; s.size() < target; i++)
+    {
+        if (i > 0)
+            s += ",\n";
+        s += "  {\"id\": " + std::to_string(i) +
+             ", \"username\": \"user_" + std::to_string(i) + "\"" +
+             ", \"password\": \"p\\\"a\\\\ss\\u00e9" + std::to_string(i * 7919) + "\"" +
+             ", \"score\": " + std::to_string(i * 0.25) + "e-1" +
+             ", \"active\": " + (i % 2 ? "true" : "false") +
+             ", \"tags\": [\"a\", \"b\\n\", null, 12, -3.5]" +
+             ", \"sessions\": [{\"ip\": \"10.0.0." + std::to_string(i % 256) + "\", \"ttl\": 3600}, {\"ip\": \"::1\", \"ttl\": 60}]}";
+    }
+    s += "\n]}";
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string doc;
+    if (argc > 1)
+    {
+        std::ifstream in(argv[1], std::ios::binary);
+        if (!in)
+        {
+            perror(argv[1]);
+            return 1;
+        }
+        std::stringstream ss;
+        ss << in.rdbuf();
+        doc = ss.str();
+    }
+    else
+        doc = synthetic(1 << 20);
+
+    JSON::parse(doc); // warm up, and fail early on invalid input
+
+    JSON_INDEX index;
+    for (int k = JSON_INDEX::kernel(); k >= JSON_INDEX::SCALAR; k--)
+    {
+        int rounds = 0;
+        double start = now_sec(), elapsed = 0;
+        while (elapsed < 1.0)
+        {
+            index.build(doc.data(), doc.size(), (JSON_INDEX::KERNEL)k);
+            rounds++;
+            elapsed = now_sec() - start;
+        }
+        printf("stage 1 (%s): %zu positions, %.1f MB/s\n", JSON_INDEX::kernel_name((JSON_INDEX::KERNEL)k),
+               index.count(), (double)doc.size() * rounds / 1e6 / elapsed);
+    }
+
+    JSON_DOCUMENT document;
+    int rounds = 0;
+    double start = now_sec(), elapsed = 0;
+    while (elapsed < 1.0)
+    {
+        document.parse(doc.c_str(), doc.size());
+        rounds++;
+        elapsed = now_sec() - start;
+    }
+    printf("document: %zu bytes x %d rounds in %.3f s: %.1f MB/s\n", doc.size(), rounds, elapsed, (double)doc.size() * rounds / 1e6 / elapsed);
+
+    rounds = 0;
+    start = now_sec();
+    elapsed = 0;
+    while (elapsed < 1.0)
+    {
+        document.parse(doc.data(), doc.size(), true);
+        rounds++;
+        elapsed = now_sec() - start;
+    }
+    printf("document in situ: %zu bytes x %d rounds in %.3f s: %.1f MB/s\n", doc.size(), rounds, elapsed, (double)doc.size() * rounds / 1e6 / elapsed);
+
+    JSON_LAZY lazy;
+    rounds = 0;
+    start = now_sec();
+    elapsed = 0;
+    while (elapsed < 1.0)
+    {
+        lazy.parse(doc.data(), doc.size());
+        rounds++;
+        elapsed = now_sec() - start;
+    }
+    printf("lazy: %zu bytes x %d rounds in %.3f s: %.1f MB/s\n", doc.size(), rounds, elapsed, (double)doc.size() * rounds / 1e6 / elapsed);
+
+    rounds = 0;
+    start = now_sec();
+    elapsed = 0;
+    while (elapsed < 1.0)
+    {
+        JSON root = JSON::parse(doc);
+        rounds++;
+        elapsed = now_sec() - start;
+    }
+    printf("JSONNode: %zu bytes x %d rounds in %.3f s: %.1f MB/s\n", doc.size(), rounds, elapsed, (double)doc.size() * rounds / 1e6 / elapsed);
+
+    // output MB/s, of the text written
+    std::string out;
+    rounds = 0;
+    start = now_sec();
+    elapsed = 0;
+    while (elapsed < 1.0)
+    {
+        out.clear(); // keeps its capacity, as a response buffer does
+        JSON_WRITER(out).value(document.root());
+        rounds++;
+        elapsed = now_sec() - start;
+    }
+    printf("writer: %zu bytes x %d rounds in %.3f s: %.1f MB/s\n", out.size(), rounds, elapsed, (double)out.size() * rounds / 1e6 / elapsed);
+
+    JSON root = JSON::parse(doc);
+    rounds = 0;
+    start = now_sec();
+    elapsed = 0;
+    while (elapsed < 1.0)
+    {
+        out = JSON::stringify(root);
+        rounds++;
+        elapsed = now_sec() - start;
+    }
+    printf("stringify: %zu bytes x %d rounds in %.3f s: %.1f MB/s\n", out.size(), rounds, elapsed, (double)out.size() * rounds / 1e6 / elapsed);
+    return 0;
+}
@@ -2,6 +2,7 @@ import requests
 import os
 import random
 import string
+from urllib.parse import quote_plus
 
 # Server configuration
 SERVER_HOST = 'localhost'  # Change to your server IP if needed
@@ -32,31 +33,37 @@ def test_post_requests():
     """Test POST requests for login and registration"""
     print("\n=== Testing POST Requests ===")
     
-    # Generate random user credentials for testing
+    # Generate random user credentials for testing; the password needs percent-decoding
     username = ''.join(random.choices(string.ascii_letters, k=8))
-    password = ''.join(random.choices(string.ascii_letters + string.digits, k=12))
+    password = ''.join(random.choices(string.ascii_letters + string.digits, k=12)) + ' &=%+'
+    encoded = quote_plus(password)
+    headers = {'Content-Type': 'application/x-www-form-urlencoded'}
     
-    # Test registration (POST to /2)
+    # Test registration with the field names of root/register.html
     print("\nTesting registration:")
-    data = f"user={username}&passwd={password}"
-    headers = {'Content-Type': 'application/x-www-form-urlencoded'}
+    data = f"user={username}&password={encoded}"
+    response = requests.post(BASE_URL + '/register', data=data, headers=headers)
+    print(f"POST /register -> Status: {response.status_code} (expected 201), Body: {response.text}")
     
-    response = requests.post(BASE_URL + '/2', data=data, headers=headers)
-    print(f"POST /2 (register) -> Status: {response.status_code}, Length: {len(response.text)}")
-    print(f"Response URL: {response.url}")
+    response = requests.post(BASE_URL + '/register', data=data, headers=headers)
+    print(f"POST /register again -> Status: {response.status_code} (expected 409), Body: {response.text}")
     
-    # Test login with correct credentials (POST to /3)
+    # Test login with correct credentials, as root/log.html and as older clients ("passwd") post them
     print("\nTesting login with correct credentials:")
-    response = requests.post(BASE_URL + '/3', data=data, headers=headers)
-    print(f"POST /3 (login) -> Status: {response.status_code}, Length: {len(response.text)}")
-    print(f"Response URL: {response.url}")
+    response = requests.post(BASE_URL + '/login', data=data, headers=headers)
+    print(f"POST /login -> Status: {response.status_code} (expected 200), Body: {response.text}")
+    response = requests.post(BASE_URL + '/login', data=f"user={username}&passwd={encoded}", headers=headers)
+    print(f"POST /login (passwd) -> Status: {response.status_code} (expected 200), Body: {response.text}")
     
     # Test login with incorrect credentials
     print("\nTesting login with incorrect credentials:")
-    wrong_data = f"user={username}&passwd=wrongpassword"
-    response = requests.post(BASE_URL + '/3', data=wrong_data, headers=headers)
-    print(f"POST /3 (login) -> Status: {response.status_code}, Length: {len(response.text)}")
-    print(f"Response URL: {response.url}")
+    wrong_data = f"user={username}&password=wrongpassword"
+    response = requests.post(BASE_URL + '/login', data=wrong_data, headers=headers)
+    print(f"POST /login -> Status: {response.status_code} (expected 401), Body: {response.text}")
+    
+    # Test a form without a password
+    response = requests.post(BASE_URL + '/login', data=f"user={username}", headers=headers)
+    print(f"POST /login (no password) -> Status: {response.status_code} (expected 400), Body: {response.text}")
 
 def test_error_handling():
     """Test server error handling"""
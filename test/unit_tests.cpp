@@ -0,0 +1,1196 @@
+/**
+ * NOTE:
+ * Behaviour tests of the request-side parsers, the route tree and the binary log, built and
+ * run with `make check` (which builds ./log_decoder first, the binlog tests run it):
+ *
+ *   ./unit_tests            every test
+ *   ./unit_tests reader     the tests whose name contains "reader"
+ *
+ * Each test prints its failed checks (file:line and the expression) and the run exits with
+ * 1 if any failed. The incremental parsers are fed every way a client may cut a body: each
+ * split point, several splits, one byte at a time; every chunk is a copy freed after the
+ * call, so a view kept into it shows up under -fsanitize=address.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../http/json_reader.h"
+#include "../http/json_lazy.h"
+#include "../http/json_index.h"
+#include "../http/json_writer.h"
+#include "../http/multipart.h"
+#include "../http/route_tree.h"
+#include "../http/url_params.h"
+#include "../log/log_binary.h"
+
+static int g_checks = 0;
+static int g_failed = 0;
+
+#define CHECK(cond)                                                       \
+    do                                                                    \
+    {                                                                     \
+        g_checks++;                                                       \
+        if (!(cond))                                                      \
+        {                                                                 \
+            g_failed++;                                                   \
+            printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        }                                                                 \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                        \
+    do                                                                                        \
+    {                                                                                         \
+        g_checks++;                                                                           \
+        if (!((a) == (b)))                                                                    \
+        {                                                                                     \
+            g_failed++;                                                                       \
+            printf("  %s:%d: CHECK_EQ(%s, %s) failed\n", __FILE__, __LINE__, #a, #b);         \
+        }                                                                                     \
+    } while (0)
+
+/**
+ * @brief Chunk boundaries of @p len bytes: whole, every single split, every pair of splits,
+ *        and one byte at a time
+ */
+static std::vector<std::vector<size_t>> splits(size_t len)
+{
+    std::vector<std::vector<size_t>> all;
+    all.push_back({});
+    for (size_t i = 0; i <= len; i++)
+        all.push_back({i});
+    for (size_t i = 1; i < len; i++)
+        for (size_t j = i + 1; j < len; j++)
+            all.push_back({i, j});
+    std::vector<size_t> bytes;
+    for (size_t i = 1; i < len; i++)
+        bytes.push_back(i);
+    all.push_back(bytes);
+    return all;
+}
+
+/**
+ * @brief The pieces of @p text cut at @p cuts, each in its own allocation
+ */
+static std::vector<std::string> chunks(const std::string &text, const std::vector<size_t> &cuts)
+{
+    std::vector<std::string> out;
+    size_t from = 0;
+    for (size_t cut : cuts)
+    {
+        out.push_back(text.substr(from, cut - from));
+        from = cut;
+    }
+    out.push_back(text.substr(from));
+    return out;
+}
+
+/**
+ * @brief Scratch directory of the tests that write files, removed at exit
+ */
+static const std::string &scratch_dir()
+{
+    static std::string dir;
+    if (dir.empty())
+    {
+        char tmpl[] = "/tmp/unit_tests.XXXXXX";
+        dir = mkdtemp(tmpl);
+        atexit([]
+               { std::string cmd = "rm -rf " + dir; if (system(cmd.c_str()) != 0) perror(cmd.c_str()); });
+    }
+    return dir;
+}
+
+/* ---------------------------------------------------------------- JSON_READER */
+
+/**
+ * @class RECORDER
+ * @brief Writes the events it receives as one line of text, optionally skipping a key
+ */
+class RECORDER : public JSON_HANDLER
+{
+public:
+    std::string events;
+    std::string skip_key; ///< Key whose value is skipped
+    std::string stop_at;  ///< String value that stops the reader
+
+    ACTION start_object() override { events += "{"; return CONTINUE; }
+    ACTION end_object() override { events += "}"; return CONTINUE; }
+    ACTION start_array() override { events += "["; return CONTINUE; }
+    ACTION end_array() override { events += "]"; return CONTINUE; }
+    ACTION key(std::string_view k) override
+    {
+        events += "k(" + std::string(k) + ")";
+        return k == skip_key ? SKIP : CONTINUE;
+    }
+    ACTION string(std::string_view s) override
+    {
+        events += "s(" + std::string(s) + ")";
+        return !stop_at.empty() && s == stop_at ? STOP : CONTINUE;
+    }
+    ACTION number(double d) override
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "n(%.17g)", d);
+        events += buf;
+        return CONTINUE;
+    }
+    ACTION integer(int64_t i) override { events += "i(" + std::to_string(i) + ")"; return CONTINUE; }
+    ACTION boolean(bool b) override { events += b ? "true" : "false"; return CONTINUE; }
+    ACTION null() override { events += "null"; return CONTINUE; }
+};
+
+/**
+ * @struct READ_RESULT
+ * @brief What a JSON_READER made of one input
+ */
+struct READ_RESULT
+{
+    JSON_READER::STATUS status;
+    std::string events;
+    size_t error_offset;
+};
+
+static READ_RESULT read_json(const std::string &text, const std::vector<size_t> &cuts, const std::string &skip_key = "", const std::string &stop_at = "")
+{
+    RECORDER rec;
+    rec.skip_key = skip_key;
+    rec.stop_at = stop_at;
+    JSON_READER reader(rec);
+    JSON_READER::STATUS status = JSON_READER::MORE;
+    for (const std::string &piece : chunks(text, cuts))
+    {
+        char *copy = new char[piece.size() + 1];
+        memcpy(copy, piece.data(), piece.size());
+        status = reader.feed(copy, piece.size());
+        delete[] copy;
+        if (status == JSON_READER::FAILED || status == JSON_READER::STOPPED)
+            break;
+    }
+    if (status == JSON_READER::MORE || status == JSON_READER::DONE)
+        status = reader.finish();
+    return READ_RESULT{status, rec.events, status == JSON_READER::FAILED ? reader.error_offset() : 0};
+}
+
+/**
+ * @brief @p text gives @p status and @p events (when not empty) however it is cut
+ */
+static void check_read(const std::string &text, JSON_READER::STATUS status, const std::string &events,
+                       const std::string &skip_key = "", const std::string &stop_at = "")
+{
+    READ_RESULT whole = read_json(text, {}, skip_key, stop_at);
+    if (whole.status != status || (!events.empty() && whole.events != events))
+    {
+        g_failed++;
+        printf("  %s: status %d events %s, expected %d %s\n", text.c_str(), whole.status, whole.events.c_str(), status, events.c_str());
+        return;
+    }
+    for (const std::vector<size_t> &cuts : splits(text.size()))
+    {
+        READ_RESULT r = read_json(text, cuts, skip_key, stop_at);
+        g_checks++;
+        if (r.status != whole.status || r.events != whole.events || r.error_offset != whole.error_offset)
+        {
+            g_failed++;
+            std::string at;
+            for (size_t c : cuts)
+                at += " " + std::to_string(c);
+            printf("  %s cut at%s: status %d events %s error at %zu, whole: %d %s %zu\n", text.c_str(), at.c_str(),
+                   r.status, r.events.c_str(), r.error_offset, whole.status, whole.events.c_str(), whole.error_offset);
+            return;
+        }
+    }
+}
+
+static void test_reader_values()
+{
+    check_read("{\"a\": [1, -2, 3.5, true, false, null], \"b\": {}}", JSON_READER::DONE,
+               "{k(a)[i(1)i(-2)n(3.5)truefalsenull]k(b){}}");
+    check_read(" [ ] ", JSON_READER::DONE, "[]");
+    check_read("\"plain\"", JSON_READER::DONE, "s(plain)");
+    check_read("12345", JSON_READER::DONE, "i(12345)"); // a top-level number ends with the input
+    check_read("-0.25e2", JSON_READER::DONE, "n(-25)");
+    check_read("[1e3,0,-0,-7]", JSON_READER::DONE, "[n(1000)i(0)n(-0)i(-7)]"); // -0 keeps its sign
+    check_read("[123456789012345678901]", JSON_READER::DONE, "[n(1.2345678901234568e+20)]");
+}
+
+static void test_reader_strings()
+{
+    // escapes cut anywhere: after the backslash, inside \u digits, between surrogates
+    check_read("[\"a\\\"b\\\\c\\/d\\n\"]", JSON_READER::DONE, "[s(a\"b\\c/d\n)]");
+    check_read("\"\\u00e9\\u20ac\"", JSON_READER::DONE, "s(\xc3\xa9\xe2\x82\xac)");
+    check_read("\"\\ud83d\\ude00!\"", JSON_READER::DONE, "s(\xf0\x9f\x98\x80!)");
+    check_read("{\"k\\u0041y\": \"v\"}", JSON_READER::DONE, "{k(kAy)s(v)}");
+}
+
+static void test_reader_errors()
+{
+    check_read("[1,]", JSON_READER::FAILED, "");
+    check_read("{\"a\" 1}", JSON_READER::FAILED, "");
+    check_read("[tru]", JSON_READER::FAILED, "");
+    check_read("[01]", JSON_READER::FAILED, "");
+    check_read("\"bad \\x escape\"", JSON_READER::FAILED, "");
+    check_read("\"\\ud83d alone\"", JSON_READER::FAILED, "");
+    check_read("\"ctrl \x01\"", JSON_READER::FAILED, "");
+    check_read("[1] 2", JSON_READER::FAILED, "");
+    check_read("{\"a\": [1, 2}", JSON_READER::FAILED, "");
+    check_read("[\"cut", JSON_READER::FAILED, ""); // finish() on an unterminated document
+    check_read("", JSON_READER::FAILED, "");
+}
+
+static void test_reader_skip_stop()
+{
+    // a skipped value is still validated but gives no events
+    check_read("{\"skip\": {\"x\": [1, \"y\"]}, \"keep\": 2}", JSON_READER::DONE, "{k(skip)k(keep)i(2)}", "skip");
+    check_read("{\"skip\": [1, }, \"keep\": 2}", JSON_READER::FAILED, "", "skip");
+    check_read("[\"a\", \"stop\", \"b\"]", JSON_READER::STOPPED, "[s(a)s(stop)", "", "stop");
+}
+
+/* ---------------------------------------------------------------- JSON numbers */
+/**
+ * @brief get<T>() of the number @p text, from a JSONNode and from a JSON_DOCUMENT
+ * @return false if it throws; both must agree on the outcome and the value
+ */
+template <typename T>
+static bool number_get(const std::string &text, T &out)
+{
+    bool node_ok = true, doc_ok = true;
+    T node_v{}, doc_v{};
+    try
+    {
+        node_v = JSONNode::parse(text).get<T>();
+    }
+    catch (const std::runtime_error &)
+    {
+        node_ok = false;
+    }
+    JSON_DOCUMENT doc;
+    doc.parse(text.data(), text.size());
+    try
+    {
+        doc_v = doc.root().get<T>();
+    }
+    catch (const std::runtime_error &)
+    {
+        doc_ok = false;
+    }
+    CHECK_EQ(node_ok, doc_ok);
+    CHECK(!node_ok || !doc_ok || node_v == doc_v);
+    out = node_v;
+    return node_ok;
+}
+
+static void test_number_get()
+{
+    int i = 0;
+    unsigned u = 0;
+    int64_t l = 0;
+    double d = 0;
+    CHECK(number_get("2147483647", i) && i == INT_MAX);
+    CHECK(number_get("-2147483648", i) && i == INT_MIN);
+    CHECK(!number_get("2147483648", i));
+    CHECK(!number_get("-2147483649", i));
+    CHECK(!number_get("4294967296", i)); // used to wrap to 0
+    CHECK(number_get("4294967295", u) && u == UINT_MAX);
+    CHECK(!number_get("-1", u));
+    CHECK(number_get("4294967296", l) && l == 4294967296LL);
+    CHECK(number_get("9223372036854775807", d) && d == 9223372036854775807.0);
+    // a double is truncated toward zero, and must then fit
+    CHECK(number_get("1.9", i) && i == 1);
+    CHECK(number_get("-1.9", i) && i == -1);
+    CHECK(number_get("-0.5", u) && u == 0);
+    CHECK(!number_get("-1.5", u));
+    CHECK(number_get("2147483647.5", i) && i == INT_MAX);
+    CHECK(!number_get("2147483648.0", i));
+    CHECK(!number_get("1e300", i));
+    CHECK(!number_get("1e300", l));
+    CHECK(!number_get("9223372036854775808", l)); // a double of 2^63
+    CHECK(number_get("-9223372036854775808", l) && l == INT64_MIN);
+}
+
+/**
+ * @brief Parse the number @p text with JSON_DOCUMENT, JSONNode and JSON_LAZY: it must be an
+ *        INTEGER equal to @p i, or (@p integer false) a double with the bits of strtod
+ */
+static void check_number(const char *text, bool integer, int64_t i = 0)
+{
+    size_t len = strlen(text);
+    JSON_DOCUMENT doc;
+    doc.parse(text, len);
+    JSONNode node = JSONNode::parse(text);
+    JSON_LAZY lazy;
+    lazy.parse(text, len);
+    JSON_VALUE lazy_v = lazy.root().value();
+    bool ok;
+    if (integer)
+        ok = doc.root().type() == JSONType::INTEGER && doc.root().get<int64_t>() == i &&
+             lazy_v.type() == JSONType::INTEGER && lazy_v.get<int64_t>() == i && node.get<int64_t>() == i;
+    else
+    {
+        double want = strtod(text, NULL), d = doc.root().get<double>(), n = node.get<double>(),
+               l = lazy_v.get<double>();
+        ok = doc.root().type() == JSONType::NUMBER && lazy_v.type() == JSONType::NUMBER &&
+             memcmp(&d, &want, sizeof(d)) == 0 && memcmp(&n, &want, sizeof(n)) == 0 &&
+             memcmp(&l, &want, sizeof(l)) == 0;
+    }
+    g_checks++;
+    if (!ok)
+    {
+        g_failed++;
+        printf("  %s read as type %d: %.17g\n", text, (int)doc.root().type(), doc.root().get<double>());
+    }
+}
+
+static void test_number_parse()
+{
+    // integers of up to 18 digits (the scan's fast path) and 19 (from_chars) stay exact
+    check_number("0", true, 0);
+    check_number("-1", true, -1);
+    check_number("999999999999999999", true, 999999999999999999LL);
+    check_number("-999999999999999999", true, -999999999999999999LL);
+    check_number("1000000000000000000", true, 1000000000000000000LL);
+    check_number("9223372036854775807", true, INT64_MAX);
+    check_number("-9223372036854775808", true, INT64_MIN);
+    check_number("9007199254740993", true, 9007199254740993LL); // not a double
+    // past int64: a double, rounded
+    check_number("9223372036854775808", false);
+    check_number("-9223372036854775809", false);
+    check_number("18446744073709551616", false);
+    check_number("123456789012345678901234567890", false);
+    // -0 is not the integer 0
+    check_number("-0", false);
+    check_number("-0.0", false);
+    check_number("-0e3", false);
+    // a fraction or an exponent makes a double, even if integral
+    check_number("1e2", false);
+    check_number("1E+2", false);
+    check_number("100.0", false);
+    check_number("1e-2", false);
+    check_number("-2.5e-3", false);
+    check_number("0.1", false);
+    check_number("0.1000000000000000055511151231257827021181583404541015625", false);
+    check_number("1.7976931348623157e308", false);
+    check_number("2.2250738585072011e-308", false); // next to DBL_MIN, a classic strtod trap
+    check_number("4.9406564584124654e-324", false);
+    check_number("2.4703282292062327e-324", false); // halfway to 0: rounds to even
+    check_number("1e-400", false);
+    check_number("1e400", false); // out of range: infinity, as strtod
+    check_number("-1e400", false);
+    check_number("0.00000000000000000000000000000000000001", false);
+}
+
+/* ---------------------------------------------------------------- JSON_WRITER */
+/**
+ * @brief JSON_WRITER::quote(@p s) must read back as @p s through both parsers
+ */
+static void check_quote(const std::string &s)
+{
+    std::string text;
+    JSON_WRITER::quote(text, s);
+    bool raw = false; // a byte the writer must have escaped is left in the output
+    for (size_t i = 1; i + 1 < text.size(); i++)
+        raw |= (unsigned char)text[i] < 0x20;
+    std::string node, doc_str;
+    try
+    {
+        node = JSONNode::parse(text).get<std::string>();
+        JSON_DOCUMENT doc;
+        doc.parse(text.data(), text.size());
+        doc_str = doc.root().get<std::string>();
+    }
+    catch (const std::runtime_error &e)
+    {
+        node = doc_str = std::string("<") + e.what() + ">";
+    }
+    g_checks++;
+    if (raw || node != s || doc_str != s)
+    {
+        g_failed++;
+        printf("  quote of %zu bytes gave %s\n", s.size(), text.c_str());
+    }
+}
+
+static void test_writer_quote()
+{
+    std::string specials = "\"\\\x7f";
+    for (int c = 0; c < 0x20; c++)
+        specials += (char)c;
+    // each byte to escape at every offset of the first three 16-byte blocks, in strings
+    // ending before, at and after a block boundary
+    for (char c : specials)
+        for (size_t len = 1; len <= 49; len++)
+            for (size_t at = 0; at < len; at++)
+            {
+                std::string s(len, 'a');
+                s[at] = c;
+                check_quote(s);
+            }
+    // runs of escapes, adjacent escapes across a boundary, and UTF-8 (copied as is)
+    check_quote(std::string(40, '"'));
+    check_quote(std::string(15, 'x') + "\\\"" + std::string(15, 'y') + "\n\t");
+    check_quote(std::string("\0\0", 2) + std::string(30, 'z') + std::string("\0", 1));
+    check_quote("");
+    std::string utf8 = "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 \xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9";
+    check_quote(utf8);
+    std::string text;
+    JSON_WRITER::quote(text, utf8 + "\x7f");
+    CHECK_EQ(text, "\"" + utf8 + "\x7f\"");
+    text.clear();
+    JSON_WRITER::quote(text, std::string("\x01\x1f\b\f\n\r\t\"\\", 9));
+    CHECK_EQ(text, "\"\\u0001\\u001f\\b\\f\\n\\r\\t\\\"\\\\\"");
+}
+
+/**
+ * @brief JSON_WRITER::format(@p d) must read back as the same bits (the sign of -0 too),
+ *        and give @p expected if not NULL
+ */
+static void check_format(double d, const char *expected = NULL)
+{
+    std::string text;
+    JSON_WRITER::format(text, d);
+    if (expected)
+        CHECK_EQ(text, expected);
+    double node = JSONNode::parse(text).get<double>();
+    JSON_DOCUMENT doc;
+    doc.parse(text.data(), text.size());
+    double doc_d = doc.root().get<double>();
+    g_checks++;
+    if (memcmp(&node, &d, sizeof(d)) != 0 || memcmp(&doc_d, &d, sizeof(d)) != 0)
+    {
+        g_failed++;
+        printf("  %.17g formatted as %s read back as %.17g / %.17g\n", d, text.c_str(), node, doc_d);
+    }
+}
+
+static void test_writer_numbers()
+{
+    check_format(0.1, "0.1");
+    check_format(0.30000000000000004, "0.30000000000000004");
+    check_format(-0.0, "-0");
+    check_format(0.0, "0");
+    check_format(42.0, "42");
+    check_format(-1e15, "-1000000000000000");
+    check_format(1e300, "1e+300");
+    check_format(5e-324, "5e-324"); // smallest subnormal
+    check_format(2.2250738585072014e-308);
+    check_format(1.7976931348623157e308, "1.7976931348623157e+308");
+    check_format(1e15 + 0.5);
+    check_format(1e16);
+    check_format(9007199254740993.0); // 2^53 + 1, rounded to 2^53
+    check_format(-123456789012345678901.0);
+    uint64_t bits = 0x3ff0000000000001ULL; // 1 + one ulp
+    double next;
+    memcpy(&next, &bits, sizeof(next));
+    check_format(next, "1.0000000000000002");
+    std::string text;
+    JSON_WRITER::format(text, NAN);
+    JSON_WRITER::format(text, INFINITY);
+    JSON_WRITER::format(text, -INFINITY);
+    CHECK_EQ(text, "nullnullnull");
+
+    // int64 limits stay exact integers
+    int64_t ints[] = {0, -1, 1, INT64_MAX, INT64_MIN, INT64_MAX - 1, INT64_MIN + 1, 9007199254740993LL};
+    text.clear();
+    JSON_WRITER w(text);
+    w.start_array();
+    for (int64_t i : ints)
+        w.integer(i);
+    w.end_array();
+    CHECK_EQ(text, "[0,-1,1,9223372036854775807,-9223372036854775808,9223372036854775806,-9223372036854775807,9007199254740993]");
+    JSONNode node = JSONNode::parse(text);
+    JSON_DOCUMENT doc;
+    doc.parse(text.data(), text.size());
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++)
+    {
+        CHECK(node[(int)i].get<int64_t>() == ints[i]); // a double would be off by one, or throw
+        CHECK(doc.root()[i].type() == JSONType::INTEGER && doc.root()[i].get<int64_t>() == ints[i]);
+    }
+
+    // a whole tree written back reads as the same tree
+    std::string in = "{\"a\":[1,-0,0.5,\"x\\u0000y\",true,null,{}],\"b\":-9223372036854775808}";
+    std::string out;
+    JSON_WRITER(out).value(JSONNode::parse(in));
+    doc.parse(in.data(), in.size());
+    std::string from_doc;
+    JSON_WRITER(from_doc).value(doc.root());
+    JSONNode again = JSONNode::parse(out);
+    CHECK(again["b"].get<int64_t>() == INT64_MIN);
+    CHECK(std::signbit(again["a"][1].get<double>()));
+    CHECK_EQ(again["a"][3].get<std::string>(), std::string("x\0y", 3));
+    CHECK_EQ(JSONNode::parse(from_doc)["a"][3].get<std::string>(), std::string("x\0y", 3));
+}
+
+/* ---------------------------------------------------------------- JSON_INDEX */
+
+/**
+ * @brief Outcome of validating @p text: "ok" or the error message
+ */
+static std::string validated(const std::string &text, JSON_LAZY::VALIDATOR validator, JSON_INDEX::KERNEL kernel = JSON_INDEX::SCALAR)
+{
+    JSON_LAZY doc;
+    try
+    {
+        doc.parse(text.data(), text.size(), validator, kernel);
+        return "ok";
+    }
+    catch (const std::runtime_error &e)
+    {
+        return e.what();
+    }
+}
+
+/**
+ * @brief Stage 1 with every kernel the CPU has must give the scalar positions, and the
+ *        indexed validator must accept @p text exactly when the recursive one does
+ * @param what Printed when a check fails
+ */
+static void check_indexed(const std::string &text, const std::string &what)
+{
+    int before = g_failed;
+    std::string expected = validated(text, JSON_LAZY::RECURSIVE);
+    JSON_INDEX scalar;
+    bool built = scalar.build(text.data(), text.size(), JSON_INDEX::SCALAR);
+    std::vector<uint32_t> positions(scalar.positions(), scalar.positions() + scalar.count());
+    for (int k = JSON_INDEX::SCALAR; k <= JSON_INDEX::kernel(); k++)
+    {
+        JSON_INDEX::KERNEL kernel = (JSON_INDEX::KERNEL)k;
+        JSON_INDEX index;
+        CHECK_EQ(index.build(text.data(), text.size(), kernel), built);
+        if (built)
+            CHECK(std::vector<uint32_t>(index.positions(), index.positions() + index.count()) == positions);
+        else
+            CHECK_EQ(index.error_offset(), scalar.error_offset());
+        // the same texts are accepted; stage 1 may find a later error of a bad one first
+        CHECK_EQ(validated(text, JSON_LAZY::INDEXED, kernel) == "ok", expected == "ok");
+    }
+    if (g_failed != before)
+        printf("    in %s\n", what.c_str());
+}
+
+/**
+ * @brief @p value as a member of a document of at least JSON_INDEX_MIN_BYTES, starting
+ *        @p shift bytes further into its 64-byte block
+ */
+static std::string indexed_doc(const std::string &value, size_t shift)
+{
+    return "{\"pad\":\"" + std::string(JSON_INDEX_MIN_BYTES + shift, 'x') + "\",\"k\":" + value + "}";
+}
+
+static void test_index_differential()
+{
+    std::vector<std::string> values = {
+        // escaped quotes and backslash runs, both ways of closing
+        "\"a\\\"b\"", "\"\\\"\\\"\\\"\"", "\"x\\\\\"", "\"\\\\\\\"\"", "[\"\\\"\",\"\\\\\"]",
+        // control characters in strings, and what is allowed instead
+        "\"a\x01" "b\"", "\"tab\tin\"", "\"nl\nin\"", "\"\x1f\"", "\"del\x7f ok\"", "\"\\u0001\\t\"",
+        "\"h\xc3\xa9\"", "\"\xff\"",
+        // unterminated strings (what follows becomes string content)
+        "\"abc", "\"abc\\\"}", "[\"a\",\"b]",
+        // scalars next to strings
+        "[\"a\",1,\"b\",true,\"c\",null,-2.5e3,\"d\",false]", "[\"a\"1]", "[1\"a\"]", "[\"a\"true]",
+        "[true\"a\"]", "{\"a\":1\"b\":2}", "[\"a\",tru]", "[\"a\",1.]", "[\"a\",-]", "[nul,\"a\"]",
+        "[\"a\", 12 ,\"b\"]", "[0x1]", "[01]", "[\"a\"  ,  \"b\"]", "[1 2]", "\"s\"", "-0.5E+2",
+        // structure
+        "[ ]", "{}", "[", "]", "[1,]", "{\"a\"}", "{\"a\":}", "{:1}", "[1]]", "[[[[{}]]]]", "{\"a\":{\"b\":[\"c\"]}}",
+    };
+    for (int n = 1; n <= 9; n++)
+    {
+        // n backslashes then a quote: it closes the string when n is even
+        std::string run = "\"" + std::string(n, '\\') + "\"";
+        values.push_back(n % 2 ? run + "x\"" : run);
+        values.push_back(n % 2 ? run : run + "x\"");
+    }
+
+    // every value at every offset of a 64-byte block, twice so runs cross two blocks
+    for (const std::string &value : values)
+        for (size_t shift = 0; shift < 128; shift++)
+            check_indexed(indexed_doc(value, shift), "value " + value + " shifted by " + std::to_string(shift));
+
+    // the value at the very end: the last block is a partial one
+    std::string spaces(JSON_INDEX_MIN_BYTES, ' ');
+    for (size_t tail = 0; tail < 64; tail++)
+    {
+        std::string pad(tail, ' ');
+        check_indexed(spaces + "123" + pad, "top-level number, " + std::to_string(tail) + " spaces after");
+        check_indexed(spaces + "\"" + pad + "\"", "top-level string of " + std::to_string(tail) + " spaces");
+        check_indexed(spaces + "\"" + pad, "unterminated string of " + std::to_string(tail) + " spaces");
+        check_indexed(spaces + "\"" + pad + "\\\"", "unterminated escaped quote after " + std::to_string(tail) + " spaces");
+    }
+}
+
+static void test_index_mutations()
+{
+    // records of long strings, then 1 to 3 bytes changed into structural or odd ones
+    std::string base = "[";
+    for (int i = 0; base.size() < JSON_INDEX_MIN_BYTES; i++)
+        base += std::string(i ? "," : "") + "{\"id\":" + std::to_string(i) + ",\"name\":\"" + std::string(40 + i % 70, 'a' + i % 26) +
+                "\",\"tags\":[\"x\\\"y\",true,null,-1.5e2],\"note\":\"a\\\\b\\\\\\\\\"}";
+    base += "]";
+    check_indexed(base, "the unmutated records");
+
+    static const char bytes[] = "\"\\{}[]:, \x01\x1f" "a1e-.tnx";
+    uint32_t seed = 12345;
+    auto next = [&seed]()
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    };
+    for (int round = 0; round < 400; round++)
+    {
+        std::string text = base;
+        int changes = 1 + next() % 3;
+        for (int i = 0; i < changes; i++)
+            text[next() % text.size()] = bytes[next() % (sizeof(bytes) - 1)];
+        check_indexed(text, "mutation round " + std::to_string(round));
+    }
+}
+
+/* ---------------------------------------------------------------- URL_PARAMS */
+
+/**
+ * @brief URL_PARAMS::decode of @p in, in place in a buffer of exactly its size
+ */
+static std::string decoded(const std::string &in)
+{
+    std::vector<char> buf(in.begin(), in.end());
+    size_t n = URL_PARAMS::decode(buf.data(), buf.size());
+    return std::string(buf.data(), n);
+}
+
+static void test_url_decode()
+{
+    CHECK_EQ(decoded(""), "");
+    CHECK_EQ(decoded("plain"), "plain");
+    CHECK_EQ(decoded("a+b+%20c"), "a b  c");
+    CHECK_EQ(decoded("%41%4a%4A%7e"), "AJJ~");
+    CHECK_EQ(decoded("p%26ss%3D%25%2B"), "p&ss=%+");
+    CHECK_EQ(decoded("%e2%82%ac"), "\xe2\x82\xac");
+    CHECK_EQ(decoded("nul%00byte"), std::string("nul\0byte", 8));
+    // malformed escapes are kept as they are, and never read past the end
+    CHECK_EQ(decoded("%zz%4g%"), "%zz%4g%");
+    CHECK_EQ(decoded("end%4"), "end%4");
+    CHECK_EQ(decoded("100%"), "100%");
+    CHECK_EQ(decoded("%%41"), "%A");
+}
+
+static void test_url_params()
+{
+    char text[] = "user=a%20b&password=p%26w&empty=&flag&&user=second&x+y=1%2B1";
+    URL_PARAMS params;
+    params.assign(text, strlen(text));
+    CHECK_EQ(params.size(), 6u);
+    CHECK_EQ(params["user"], "a b"); // the first of a repeated name
+    CHECK_EQ(params["password"], "p&w");
+    CHECK(params.has("empty") && params["empty"].empty());
+    CHECK(params.has("flag") && params["flag"].empty());
+    CHECK_EQ(params["x y"], "1+1");
+    CHECK_EQ(params.at(4).value, "second");
+    CHECK(!params.has("missing"));
+    CHECK_EQ(params.get("missing", "fallback"), "fallback");
+
+    // past the inline params
+    std::string many;
+    for (int i = 0; i < 20; i++)
+        many += "k" + std::to_string(i) + "=v%" + std::to_string(30 + i % 10) + "&";
+    std::vector<char> buf(many.begin(), many.end());
+    params.assign(buf.data(), buf.size());
+    CHECK_EQ(params.size(), 20u);
+    CHECK_EQ(params["k19"], "v9");
+    CHECK_EQ(params.at(12).name, "k12");
+
+    params.clear();
+    CHECK_EQ(params.size(), 0u);
+}
+
+/* ---------------------------------------------------------------- MULTIPART_FORM */
+
+static const char BOUNDARY[] = "----form7MA4YWxk";
+
+
+/**
+ * @brief Body of a form with @p parts: {name, filename (empty for a field), data}
+ */
+static std::string multipart_body(const std::vector<std::vector<std::string>> &parts)
+{
+    std::string body = "preamble, ignored\r\n";
+    for (const std::vector<std::string> &part : parts)
+    {
+        body += "--" + std::string(BOUNDARY) + "\r\nContent-Disposition: form-data; name=\"" + part[0] + "\"";
+        if (!part[1].empty())
+            body += "; filename=\"" + part[1] + "\"\r\nContent-Type: application/octet-stream";
+        body += "\r\n\r\n" + part[2] + "\r\n";
+    }
+    return body + "--" + BOUNDARY + "--\r\nepilogue, ignored";
+}
+
+/**
+ * @brief Contents of file part @p part, read back from its descriptor
+ */
+static std::string file_data(const MULTIPART_FORM::PART &part)
+{
+    std::string data;
+    char buf[4096];
+    ssize_t n;
+    for (off_t off = 0; (n = pread(part.fd, buf, sizeof(buf), off)) > 0; off += n)
+        data.append(buf, n);
+    return data;
+}
+
+/**
+ * @brief A form of @p body written in pieces cut at @p cuts, then finished
+ */
+static MULTIPART_FORM *write_form(const std::string &body, const std::vector<size_t> &cuts)
+{
+    MULTIPART_FORM *form = new MULTIPART_FORM(BOUNDARY, scratch_dir());
+    for (const std::string &piece : chunks(body, cuts))
+    {
+        char *copy = new char[piece.size() + 1];
+        memcpy(copy, piece.data(), piece.size());
+        form->write(copy, piece.size());
+        delete[] copy;
+    }
+    form->finish();
+    return form;
+}
+
+static void test_multipart_splits()
+{
+    // data holding near-boundaries: CRLF, "--", the boundary without its CRLF, prefixes of it
+    std::string b = BOUNDARY;
+    std::string file = "line\r\n--" + b.substr(0, b.size() - 1) + "\r\n" + b + "\r\n--" + b.substr(0, 6) + "\r\n-";
+    std::string body = multipart_body({{"title", "", "a b&c"}, {"file", "a.txt", file}, {"empty", "", ""}, {"bin", "b.bin", ""}});
+    int bad = 0;
+    for (const std::vector<size_t> &cuts : splits(body.size()))
+    {
+        if (cuts.size() == 2 && (cuts[0] % 7 != 0 || cuts[1] % 5 != 0)) // a sample of the pairs
+            continue;
+        MULTIPART_FORM *form = write_form(body, cuts);
+        const MULTIPART_FORM::PART *title = form->find("title"), *f = form->find("file"), *bin = form->find("bin");
+        bool ok = form->valid() && form->size() == 4 && title && !title->is_file && title->value == "a b&c" &&
+                  f && f->is_file && f->filename == "a.txt" && f->content_type == "application/octet-stream" &&
+                  f->size == (long)file.size() && file_data(*f) == file && form->find("empty")->value.empty() &&
+                  bin && bin->is_file && bin->size == 0;
+        g_checks++;
+        if (!ok && bad++ == 0)
+        {
+            g_failed++;
+            printf("  multipart body cut at %zu pieces failed: %s\n", cuts.size() + 1, form->error() ? form->error() : "wrong parts");
+        }
+        delete form;
+    }
+}
+
+static void test_multipart_large_file()
+{
+    // larger than the window: written out in several pieces, each cut differently
+    std::string file;
+    for (size_t i = 0; file.size() < 3 * MULTIPART_BUFFER + 123; i++)
+        file += (char)(i * 131 % 251);
+    std::string body = multipart_body({{"file", "big.bin", file}, {"after", "", "x"}});
+    for (size_t step : {(size_t)1000, (size_t)4093, MULTIPART_BUFFER - 1, MULTIPART_BUFFER + 1})
+    {
+        std::vector<size_t> cuts;
+        for (size_t at = step; at < body.size(); at += step)
+            cuts.push_back(at);
+        MULTIPART_FORM *form = write_form(body, cuts);
+        CHECK(form->valid());
+        const MULTIPART_FORM::PART *f = form->find("file");
+        CHECK(f && file_data(*f) == file);
+        CHECK(form->find("after") && form->find("after")->value == "x");
+
+        // save() links the file once, never over an existing one
+        std::string path = scratch_dir() + "/saved" + std::to_string(step);
+        CHECK(f && form->save(*f, path));
+        CHECK(f && !form->save(*f, path) && errno == EEXIST);
+        CHECK(access(path.c_str(), F_OK) == 0);
+        delete form;
+    }
+}
+
+static void test_multipart_errors()
+{
+    MULTIPART_FORM *form = write_form(multipart_body({{"a", "", "1"}}).substr(0, 60), {});
+    CHECK(!form->valid());
+    CHECK_EQ(std::string(form->error()), "body ends before the closing boundary");
+    delete form;
+
+    std::vector<std::vector<std::string>> files;
+    for (size_t i = 0; i <= MULTIPART_MAX_FILES; i++)
+        files.push_back({"f" + std::to_string(i), "f.txt", "data"});
+    form = write_form(multipart_body(files), {});
+    CHECK(!form->valid());
+    CHECK_EQ(std::string(form->error()), "too many files");
+    delete form;
+
+    files.pop_back();
+    form = write_form(multipart_body(files), {});
+    CHECK(form->valid());
+    delete form;
+
+    std::vector<std::vector<std::string>> fields;
+    for (size_t i = 0; i <= MULTIPART_MAX_PARTS; i++)
+        fields.push_back({"f" + std::to_string(i), "", "v"});
+    form = write_form(multipart_body(fields), {});
+    CHECK(!form->valid());
+    CHECK_EQ(std::string(form->error()), "too many parts");
+    delete form;
+
+    CHECK_EQ(MULTIPART_FORM::safe_name("../../etc/passwd"), "passwd");
+    CHECK_EQ(MULTIPART_FORM::safe_name("C:\\dir\\my file.txt"), "my_file.txt");
+    CHECK_EQ(MULTIPART_FORM::safe_name("..."), "upload");
+}
+
+/* ---------------------------------------------------------------- ROUTE_TREE */
+
+/**
+ * @brief "route(value,value...)" for @p path in @p tree, "-1()" if nothing matches
+ */
+static std::string route_of(const ROUTE_TREE &tree, const char *path)
+{
+    std::string_view values[ROUTE_MAX_PARAMS];
+    int count;
+    std::string out = std::to_string(tree.find(path, values, count)) + "(";
+    for (int i = 0; i < count; i++)
+        out += (i ? "," : "") + std::string(values[i]);
+    return out + ")";
+}
+
+static void test_route_precedence()
+{
+    ROUTE_TREE tree;
+    tree.insert("/users/:id", 1);
+    tree.insert("/users/new", 2);
+    tree.insert("/users/:id/posts", 3);
+    tree.insert("/files/*path", 4);
+    tree.insert("/files/readme", 5);
+    tree.insert("/", 6);
+
+    CHECK_EQ(route_of(tree, "/users/new"), "2()");     // static before parameter
+    CHECK_EQ(route_of(tree, "/users/newer"), "1(newer)");
+    CHECK_EQ(route_of(tree, "/users/42"), "1(42)");
+    CHECK_EQ(route_of(tree, "/users/42/posts"), "3(42)");
+    CHECK_EQ(route_of(tree, "/users/"), "-1()");       // a parameter is never empty
+    CHECK_EQ(route_of(tree, "/users/42/"), "-1()");
+    CHECK_EQ(route_of(tree, "/files/readme"), "5()");  // static before wildcard
+    CHECK_EQ(route_of(tree, "/files/a/b.txt"), "4(a/b.txt)");
+    CHECK_EQ(route_of(tree, "/files/"), "4()");        // a wildcard may be empty
+    CHECK_EQ(route_of(tree, "/files"), "-1()");
+    CHECK_EQ(route_of(tree, "/"), "6()");
+    CHECK_EQ(route_of(tree, ""), "-1()");
+    CHECK_EQ(route_of(tree, "/nowhere"), "-1()");
+}
+
+static void test_route_backtracking()
+{
+    ROUTE_TREE tree;
+    tree.insert("/a/b/d", 1);
+    tree.insert("/a/:x/c", 2);
+    tree.insert("/a/*rest", 3);
+    tree.insert("/p/:a/:b/z", 4);
+    tree.insert("/p/*w", 5);
+
+    CHECK_EQ(route_of(tree, "/a/b/d"), "1()");
+    CHECK_EQ(route_of(tree, "/a/b/c"), "2(b)");     // the static "b" leads nowhere: back to :x
+    CHECK_EQ(route_of(tree, "/a/b/e"), "3(b/e)");   // then to the wildcard
+    CHECK_EQ(route_of(tree, "/p/1/2/z"), "4(1,2)");
+    CHECK_EQ(route_of(tree, "/p/1/2/y"), "5(1/2/y)"); // values of the abandoned parameters are dropped
+}
+
+static void test_route_edges()
+{
+    // edges split and shared in every order
+    ROUTE_TREE tree;
+    tree.insert("/abc", 1);
+    tree.insert("/abd", 2);
+    tree.insert("/ab", 3);
+    tree.insert("/a", 4);
+    tree.insert("/abcdef", 5);
+    tree.insert("/ab/:x", 6);
+    CHECK_EQ(route_of(tree, "/abc"), "1()");
+    CHECK_EQ(route_of(tree, "/abd"), "2()");
+    CHECK_EQ(route_of(tree, "/ab"), "3()");
+    CHECK_EQ(route_of(tree, "/a"), "4()");
+    CHECK_EQ(route_of(tree, "/abcdef"), "5()");
+    CHECK_EQ(route_of(tree, "/abcde"), "-1()");
+    CHECK_EQ(route_of(tree, "/ab/c"), "6(c)");
+
+    tree.insert("/abd", 7); // a pattern registered again takes the new route
+    CHECK_EQ(route_of(tree, "/abd"), "7()");
+
+    // parameter names belong to the route, the tree only keeps positions
+    CHECK(ROUTE_TREE::parse("/a/:id/b/*rest") == std::vector<std::string>({"id", "rest"}));
+    CHECK(ROUTE_TREE::parse("/plain").empty());
+
+    const char *invalid[] = {"", "users", "/a/:", "/a/*", "/a/x:y", "/a/*w/b", "/:a/:b/:c/:d/:e/:f/:g/:h/:i"};
+    for (const char *pattern : invalid)
+    {
+        bool thrown = false;
+        try
+        {
+            tree.insert(pattern, 9);
+        }
+        catch (const std::invalid_argument &)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+}
+
+/* ---------------------------------------------------------------- binary log */
+
+static const uint64_t BINLOG_TEST_NS = 1700000000123456789ULL; ///< Clock of every test record
+
+/**
+ * @brief An 'F' record describing @p format as id @p id
+ */
+static std::string binlog_format(uint32_t id, uint8_t level, const std::string &format)
+{
+    std::string rec(1 + 4 + 1 + 4, '\0');
+    uint32_t len = format.size();
+    rec[0] = 'F';
+    memcpy(&rec[1], &id, 4);
+    memcpy(&rec[5], &level, 1);
+    memcpy(&rec[6], &len, 4);
+    return rec + format;
+}
+
+/**
+ * @brief An 'L' record encoded like LOG::write_binary(), its arguments cut at @p room bytes
+ */
+template <typename... Args>
+static std::string binlog_record(uint32_t id, size_t room, Args... args)
+{
+    std::string rec(BINLOG_HEADER + room, '\0');
+    uint64_t ns = BINLOG_TEST_NS;
+    rec[0] = 'L';
+    memcpy(&rec[1], &id, 4);
+    memcpy(&rec[5], &ns, 8);
+    BINLOG_WRITER w(&rec[BINLOG_HEADER], room);
+    (w.arg(args), ...);
+    uint32_t len = w.pos() - &rec[BINLOG_HEADER];
+    memcpy(&rec[13], &len, 4);
+    rec.resize(BINLOG_HEADER + len);
+    return rec;
+}
+
+/**
+ * @brief A binary log being built, with the text each record must decode to
+ */
+struct BINLOG_FILE
+{
+    std::string bytes = std::string("M") + BINLOG_MAGIC;
+    std::vector<std::string> expected;
+
+    /**
+     * @brief Log @p format with @p args; printf of the same call is the expected text
+     */
+    template <typename... Args>
+    void log(const char *format, Args... args)
+    {
+        uint32_t id = expected.size();
+        bytes += binlog_format(id, 1, format) + binlog_record(id, 1024, args...);
+        char text[1024];
+        snprintf(text, sizeof(text), format, args...);
+        expected.push_back(std::string("[info]:") + text);
+    }
+};
+
+/**
+ * @brief Contents of the file at @p path
+ */
+static std::string read_file(const std::string &path)
+{
+    std::string data;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL)
+        return data;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.append(buf, n);
+    fclose(f);
+    return data;
+}
+
+/**
+ * @brief Output of ./log_decoder on @p bytes
+ * @param[out] errors Its stderr (optional)
+ */
+static std::string decode(const std::string &bytes, std::string *errors = NULL)
+{
+    std::string path = scratch_dir() + "/test.bin";
+    FILE *f = fopen(path.c_str(), "wb");
+    fwrite(bytes.data(), 1, bytes.size(), f);
+    fclose(f);
+
+    std::string cmd = "./log_decoder " + path + " >" + path + ".out 2>" + path + ".err";
+    if (system(cmd.c_str()) == -1)
+        return "";
+    if (errors)
+        *errors = read_file(path + ".err");
+    return read_file(path + ".out");
+}
+
+/**
+ * @brief The lines of @p out without the timestamp, which must be BINLOG_TEST_NS
+ */
+static std::vector<std::string> decoded_lines(const std::string &out)
+{
+    time_t sec = BINLOG_TEST_NS / 1000000000ULL;
+    struct tm my_tm;
+    localtime_r(&sec, &my_tm);
+    char stamp[64];
+    snprintf(stamp, sizeof(stamp), "%d-%02d-%02d %02d:%02d:%02d.123456 ",
+             my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec);
+
+    std::vector<std::string> lines;
+    size_t from = 0, end;
+    while ((end = out.find('\n', from)) != std::string::npos)
+    {
+        std::string line = out.substr(from, end - from);
+        from = end + 1;
+        if (line.compare(0, strlen(stamp), stamp) == 0)
+            line.erase(0, strlen(stamp));
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+enum BINLOG_TEST_ENUM
+{
+    BINLOG_TEST_A = 7
+};
+
+static void test_binlog_arguments()
+{
+    if (access("./log_decoder", X_OK) != 0)
+    {
+        CHECK(!"./log_decoder missing, run `make check`");
+        return;
+    }
+
+    int local = 0;
+    char name[] = "array";
+    BINLOG_FILE log;
+    log.log("int %d, negative %d, long %ld, long long %lld", 42, -42, -1234567890123L, (long long)INT64_MIN);
+    log.log("unsigned %u, size %zu, hex %llx, octal %o", 4000000000u, (size_t)SIZE_MAX, 0xfedcba9876543210ULL, 8u);
+    log.log("short %hd, char %c, bool %d, enum %d", (short)-3, 'x', true, BINLOG_TEST_A);
+    log.log("double %f, %.3e, %g, float %5.1f", 3.14159, -1e300, 0.0001, 2.5f);
+    log.log("string '%s', array %s, width [%8s] [%-8s] [%.2s]", "text", name, "r", "l", "cut");
+    log.log("star [%*d] [%-*d] [%.*f] [%*.*s]", 6, 1, 4, 2, 3, 1.23456, 5, 2, "abcdef");
+    log.log("pointer %p, percent 100%%, empty '%s'", (void *)&local, "");
+    log.log("utf-8 %s and bytes %s", "h\xc3\xa9llo", "\x01\x7f");
+    CHECK_EQ(decoded_lines(decode(log.bytes)), log.expected);
+
+    // NULL strings are recorded as printf would print them, without passing NULL to %s
+    std::string bytes = std::string("M") + BINLOG_MAGIC + binlog_format(0, 3, "null %s") + binlog_record(0, 64, (const char *)NULL);
+    CHECK_EQ(decoded_lines(decode(bytes)), std::vector<std::string>({"[error]:null (null)"}));
+}
+
+static void test_binlog_limits()
+{
+    if (access("./log_decoder", X_OK) != 0)
+    {
+        CHECK(!"./log_decoder missing, run `make check`");
+        return;
+    }
+    std::string head = std::string("M") + BINLOG_MAGIC + binlog_format(0, 2, "%s %d");
+
+    // a record cut at the line buffer: the string is shortened, later arguments dropped
+    std::string bytes = head + binlog_record(0, 16, "abcdefghijklmnopqrstuvwxyz", 5);
+    CHECK_EQ(decoded_lines(decode(bytes)), std::vector<std::string>({"[warn]:abcdefghijk <missing>"}));
+
+    // arguments the format has no room for, or too few for it
+    bytes = head + binlog_record(0, 64, "a", 1, 2) + binlog_record(0, 64, "b");
+    CHECK_EQ(decoded_lines(decode(bytes)), std::vector<std::string>({"[warn]:a 1", "[warn]:b <missing>"}));
+
+    // an unknown id; an unknown argument tag, which ends the arguments of its record
+    std::string bad = binlog_record(0, 64, 1);
+    bad[BINLOG_HEADER] = 'z';
+    bytes = head + binlog_record(9, 64, "x", 1) + bad;
+    CHECK_EQ(decoded_lines(decode(bytes)), std::vector<std::string>({"[info]:<unknown format 9>", "[warn]:<missing> <missing> <corrupt arguments>"}));
+
+    // a new session forgets the earlier formats
+    bytes = head + std::string("M") + BINLOG_MAGIC + binlog_record(0, 64, "x", 1);
+    CHECK_EQ(decoded_lines(decode(bytes)), std::vector<std::string>({"[info]:<unknown format 0>"}));
+
+    // a writer killed mid-record: everything before the cut is decoded, then a warning
+    std::string whole = head + binlog_record(0, 64, "first", 1);
+    std::string last = binlog_format(1, 1, "last %s") + binlog_record(1, 64, "record");
+    for (size_t cut = 1; cut < last.size(); cut++)
+    {
+        if (cut == last.size() - (BINLOG_HEADER + 1 + 4 + 6))
+            continue; // between the 'F' and the 'L' record: nothing is cut
+        std::string errors;
+        CHECK_EQ(decoded_lines(decode(whole + last.substr(0, cut), &errors)), std::vector<std::string>({"[warn]:first 1"}));
+        CHECK_EQ(errors, "log_decoder: truncated record at the end of the input\n");
+    }
+    std::string errors;
+    CHECK_EQ(decoded_lines(decode(whole + last, &errors)), std::vector<std::string>({"[warn]:first 1", "[info]:last record"}));
+    CHECK_EQ(errors, "");
+
+    // not a binary log at all
+    CHECK_EQ(decode("Mnotalog", &errors), "");
+    CHECK_EQ(errors, "log_decoder: not a binary log (bad magic)\n");
+}
+
+/* ---------------------------------------------------------------- runner */
+
+/**
+ * @struct TEST
+ * @brief A named test function
+ */
+struct TEST
+{
+    const char *name;
+    void (*run)();
+};
+
+static const TEST tests[] = {
+    {"reader_values", test_reader_values},
+    {"reader_strings", test_reader_strings},
+    {"reader_errors", test_reader_errors},
+    {"reader_skip_stop", test_reader_skip_stop},
+    {"number_parse", test_number_parse},
+    {"number_get", test_number_get},
+    {"writer_quote", test_writer_quote},
+    {"writer_numbers", test_writer_numbers},
+    {"index_differential", test_index_differential},
+    {"index_mutations", test_index_mutations},
+    {"url_decode", test_url_decode},
+    {"url_params", test_url_params},
+    {"multipart_splits", test_multipart_splits},
+    {"multipart_large_file", test_multipart_large_file},
+    {"multipart_errors", test_multipart_errors},
+    {"route_precedence", test_route_precedence},
+    {"route_backtracking", test_route_backtracking},
+    {"route_edges", test_route_edges},
+    {"binlog_arguments", test_binlog_arguments},
+    {"binlog_limits", test_binlog_limits},
+};
+
+int main(int argc, char *argv[])
+{
+    int failed_tests = 0;
+    for (const TEST &t : tests)
+    {
+        if (argc > 1 && strstr(t.name, argv[1]) == NULL)
+            continue;
+        int before = g_failed;
+        t.run();
+        bool ok = g_failed == before;
+        failed_tests += !ok;
+        printf("%-24s %s\n", t.name, ok ? "ok" : "FAILED");
+    }
+    printf("%d checks, %d failed, %d tests failed\n", g_checks, g_failed, failed_tests);
+    return g_failed ? 1 : 0;
+}
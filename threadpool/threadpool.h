@@ -72,6 +72,9 @@ private:
      */
     void run()
     {
+        // bind this worker's own connection(s) so steady-state requests skip the pool lock
+        m_conn_pool->pin_thread();
+
         while (true) // run for infinity dont worry most of the time they are asleep
         {
             // check if any work is there in queue if there is than proess it otherwise wait.
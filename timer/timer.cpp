@@ -249,8 +249,10 @@ int UTILS::u_epollfd = 0;
 class UTILS;
 void cb_func(client_data *user_data)
 {
-    epoll_ctl(UTILS::u_epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0); // delete from epoll
     assert(user_data);
+    if (user_data->conn)
+        user_data->conn->cancel_deferred(); // before the fd can be reused by another client
+    epoll_ctl(UTILS::u_epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0); // delete from epoll
     close(user_data->sockfd);  // close the socket
     HTTP_CONN::m_user_count--; // reduce user count
 }
\ No newline at end of file
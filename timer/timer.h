@@ -24,6 +24,7 @@
 #include "../lock/locker.h"
 
 class UTIL_TIMER;
+class HTTP_CONN;
 
 /**
  * @struct client_data
@@ -34,6 +35,7 @@ struct client_data
     sockaddr_in address; ///< Client socket address
     int sockfd;          ///< Client socket file descriptor
     UTIL_TIMER *timer;   ///< Associated timer object
+    HTTP_CONN *conn;     ///< Connection served on the socket
 };
 
 /**
@@ -1,9 +1,11 @@
 #include "webserver.h"
+#include "../config/config.h"
 
 WEBSERVER::WEBSERVER()
 {
     users = new HTTP_CONN[MAX_FD];
     users_timer = new client_data[MAX_FD];
+    m_user_store = NULL;
 }
 
 WEBSERVER::~WEBSERVER()
@@ -15,21 +17,33 @@ WEBSERVER::~WEBSERVER()
     delete[] users;
     delete[] users_timer;
     delete m_pool;
+    delete m_user_store;
 }
 
-void WEBSERVER::init(int port, string user, string password, string dbname, int log_write, int opt_linger, int trigger_mode, int sql_num, int thread_num, int close_log, int actor_model)
+void WEBSERVER::init(const CONFIG &config, string user, string password, string dbname)
 {
-    m_port = port;
+    m_port = config.port;
     m_user = user;
-    m_password = password,
+    m_password = password;
     m_dbname = dbname;
-    m_log_write = log_write;
-    m_opt_linger = opt_linger;
-    m_trigger_mode = trigger_mode;
-    m_sql_num = sql_num;
-    m_thread_num = thread_num;
-    m_close_log = close_log;
-    m_actor_mode = actor_model;
+    m_log_write = config.log_write;
+    m_opt_linger = config.opt_linger;
+    m_trigger_mode = config.trigger_mode;
+    m_sql_num = config.sql_num;
+    m_thread_num = config.thread_num;
+    m_close_log = config.close_log;
+    m_actor_mode = config.actor_model;
+    m_sql_pin = config.sql_pin;
+    m_sql_min = config.sql_min;
+    m_sql_async = config.sql_async;
+    m_storage = config.storage;
+    m_log_level = config.log_level;
+    m_log_binary = config.log_binary;
+    m_access_sample = config.access_sample;
+    m_access_rate = config.access_rate;
+    m_log_compress = config.log_compress;
+    m_log_keep_files = config.log_keep_files;
+    m_log_keep_mb = config.log_keep_mb;
 }
 
 void WEBSERVER::trigger_mode()
@@ -64,18 +78,34 @@ void WEBSERVER::log_write()
 {
     if (m_close_log == 0)
     {
+        LOG::set_level(-1, m_log_level);
         if (m_log_write == 1) // if log mode is asynchronous
-            LOG::get_instance()->init("./ServerLog", m_close_log, 2000, 800000, 800);
+            LOG::get_instance()->init("./ServerLog", m_close_log, 2000, 800000, 800, m_log_binary, m_log_compress, m_log_keep_files, m_log_keep_mb * 1024LL * 1024);
         else
-            LOG::get_instance()->init("./ServerLog", m_close_log, 2000, 800000, 0);
+            LOG::get_instance()->init("./ServerLog", m_close_log, 2000, 800000, 0, m_log_binary, m_log_compress, m_log_keep_files, m_log_keep_mb * 1024LL * 1024);
+        ACCESS_LOG::get_instance()->init(m_close_log, m_access_sample, m_access_rate);
     }
 }
 
 void WEBSERVER::sql_pool()
 {
     m_connpool = DB_CONNECTION_POOL::get_instance();
-    m_connpool->init("sql12.freesqldatabase.com", m_user, m_password, m_dbname, 3306, m_sql_num, m_close_log);
-    // store the username and password in hashmap
+    m_async_sql = ASYNC_SQL::get_instance();
+
+    if (m_storage == 1)
+    {
+        // embedded backend: no MySQL connection is opened, handlers that need one get NULL
+        m_user_store = new MEMORY_USER_STORE();
+    }
+    else
+    {
+        m_connpool->init("sql12.freesqldatabase.com", m_user, m_password, m_dbname, 3306, m_sql_num, m_close_log, m_sql_pin, m_sql_min);
+        m_async_sql->init("sql12.freesqldatabase.com", m_user, m_password, m_dbname, 3306, m_sql_async, m_close_log);
+        m_user_store = new MYSQL_USER_STORE(m_connpool, m_close_log);
+    }
+
+    // load username/password pairs into the shared in-memory cache used by /login
+    USER_CACHE::get_instance()->init(m_user_store, m_close_log);
 }
 
 void WEBSERVER::thread_pool()
@@ -138,6 +168,7 @@ void WEBSERVER::event_listen()
 
     utils.addfd(m_epollfd, m_listenfd, false, m_listen_trigger_mode);
     HTTP_CONN::m_epollfd = m_epollfd;
+    m_async_sql->attach(m_epollfd);
 
     /*
     here m_pipefd is used for signal processing it is used for local communication within unix system it create two pair od socket so any thread can notify the main thread if it want to.
@@ -172,6 +203,7 @@ void WEBSERVER::timer(int connfd, struct sockaddr_in client_address)
 
     users_timer[connfd].address = client_address;
     users_timer[connfd].sockfd = connfd;
+    users_timer[connfd].conn = users + connfd;
     UTIL_TIMER *timer = new UTIL_TIMER;
     timer->user_data = &users_timer[connfd];
     timer->cb_func = cb_func;
@@ -187,7 +219,7 @@ void WEBSERVER::adjust_timer(UTIL_TIMER *timer)
     timer->expire = cur + 3 * TIMESLOT; // add new expiration time
     utils.m_timer_lst.adjust_timer(timer);
 
-    LOG_INFO("%s", "adjust timer once.");
+    LOG_DEBUG("%s", "adjust timer once.");
 }
 
 void WEBSERVER::deal_timer(UTIL_TIMER *timer, int sockfd)
@@ -195,7 +227,7 @@ void WEBSERVER::deal_timer(UTIL_TIMER *timer, int sockfd)
     timer->cb_func(&users_timer[sockfd]); // just execute cb_func and close the connection
     if (timer)
         utils.m_timer_lst.delete_timer(timer); // delete the timer from list too
-    LOG_INFO("close fd %d", users_timer[sockfd].sockfd);
+    LOG_DEBUG("close fd %d", users_timer[sockfd].sockfd);
 }
 
 bool WEBSERVER::deal_client_data()
@@ -329,9 +361,6 @@ void WEBSERVER::deal_with_read(int sockfd)
         // Here wroker thread do not read data it just acquire db connection and process it.
         if (users[sockfd].read_once())
         {
-            // cleint ip
-            LOG_INFO("deal with the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
-
             m_pool->append_p(users + sockfd); // append to proactor mode
 
             if (timer) // adjust expiration time
@@ -374,8 +403,6 @@ void WEBSERVER::deal_with_write(int sockfd)
     {
         if (users[sockfd].write())
         {
-            LOG_INFO("send data to the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
-
             if (timer)
                 adjust_timer(timer); // adjust expiration time
         }
@@ -413,6 +440,11 @@ void WEBSERVER::event_loop()
                 if (flag == false)
                     continue;
             }
+            // database sockets and the submit eventfd of the non-blocking MySQL client
+            else if (m_async_sql->owns(sockfd))
+            {
+                m_async_sql->on_event(sockfd, events[i].events);
+            }
             /*
             This condition happen when the client drop the connection or some error occured on epoll fd
 
@@ -455,8 +487,9 @@ void WEBSERVER::event_loop()
         if (timeout)
         {
             utils.time_handler(); // process all timer and sets alarm
+            m_async_sql->tick();  // keep-alive pings and reconnects of the async MySQL client
 
-            LOG_INFO("%s", "timer tick");
+            LOG_DEBUG("%s", "timer tick");
             timeout = false;
         }
     }
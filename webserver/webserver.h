@@ -34,6 +34,10 @@
 
 #include "../threadpool/threadpool.h"
 #include "../http/http_coonection.h"
+#include "../cgi_mysql/async_sql.h"
+#include "../cgi_mysql/user_cache.h"
+
+class CONFIG;
 
 /**
  * @def MAX_FD
@@ -70,19 +74,12 @@ public:
 
     /**
      * @brief Initialize server configuration
-     * @param port Listening port number
+     * @param config Parsed command line (port, logging, pools, trigger and actor modes, ...)
      * @param user Database username
      * @param password Database password
      * @param dbname Database name
-     * @param log_write Logging mode (0: synchronous, 1: asynchronous)
-     * @param opt_linger Linger option for sockets
-     * @param trigger_mode Event trigger mode
-     * @param sql_num Database connection pool size
-     * @param thread_num Thread pool size
-     * @param close_log Disable logging if non-zero
-     * @param actor_model 0: Proactor, 1: Reactor
      */
-    void init(int port, string user, string password, string dbname, int log_write, int opt_linger, int trigger_mode, int sql_num, int thread_num, int close_log, int actor_model);
+    void init(const CONFIG &config, string user, string password, string dbname);
 
     ///< Initialize thread pool
     void thread_pool();
@@ -136,10 +133,17 @@ public:
 
 public:
     /* Configuration parameters */
-    int m_port;       ///< Server listening port
-    int m_log_write;  ///< Logging mode flag
-    int m_close_log;  ///< Logging enable/disable flag
-    int m_actor_mode; ///< Concurrency model (0:Proactor, 1:Reactor)
+    int m_port;           ///< Server listening port
+    int m_log_write;      ///< Logging mode flag
+    int m_close_log;      ///< Logging enable/disable flag
+    int m_log_level;      ///< Initial runtime log level
+    int m_log_binary;     ///< Binary log file format
+    int m_access_sample;  ///< Access log sampling, 1 request in N
+    int m_access_rate;    ///< Access log records per second
+    int m_log_compress;   ///< gzip rotated log files
+    int m_log_keep_files; ///< Rotated log files kept
+    int m_log_keep_mb;    ///< Megabytes of rotated log files kept
+    int m_actor_mode;     ///< Concurrency model (0:Proactor, 1:Reactor)
 
     /* Event handling */
     int m_pipefd[2];  ///< Signal notification pipe
@@ -151,7 +155,13 @@ public:
     string m_user;                  ///< Database username
     string m_password;              ///< Database password
     string m_dbname;                ///< Database name
-    int m_sql_num;                  ///< Database connection pool size
+    int m_sql_num;                  ///< Database connection pool size (upper bound)
+    int m_sql_min;                  ///< Database connections kept open when idle
+    int m_sql_pin;                  ///< Connections pinned to each worker thread
+    ASYNC_SQL *m_async_sql;         ///< Non-blocking client multiplexed on m_epollfd
+    int m_sql_async;                ///< Number of non-blocking connections
+    int m_storage;                  ///< Storage backend (0: MySQL, 1: embedded in-memory)
+    USER_STORE *m_user_store;       ///< Backend behind USER_CACHE
 
     /* Thread pool */
     THREADPOOL<HTTP_CONN> *m_pool; ///< Thread pool instance